@@ -0,0 +1,133 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "Benchmarks.h"
+#import <LJKit/LJKit.h>
+#import "LJAccount_Private.h"
+
+// Friends on the synthetic account, and how many of them are mutual.
+static const NSUInteger kFriendCount = 5000;
+static const NSUInteger kFriendOfCount = 4000;
+static const NSUInteger kGroupCount = 20;
+static const NSUInteger kLoadRuns = 5;
+
+/*
+ * Builds a getfriends reply shaped like the server's, with birthdays,
+ * friend-ofs and groups, so the account carries everything downloadFriends
+ * would leave in it.
+ */
+static NSDictionary *LJSyntheticGetFriendsReply(void)
+{
+    NSMutableDictionary *reply = [[NSMutableDictionary alloc] init];
+
+    reply[@"success"] = @"OK";
+    reply[@"friend_count"] = [NSString stringWithFormat:@"%lu", (unsigned long)kFriendCount];
+    for (NSUInteger i = 1; i <= kFriendCount; i++) {
+        NSString *prefix = [NSString stringWithFormat:@"friend_%lu_", (unsigned long)i];
+        reply[[prefix stringByAppendingString:@"user"]] = [NSString stringWithFormat:@"friend%05lu", (unsigned long)i];
+        reply[[prefix stringByAppendingString:@"name"]] = [NSString stringWithFormat:@"Friend Number %lu", (unsigned long)i];
+        reply[[prefix stringByAppendingString:@"type"]] = (i % 50) ? @"personal" : @"community";
+        reply[[prefix stringByAppendingString:@"status"]] = @"active";
+        reply[[prefix stringByAppendingString:@"fg"]] = [NSString stringWithFormat:@"#%06lX", (unsigned long)(i * 2654435761UL & 0xFFFFFF)];
+        reply[[prefix stringByAppendingString:@"bg"]] = @"#FFFFFF";
+        reply[[prefix stringByAppendingString:@"groupmask"]] =
+            [NSString stringWithFormat:@"%lu", (unsigned long)(1 | (1UL << (i % kGroupCount + 1)))];
+        if (i % 4) {
+            reply[[prefix stringByAppendingString:@"birthday"]] =
+                [NSString stringWithFormat:@"19%02lu-%02lu-%02lu", (unsigned long)(i % 60 + 40),
+                 (unsigned long)(i % 12 + 1), (unsigned long)(i % 28 + 1)];
+        }
+    }
+    reply[@"friendof_count"] = [NSString stringWithFormat:@"%lu", (unsigned long)kFriendOfCount];
+    for (NSUInteger i = 1; i <= kFriendOfCount; i++) {
+        NSString *prefix = [NSString stringWithFormat:@"friendof_%lu_", (unsigned long)i];
+        reply[[prefix stringByAppendingString:@"user"]] = [NSString stringWithFormat:@"friend%05lu", (unsigned long)i];
+        reply[[prefix stringByAppendingString:@"name"]] = [NSString stringWithFormat:@"Friend Number %lu", (unsigned long)i];
+        reply[[prefix stringByAppendingString:@"type"]] = (i % 50) ? @"personal" : @"community";
+        reply[[prefix stringByAppendingString:@"status"]] = @"active";
+        reply[[prefix stringByAppendingString:@"fg"]] = @"#000000";
+        reply[[prefix stringByAppendingString:@"bg"]] = @"#FFFFFF";
+    }
+    for (NSUInteger n = 1; n <= kGroupCount; n++) {
+        reply[[NSString stringWithFormat:@"frgrp_%lu_name", (unsigned long)n]] =
+            [NSString stringWithFormat:@"Group %lu", (unsigned long)n];
+        reply[[NSString stringWithFormat:@"frgrp_%lu_public", (unsigned long)n]] = (n % 2) ? @"1" : @"0";
+        reply[[NSString stringWithFormat:@"frgrp_%lu_sortorder", (unsigned long)n]] =
+            [NSString stringWithFormat:@"%lu", (unsigned long)(n * 10)];
+    }
+    return reply;
+}
+
+static unsigned long long LJFileSize(NSString *path)
+{
+    return [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL] fileSize];
+}
+
+/*
+ * Times loading the same account from the memory-mapped archive written
+ * by writeToFile: and from the keyed archive earlier versions wrote.
+ */
+void LJRunAccountArchiveBenchmark(void)
+{
+    NSString *dir = [NSTemporaryDirectory() stringByAppendingPathComponent:
+                     [NSString stringWithFormat:@"LJKitBenchmarks-%d", [[NSProcessInfo processInfo] processIdentifier]]];
+    NSString *mappedPath = [dir stringByAppendingPathComponent:@"mapped.ljaccount"];
+    NSString *keyedPath = [dir stringByAppendingPathComponent:@"keyed.ljaccount"];
+    NSTimeInterval mappedWrite, keyedWrite, mappedLoad, keyedLoad;
+    __block NSUInteger mappedCount = 0, keyedCount = 0;
+
+    [[NSFileManager defaultManager] createDirectoryAtPath:dir withIntermediateDirectories:YES
+                                               attributes:nil error:NULL];
+    @autoreleasepool {
+        LJAccount *account = [[LJAccount alloc] initWithUsername:@"benchmark"];
+        [account _updateFriendsWithReply:LJSyntheticGetFriendsReply()];
+        mappedWrite = LJBestTimeOfRuns(1, ^{
+            if (![account writeToFile:mappedPath]) {
+                fprintf(stderr, "writeToFile: failed\n");
+            }
+        });
+        keyedWrite = LJBestTimeOfRuns(1, ^{
+            if (![NSKeyedArchiver archiveRootObject:account toFile:keyedPath]) {
+                fprintf(stderr, "NSKeyedArchiver failed\n");
+            }
+        });
+    }
+    mappedLoad = LJBestTimeOfRuns(kLoadRuns, ^{
+        LJAccount *loaded = [[LJAccount alloc] initWithContentsOfFile:mappedPath];
+        mappedCount = [[loaded friendSet] count];
+    });
+    keyedLoad = LJBestTimeOfRuns(kLoadRuns, ^{
+        LJAccount *loaded = [[LJAccount alloc] initWithContentsOfFile:keyedPath];
+        keyedCount = [[loaded friendSet] count];
+    });
+    printf("%lu friends, %lu friend-ofs, %lu groups\n", (unsigned long)kFriendCount,
+           (unsigned long)kFriendOfCount, (unsigned long)kGroupCount);
+    printf("format        size     write      load  friends\n");
+    printf("keyed   %8.1f KB %8.3fs %8.3fs %8lu\n", LJFileSize(keyedPath) / 1024.0,
+           keyedWrite, keyedLoad, (unsigned long)keyedCount);
+    printf("mapped  %8.1f KB %8.3fs %8.3fs %8lu\n", LJFileSize(mappedPath) / 1024.0,
+           mappedWrite, mappedLoad, (unsigned long)mappedCount);
+    printf("load speedup %.2fx\n", keyedLoad / mappedLoad);
+    if (mappedCount != kFriendCount || keyedCount != kFriendCount) {
+        fprintf(stderr, "loaded accounts are missing friends\n");
+    }
+    [[NSFileManager defaultManager] removeItemAtPath:dir error:NULL];
+}
@@ -0,0 +1,103 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "Benchmarks.h"
+#import <LJKit/LJKit.h>
+#import "LJLazyEntryArray.h"
+
+// Events in the synthetic reply, and the size of each one's text.
+static const NSUInteger kEventCount = 1000;
+static const NSUInteger kEventLength = 4096;
+static const NSUInteger kRunsPerSetting = 3;
+
+/*
+ * Builds a getevents reply shaped like the server's: each event has the
+ * usual fields and a couple of metadata properties.  itemIDs start at
+ * firstItemID, so each run decodes entries the journal hasn't seen.
+ */
+static NSDictionary *LJSyntheticGetEventsReply(int firstItemID, NSUInteger *byteCount)
+{
+    NSMutableDictionary *reply = [[NSMutableDictionary alloc] init];
+    NSMutableString *text = [[NSMutableString alloc] initWithCapacity:kEventLength];
+    NSUInteger bytes = 0, propIndex = 0;
+
+    while ([text length] < kEventLength) {
+        [text appendString:@"Lorem+ipsum+dolor+sit+amet%2C+consectetur+adipiscing+elit.%0A"];
+    }
+    reply[@"success"] = @"OK";
+    reply[@"events_count"] = [NSString stringWithFormat:@"%lu", (unsigned long)kEventCount];
+    for (NSUInteger i = 1; i <= kEventCount; i++) {
+        NSString *prefix = [NSString stringWithFormat:@"events_%lu_", (unsigned long)i];
+        NSString *itemID = [NSString stringWithFormat:@"%lu", (unsigned long)(firstItemID + i - 1)];
+        reply[[prefix stringByAppendingString:@"itemid"]] = itemID;
+        reply[[prefix stringByAppendingString:@"anum"]] = @"77";
+        reply[[prefix stringByAppendingString:@"eventtime"]] =
+            [NSString stringWithFormat:@"2004-%02lu-%02lu 12:34:56", (unsigned long)(i % 12 + 1), (unsigned long)(i % 28 + 1)];
+        reply[[prefix stringByAppendingString:@"subject"]] = [NSString stringWithFormat:@"Entry %lu", (unsigned long)i];
+        reply[[prefix stringByAppendingString:@"event"]] = [text copy];
+        reply[[prefix stringByAppendingString:@"security"]] = (i % 3) ? @"public" : @"private";
+        reply[[prefix stringByAppendingString:@"poster"]] = @"benchmark";
+        for (NSString *name in @[@"revnum", @"current_music"]) {
+            NSString *key = [NSString stringWithFormat:@"prop_%lu_", (unsigned long)++propIndex];
+            reply[[key stringByAppendingString:@"itemid"]] = itemID;
+            reply[[key stringByAppendingString:@"name"]] = name;
+            reply[[key stringByAppendingString:@"value"]] = [name isEqualToString:@"revnum"] ? @"1" : @"Some song";
+        }
+        bytes += [text length] + 200;
+    }
+    reply[@"prop_count"] = [NSString stringWithFormat:@"%lu", (unsigned long)propIndex];
+    *byteCount = bytes;
+    return reply;
+}
+
+void LJRunLazyDecodeBenchmark(void)
+{
+    LJAccount *account = [[LJAccount alloc] initWithUsername:@"benchmark"];
+    LJJournal *journal = [account defaultJournal];
+    NSUInteger threadCounts[] = {1, 2, 4, 8};
+    NSTimeInterval serialTime = 0;
+    __block int nextItemID = 1;
+    NSUInteger byteCount;
+
+    // Size the reply once for the report; each run builds its own.
+    LJSyntheticGetEventsReply(1, &byteCount);
+    printf("%lu events, %.1f MB per reply, %lu cores\n", (unsigned long)kEventCount,
+           byteCount / 1048576.0, (unsigned long)[[NSProcessInfo processInfo] activeProcessorCount]);
+    printf("threads      time    MB/s  speedup\n");
+    for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) {
+        NSTimeInterval best = DBL_MAX;
+
+        // Only buildObjectsInRange: is timed, not building the reply.
+        for (NSUInteger run = 0; run < kRunsPerSetting; run++) @autoreleasepool {
+            NSUInteger unused;
+            NSDictionary *reply = LJSyntheticGetEventsReply(nextItemID, &unused);
+            LJLazyEntryArray *entries = [[LJLazyEntryArray alloc] initWithReply:reply journal:journal summaries:NO];
+            nextItemID += (int)kEventCount;
+            [entries setMaxDecodeThreads:threadCounts[t]];
+            best = MIN(best, LJBestTimeOfRuns(1, ^{
+                [entries buildObjectsInRange:NSMakeRange(0, [entries count])];
+            }));
+        }
+        if (t == 0) serialTime = best;
+        printf("%7lu %8.3fs %7.1f %7.2fx\n", (unsigned long)threadCounts[t], best,
+               byteCount / 1048576.0 / best, serialTime / best);
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "Benchmarks.h"
+
+/*
+ * usage: LJKitBenchmarks [name ...]
+ * Runs the named benchmarks, or all of them.
+ */
+
+NSTimeInterval LJBestTimeOfRuns(NSUInteger runs, void (^block)(void))
+{
+    NSTimeInterval best = DBL_MAX;
+
+    for (NSUInteger i = 0; i < runs; i++) {
+        @autoreleasepool {
+            CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+            block();
+            best = MIN(best, CFAbsoluteTimeGetCurrent() - start);
+        }
+    }
+    return best;
+}
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool {
+        NSDictionary *benchmarks = @{@"lazydecode": ^{ LJRunLazyDecodeBenchmark(); },
+                                     @"accountarchive": ^{ LJRunAccountArchiveBenchmark(); }};
+        NSMutableArray *names = [[NSMutableArray alloc] init];
+
+        for (int i = 1; i < argc; i++) {
+            [names addObject:@(argv[i])];
+        }
+        if ([names count] == 0) {
+            [names addObjectsFromArray:[[benchmarks allKeys] sortedArrayUsingSelector:@selector(compare:)]];
+        }
+        for (NSString *name in names) {
+            void (^benchmark)(void) = benchmarks[name];
+            if (benchmark == nil) {
+                fprintf(stderr, "unknown benchmark: %s\n", [name UTF8String]);
+                return 1;
+            }
+            printf("== %s\n", [name UTF8String]);
+            benchmark();
+        }
+    }
+    return 0;
+}
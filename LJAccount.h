@@ -24,10 +24,11 @@
 
 #import <Cocoa/Cocoa.h>
 #import <LJKit/LJUserEntity.h>
+#import <LJKit/LJRequestScheduler.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
-@class LJServer, LJMoods, LJJournal;
+@class LJServer, LJMoods, LJJournal, LJReplyCache, LJFriendsSnapshot;
 
 #define LJKitBundle [NSBundle bundleForClass:[LJAccount class]]
 
@@ -186,14 +187,6 @@ FOUNDATION_EXPORT NSString * const LJAccountDidDownloadFriendsNotification;
     NSMutableSet *_friendOfSet;
     NSDate *_groupsSyncDate;
     NSDate *_friendsSyncDate;
-    
-   	// For efficiency, keep an ordered cache of friends, 
-	// which we only update when _friendSet changes
-	NSArray *_orderedFriendArrayCache;
-	NSArray *_orderedGroupArrayCache;
-	
-    // for internal linked list
-    LJAccount *_nextAccount;
 }
 
 /*!
@@ -313,7 +306,11 @@ FOUNDATION_EXPORT NSString * const LJAccountDidDownloadFriendsNotification;
  @param path The path to the previously archived account object.
  @discussion
  Initializes an account object using information previously saved
- to a file.  This method uses NSKeyedUnarchiver to read the file.
+ to a file with writeToFile:.  The file is mapped rather than read, and
+ its records are turned into objects directly, so an account with
+ thousands of friends loads quickly.  Files saved by earlier versions of
+ LJKit, which are keyed archives, are read with NSKeyedUnarchiver.
+ @result The account, or nil if the file could not be read.
  */
 - (instancetype)initWithContentsOfFile:(NSString *)path;
 
@@ -324,9 +321,13 @@ FOUNDATION_EXPORT NSString * const LJAccountDidDownloadFriendsNotification;
  @abstract Archives the receiver to a file.
  @param path The path to save the object to.
  @discussion
- Archives the receiver to a file.  This is a convenience
- method; it uses NSKeyedArchiver to write the file to disk.
- This can be used by offline clients to save account info.
+ Archives the receiver to a file.  This can be used by offline
+ clients to save account info.
+
+ The file is in LJKit's own compact binary format, which holds the
+ same information as the keyed archive made through NSCoding but is
+ much faster to load.  Earlier versions of LJKit can't read it; to
+ write a file they can read, archive the account with NSKeyedArchiver.
  @result YES on success; NO otherwise.
  */ 
 - (BOOL)writeToFile:(NSString *)path;
@@ -339,6 +340,30 @@ FOUNDATION_EXPORT NSString * const LJAccountDidDownloadFriendsNotification;
  */
 @property (NS_NONATOMIC_IOSONLY, readonly, strong) LJServer *server;
 
+/*!
+ @property friendsSnapshot
+ @abstract The current immutable snapshot of the receiver's friends and groups.
+ @discussion
+ A new snapshot is published the first time this property is read after the
+ friends or groups change, so a run of edits costs one snapshot.  Reading
+ this property is safe from any thread while another thread downloads or edits
+ friends, and always returns a complete, consistent snapshot.  Returns nil if
+ friends have never been downloaded.  The friendSet, friendArray, groupSet and
+ groupArray accessors in the EditFriends category read from this snapshot.
+ */
+@property (atomic, readonly, strong, nullable) LJFriendsSnapshot *friendsSnapshot;
+
+/*!
+ @property replyCache
+ @abstract The cache of replies to read-only requests.
+ @discussion
+ getReplyForMode:parameters: answers repeated read-only requests from this
+ cache until their time to live expires.  Use it to tune the time to live of
+ each mode, set a memory budget or a directory on disk, or read the hit and
+ miss counts.  This property is not preserved during archiving.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, strong) LJReplyCache *replyCache;
+
 /*!
  @method getReplyForMode:parameters:
  @abstract Sends a request to the LiveJournal server.
@@ -357,6 +382,44 @@ FOUNDATION_EXPORT NSString * const LJAccountDidDownloadFriendsNotification;
  */
 - (nullable NSDictionary *)getReplyForMode:(NSString *)mode parameters:(nullable NSDictionary *)parameters;
 
+/*!
+ @method getReplyForMode:parameters:priority:
+ @abstract Sends a request to the LiveJournal server with a given priority.
+ @discussion
+ Like getReplyForMode:parameters:, but lets the caller choose the priority
+ class the request waits in when the server's host is busy (see
+ LJRequestScheduler).  getReplyForMode:parameters: makes writes such as
+ postevent interactive, syncing background, and everything else normal.
+ */
+- (nullable NSDictionary *)getReplyForMode:(NSString *)mode parameters:(nullable NSDictionary *)parameters
+                                  priority:(LJRequestPriority)priority;
+
+/*!
+ @method performBlock:
+ @abstract Runs a block on the receiver's serial executor.
+ @param block The block to run.  It is passed the receiver.
+ @discussion
+ Every account has its own serial queue.  Blocks submitted to one account
+ run one at a time, in the order they were submitted; blocks submitted to
+ different accounts run concurrently.  This lets a client drive many
+ accounts in parallel without any locking of its own.  This method returns
+ immediately.
+
+ LJAccount and LJServer methods are safe to call from any thread, so the
+ executor is a convenience for ordering work, not a requirement.
+ */
+- (void)performBlock:(void (^)(LJAccount *account))block;
+
+/*!
+ @method performBlockAndWait:
+ @abstract Runs a block on the receiver's serial executor and waits for it.
+ @discussion
+ Like performBlock:, but does not return until the block has run.  If called
+ from a block already running on the receiver's executor, the block is run
+ immediately.
+ */
+- (void)performBlockAndWait:(void (^)(LJAccount *account))block;
+
 /*!
  @method loginWithPassword:flags:
  @abstract Logs in to the LiveJournal server.
@@ -566,6 +629,12 @@ FOUNDATION_EXPORT NSString * const LJAccountDidDownloadFriendsNotification;
  @discussion
  Returns a unique identifier for the receiver.  It is of the form
  "username&#64;hostname:port".
+
+ Accounts are equal, and hash alike, when their identifiers are equal.
+ The identifier changes when the username does or the server's URL is
+ changed, so an account must not be logged in under another name or
+ moved to another server while it is in a set or is a dictionary key;
+ remove it first and add it back afterwards.
  */
 @property (NS_NONATOMIC_IOSONLY, readonly, copy) NSString *identifier;
 
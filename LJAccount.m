@@ -31,10 +31,16 @@
 #import "LJAccount_EditFriends.h"
 #import "LJUserEntity_Private.h"
 #import "LJAccount_Private.h"
+#import "LJAccountArchive.h"
+#import "LJFriend_Private.h"
+#import "LJGroup_Private.h"
 #import "LJJournal_Private.h"
 #import "LJMenu.h"
 #import "LJMoods_Private.h"
 #import "LJServer_Private.h"
+#import "LJProtocolModes.h"
+#import "LJReplyCache_Private.h"
+#import "LJSingleFlight.h"
 #import "Miscellaneous.h"
 
 // The .strings resource file to look for error messages in.  "nil" means use "Localizable".
@@ -54,22 +60,38 @@ NSString * const LJAccountDidDownloadFriendsNotification = @"LJAccountDidDownloa
 static NSString *gClientVersion = nil;
 
 /*
- * Internally a linked list of LJAccount objects is maintained,
- * so that other objects can find the LJAccount.
+ * Internally a registry of LJAccount objects is maintained, so that other
+ * objects can find the LJAccount.  gAccountList holds every account in
+ * order, with the default account first; gAccountsByIdentifier indexes
+ * them by their cached identifiers.  Both are guarded by gAccountLock.
  */
-static LJAccount *gAccountListHead = nil;
+static NSLock *gAccountLock = nil;
+static NSMutableArray *gAccountList = nil;
+static NSMutableDictionary *gAccountsByIdentifier = nil;
+
+// Marks each account's executor queue, so performBlockAndWait: can tell
+// when it is already running on it.
+static char kExecutorQueueKey;
 
 @interface LJAccount ()
+{
+    LJSingleFlight *_singleFlight;
+    dispatch_queue_t _executorQueue;
+}
 + (NSString *)_clientVersionForBundle:(NSBundle *)bundle;
+- (instancetype)_initWithArchiveReader:(LJAccountArchiveReader *)reader;
+- (NSData *)_archiveData;
 
 @property (NS_NONATOMIC_IOSONLY, getter=isLoggedIn, readwrite) BOOL loggedIn;
 @property (NS_NONATOMIC_IOSONLY, readwrite, copy) NSArray *journalArray;
 @property (NS_NONATOMIC_IOSONLY, readwrite, copy) NSDictionary *userPicturesDictionary;
+@property (NS_NONATOMIC_IOSONLY, readwrite, copy) NSString *identifier;
 @end
 
 @implementation LJAccount
 @synthesize loggedIn = _isLoggedIn;
 @synthesize userPicturesDictionary = _userPicturesDictionary;
+@synthesize identifier = _identifier;
 
 /*
  This method sets the client name and version to be sent to the server.
@@ -94,6 +116,11 @@ static LJAccount *gAccountListHead = nil;
 
 + (void)initialize
 {
+    if (gAccountLock == nil) {
+        gAccountLock = [[NSLock alloc] init];
+        gAccountList = [[NSMutableArray alloc] init];
+        gAccountsByIdentifier = [[NSMutableDictionary alloc] init];
+    }
     if (gClientVersion == nil) {
         NSBundle *mainBundle, *ljKitBundle;
         NSString *name, *version;
@@ -121,63 +148,53 @@ static LJAccount *gAccountListHead = nil;
 
 + (NSArray *)allAccounts
 {
-    NSMutableArray *array = [NSMutableArray array];
-    LJAccount *account = gAccountListHead;
+    NSArray *array;
 
-    while (account) {
-        [array addObject:account];
-        account = account->_nextAccount;
-    }
+    [gAccountLock lock];
+    array = [gAccountList copy];
+    [gAccountLock unlock];
     return array;
 }
 
 
-/* In Objective-C, [nil anyMessage] == nil, which makes traversing list links a breeze! */
-- (LJAccount *)_accountWithIdentifier:(NSString *)identifier
-{
-    if ([[self identifier] isEqualToString:identifier]) {
-        return self;
-    } else {
-        return [_nextAccount _accountWithIdentifier:identifier];
-    }
-}
-
-
 + (LJAccount *)accountWithIdentifier:(NSString *)identifier
 {
-    return [gAccountListHead _accountWithIdentifier:identifier];
+    LJAccount *account;
+
+    if (identifier == nil) return nil;
+    [gAccountLock lock];
+    account = gAccountsByIdentifier[identifier];
+    [gAccountLock unlock];
+    return account;
 }
 
 
 + (LJAccount *)defaultAccount
 {
-    return gAccountListHead;
+    LJAccount *account;
+
+    [gAccountLock lock];
+    account = ([gAccountList count] > 0) ? gAccountList[0] : nil;
+    [gAccountLock unlock];
+    return account;
 }
 
 
 + (void)setDefaultAccount:(LJAccount *)newDefault
 {
     NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    NSUInteger index;
     
-    // Must save here in case newDefault is already the list head
+    // Must save here in case newDefault is already the default
     [defaults setObject:[newDefault identifier] forKey:@"LJDefaultAccountIdentifier"];
-    if (newDefault != gAccountListHead) {
-        LJAccount *previous = gAccountListHead;
-        LJAccount *current = gAccountListHead->_nextAccount;
-    
-        while (current) {
-            if (current == newDefault) {
-                [gAccountListHead setDefault:NO];
-                // remove newDefault from the list
-                previous->_nextAccount = newDefault->_nextAccount;
-                // put newDefault at the front
-                newDefault->_nextAccount = gAccountListHead;
-                gAccountListHead = newDefault;
-                return;
-            }
-            previous = current;
-            current = current->_nextAccount;
-        }
+    [gAccountLock lock];
+    index = [gAccountList indexOfObjectIdenticalTo:newDefault];
+    if (index != 0 && index != NSNotFound) {
+        [gAccountList removeObjectAtIndex:index];
+        [gAccountList insertObject:newDefault atIndex:0];
+    }
+    [gAccountLock unlock];
+    if (index == NSNotFound) {
         [NSException raise:NSInternalInconsistencyException
                     format:@"New proposed default account not in the list."];
     }
@@ -186,7 +203,7 @@ static LJAccount *gAccountListHead = nil;
 
 - (BOOL)isDefault
 {
-    return (gAccountListHead == self);
+    return ([LJAccount defaultAccount] == self);
 }
 
 
@@ -202,14 +219,20 @@ static LJAccount *gAccountListHead = nil;
 {
     self = [super init];
     if (self) {
-        // add self to global linked list of accounts.
-        // can't overwrite the head because it is the default now
-        if (nil == gAccountListHead) {
-            gAccountListHead = self;
-        } else {
-            _nextAccount = gAccountListHead->_nextAccount;
-            gAccountListHead->_nextAccount = self;
-        }
+        _stateLock = [[NSRecursiveLock alloc] init];
+        _sortedFriendArray = [[NSMutableArray alloc] init];
+        _sortedFriendOfArray = [[NSMutableArray alloc] init];
+        _sortedGroupArray = [[NSMutableArray alloc] init];
+        _friendsByUsername = UsernameMapTable();
+        _executorQueue = dispatch_queue_create("com.livejournal.LJKit.account", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(_executorQueue, &kExecutorQueueKey, (__bridge void *)self, NULL);
+        _singleFlight = [[LJSingleFlight alloc] init];
+        _replyCache = [[LJReplyCache alloc] init];
+        // add self to the global account list.
+        // can't go in front because the first account is the default
+        [gAccountLock lock];
+        [gAccountList insertObject:self atIndex:MIN([gAccountList count], 1)];
+        [gAccountLock unlock];
     }
 	
     return self;
@@ -224,6 +247,7 @@ static LJAccount *gAccountListHead = nil;
         journal = [LJJournal _journalWithName:[self username] account:self];
         _journalArray = [[NSArray alloc] initWithObjects:&journal count:1];
     }
+    [self _updateIdentifier];
 }
 
 - (instancetype)initWithUsername:(NSString *)username
@@ -236,13 +260,105 @@ static LJAccount *gAccountListHead = nil;
         [self _setFullname:username];
         defaultURL = [NSURL URLWithString:@"http://www.livejournal.com"];
         _server = [[LJServer alloc] initWithURL:defaultURL account:self];
+        [self _updateIdentifier];
     }
     return self;
 }
 
 - (instancetype)initWithContentsOfFile:(NSString *)path
 {
-    return [NSKeyedUnarchiver unarchiveObjectWithFile:path];
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:NULL];
+
+    if (data == nil) return nil;
+    if ([LJAccountArchiveReader isArchiveData:data]) {
+        LJAccountArchiveReader *reader = [[LJAccountArchiveReader alloc] initWithData:data];
+        return reader ? [self _initWithArchiveReader:reader] : nil;
+    }
+    // Files written by earlier versions of LJKit are keyed archives.
+    return [NSKeyedUnarchiver unarchiveObjectWithData:data];
+}
+
+- (instancetype)_initWithArchiveReader:(LJAccountArchiveReader *)reader
+{
+    if (self = [self init]) {
+        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+        const LJArchiveHeader *header = [reader header];
+        uint32_t flags = header->flags;
+        NSString *theIdentifier, *URLString;
+        NSUInteger count;
+
+        _username = [reader stringForReference:header->username];
+        _fullname = [reader stringForReference:header->fullname];
+        URLString = [reader stringForReference:header->serverURL];
+        _server = [[LJServer alloc] initWithURL:(URLString ? [NSURL URLWithString:URLString] : nil)
+                                        account:self];
+        if (flags & LJArchiveHasMoods) {
+            _moods = [[LJMoods alloc] _initWithArchiveReader:reader];
+        }
+        if (flags & LJArchiveHasUserPictures) {
+            const LJArchiveStringPair *pairs = [reader recordsInSection:LJArchiveUserPictureSection
+                                                                  count:&count];
+            NSMutableDictionary *userpics = [[NSMutableDictionary alloc] initWithCapacity:count];
+            for (NSUInteger i = 0; i < count; i++) {
+                NSString *keyword = [reader stringForReference:pairs[i].key];
+                NSString *url = [reader stringForReference:pairs[i].value];
+                if (keyword && url) userpics[keyword] = [NSURL URLWithString:url];
+            }
+            _userPicturesDictionary = [userpics copy];
+        }
+        URLString = [reader stringForReference:header->defaultUserPictureURL];
+        if (URLString) _defaultUserPictureURL = [NSURL URLWithString:URLString];
+        if (flags & LJArchiveHasJournals) {
+            const LJArchiveStringRef *names = [reader recordsInSection:LJArchiveJournalSection
+                                                                 count:&count];
+            NSMutableArray *journals = [[NSMutableArray alloc] initWithCapacity:count];
+            for (NSUInteger i = 0; i < count; i++) {
+                NSString *name = [reader stringForReference:names[i]];
+                if (name) [journals addObject:[[LJJournal alloc] initWithName:name account:self]];
+            }
+            _journalArray = [journals copy];
+        }
+        // editfriends fields
+        if (flags & LJArchiveHasFriends) _friendSet = [[NSMutableSet alloc] init];
+        if (flags & LJArchiveHasRemovedFriends) _removedFriendSet = [[NSMutableSet alloc] init];
+        if (flags & LJArchiveHasFriendOfs) _friendOfSet = [[NSMutableSet alloc] init];
+        if (flags & LJArchiveHasGroups) _groupSet = [[NSMutableSet alloc] init];
+        if (flags & LJArchiveHasRemovedGroups) _removedGroupSet = [[NSMutableSet alloc] init];
+        const LJArchiveFriendRecord *friendRecords = [reader recordsInSection:LJArchiveFriendSection
+                                                                        count:&count];
+        for (NSUInteger i = 0; i < count; i++) {
+            const LJArchiveFriendRecord *record = &friendRecords[i];
+            LJFriend *buddy;
+            if (record->username == LJArchiveNoString) continue;
+            buddy = [[LJFriend alloc] _initWithArchiveRecord:record reader:reader account:self];
+            if (record->membership & LJArchiveInFriends) [_friendSet addObject:buddy];
+            if (record->membership & LJArchiveInRemovedFriends) [_removedFriendSet addObject:buddy];
+            if (record->membership & LJArchiveInFriendOfs) [_friendOfSet addObject:buddy];
+        }
+        const LJArchiveGroupRecord *groupRecords = [reader recordsInSection:LJArchiveGroupSection
+                                                                      count:&count];
+        for (NSUInteger i = 0; i < count; i++) {
+            const LJArchiveGroupRecord *record = &groupRecords[i];
+            LJGroup *group;
+            if (record->number < 1 || record->number > 30) continue;
+            group = [[LJGroup alloc] _initWithArchiveRecord:record reader:reader account:self];
+            if (record->membership & LJArchiveInGroups) [_groupSet addObject:group];
+            if (record->membership & LJArchiveInRemovedGroups) [_removedGroupSet addObject:group];
+        }
+        if (_friendSet || _friendOfSet || _groupSet) [self _resortFriendsAndGroups];
+        // custom info
+        NSData *customInfo = [reader dataInSection:LJArchiveCustomInfoSection];
+        if (customInfo) {
+            _customInfo = [[NSKeyedUnarchiver unarchiveObjectWithData:customInfo] mutableCopy];
+        }
+        [self _updateIdentifier];
+        // check defaults to see if this is supposed to be the default account
+        theIdentifier = [defaults stringForKey:@"LJDefaultAccountIdentifier"];
+        if ([theIdentifier isEqualToString:[self identifier]]) {
+            [LJAccount setDefaultAccount:self];
+        }
+    }
+    return self;
 }
 
 - (instancetype)initWithCoder:(NSCoder *)decoder
@@ -264,8 +380,10 @@ static LJAccount *gAccountListHead = nil;
         _friendOfSet = [decoder decodeObjectForKey:@"LJAccountFriendOfs"];
         _groupSet = [decoder decodeObjectForKey:@"LJAccountGroups"];
         _removedGroupSet = [decoder decodeObjectForKey:@"LJAccountExGroups"];
+        if (_friendSet || _friendOfSet || _groupSet) [self _resortFriendsAndGroups];
         // custom info
         _customInfo = [decoder decodeObjectForKey:@"LJAccountCustomInfo"];
+        [self _updateIdentifier];
         // check defaults to see if this is supposed to be the default account
         theIdentifier = [defaults stringForKey:@"LJDefaultAccountIdentifier"];
         if ([theIdentifier isEqualToString:[self identifier]]) {
@@ -277,22 +395,16 @@ static LJAccount *gAccountListHead = nil;
 
 - (void)dealloc
 {
-    // remove self from global linked list of accounts
-    if (gAccountListHead == self) {
-        gAccountListHead = _nextAccount;
-    } else {
-        LJAccount *accountList = gAccountListHead;
-
-        while (accountList) {
-            if (accountList->_nextAccount == self) {
-                accountList->_nextAccount = self->_nextAccount;
-                break;
-            }
-            accountList = accountList->_nextAccount;
-        }
-    }
+    // remove self from the global account list
+    [gAccountLock lock];
+    [gAccountList removeObjectIdenticalTo:self];
+    [self _reindexIdentifier:_identifier];
+    [gAccountLock unlock];
     [[NSNotificationCenter defaultCenter] removeObserver:nil name:nil
                                                   object:self];
+#if !OS_OBJECT_USE_OBJC
+    dispatch_release(_executorQueue);
+#endif
 }
 
 - (void)encodeWithCoder:(NSCoder *)encoder
@@ -309,20 +421,107 @@ static LJAccount *gAccountListHead = nil;
                    forKey:@"LJAccountDefaultUserpicURL"];
     [encoder encodeObject:_journalArray forKey:@"LJAccountJournals"];
     // editfriends fields
+    [self _lockState];
     [encoder encodeObject:_friendSet forKey:@"LJAccountFriends"];
     [encoder encodeObject:_removedFriendSet forKey:@"LJAccountExFriends"];
     [encoder encodeObject:_friendOfSet forKey:@"LJAcountFriendOfs"];
     [encoder encodeObject:_groupSet forKey:@"LJAccountGroups"];
     [encoder encodeObject:_removedGroupSet forKey:@"LJAccountExGroups"];
+    [self _unlockState];
     // custom info
     if ([_customInfo count] > 0) {
         [encoder encodeObject:_customInfo forKey:@"LJAccountCustomInfo"];
     }
 }
 
+- (NSData *)_archiveData
+{
+    LJAccountArchiveWriter *writer = [[LJAccountArchiveWriter alloc] init];
+    LJArchiveHeader header;
+    NSMutableData *data;
+    NSArray *sortedKeys;
+    NSUInteger count, i;
+
+    memset(&header, 0, sizeof(header));
+    header.username = [writer referenceForString:_username];
+    header.fullname = [writer referenceForString:_fullname];
+    header.serverURL = [writer referenceForString:[[_server URL] absoluteString]];
+    header.defaultUserPictureURL = [writer referenceForString:[_defaultUserPictureURL absoluteString]];
+    if (_moods) {
+        header.flags |= LJArchiveHasMoods;
+        [_moods _addToArchiveWriter:writer];
+    }
+    if (_userPicturesDictionary) {
+        header.flags |= LJArchiveHasUserPictures;
+        sortedKeys = [[_userPicturesDictionary allKeys] sortedArrayUsingSelector:@selector(compare:)];
+        count = [sortedKeys count];
+        data = [[NSMutableData alloc] initWithLength:count * sizeof(LJArchiveStringPair)];
+        LJArchiveStringPair *pairs = [data mutableBytes];
+        for (i = 0; i < count; i++) {
+            pairs[i].key = [writer referenceForString:sortedKeys[i]];
+            pairs[i].value = [writer referenceForString:[_userPicturesDictionary[sortedKeys[i]] absoluteString]];
+        }
+        [writer setData:data count:count forSection:LJArchiveUserPictureSection];
+    }
+    if (_journalArray) {
+        header.flags |= LJArchiveHasJournals;
+        count = [_journalArray count];
+        data = [[NSMutableData alloc] initWithLength:count * sizeof(LJArchiveStringRef)];
+        LJArchiveStringRef *names = [data mutableBytes];
+        for (i = 0; i < count; i++) {
+            names[i] = [writer referenceForString:[_journalArray[i] name]];
+        }
+        [writer setData:data count:count forSection:LJArchiveJournalSection];
+    }
+    // editfriends fields; a friend in several sets is written once.
+    [self _lockState];
+    if (_friendSet) header.flags |= LJArchiveHasFriends;
+    if (_removedFriendSet) header.flags |= LJArchiveHasRemovedFriends;
+    if (_friendOfSet) header.flags |= LJArchiveHasFriendOfs;
+    if (_groupSet) header.flags |= LJArchiveHasGroups;
+    if (_removedGroupSet) header.flags |= LJArchiveHasRemovedGroups;
+    NSMutableSet *everyone = [[NSMutableSet alloc] init];
+    if (_friendSet) [everyone unionSet:_friendSet];
+    if (_removedFriendSet) [everyone unionSet:_removedFriendSet];
+    if (_friendOfSet) [everyone unionSet:_friendOfSet];
+    count = [everyone count];
+    data = [[NSMutableData alloc] initWithLength:count * sizeof(LJArchiveFriendRecord)];
+    LJArchiveFriendRecord *friendRecords = [data mutableBytes];
+    i = 0;
+    for (LJFriend *buddy in everyone) {
+        LJArchiveFriendRecord *record = &friendRecords[i++];
+        [buddy _getArchiveRecord:record writer:writer];
+        if ([_friendSet containsObject:buddy]) record->membership |= LJArchiveInFriends;
+        if ([_removedFriendSet containsObject:buddy]) record->membership |= LJArchiveInRemovedFriends;
+        if ([_friendOfSet containsObject:buddy]) record->membership |= LJArchiveInFriendOfs;
+    }
+    [writer setData:data count:count forSection:LJArchiveFriendSection];
+    NSMutableSet *groups = [[NSMutableSet alloc] init];
+    if (_groupSet) [groups unionSet:_groupSet];
+    if (_removedGroupSet) [groups unionSet:_removedGroupSet];
+    count = [groups count];
+    data = [[NSMutableData alloc] initWithLength:count * sizeof(LJArchiveGroupRecord)];
+    LJArchiveGroupRecord *groupRecords = [data mutableBytes];
+    i = 0;
+    for (LJGroup *group in groups) {
+        LJArchiveGroupRecord *record = &groupRecords[i++];
+        [group _getArchiveRecord:record writer:writer];
+        if ([_groupSet containsObject:group]) record->membership |= LJArchiveInGroups;
+        if ([_removedGroupSet containsObject:group]) record->membership |= LJArchiveInRemovedGroups;
+    }
+    [writer setData:data count:count forSection:LJArchiveGroupSection];
+    [self _unlockState];
+    // custom info
+    if ([_customInfo count] > 0) {
+        data = [[NSKeyedArchiver archivedDataWithRootObject:_customInfo] mutableCopy];
+        [writer setData:data count:[data length] forSection:LJArchiveCustomInfoSection];
+    }
+    return [writer archiveDataWithHeader:&header];
+}
+
 - (BOOL)writeToFile:(NSString *)path
 {
-    return [NSKeyedArchiver archiveRootObject:self toFile:path];
+    return [[self _archiveData] writeToFile:path atomically:YES];
 }
 
 - (LJAccount *)account
@@ -381,6 +580,13 @@ static LJAccount *gAccountListHead = nil;
 }
 
 - (NSDictionary *)getReplyForMode:(NSString *)mode parameters:(NSDictionary *)parameters
+{
+    return [self getReplyForMode:mode parameters:parameters
+                        priority:LJDefaultPriorityForRequest(mode, parameters)];
+}
+
+- (NSDictionary *)getReplyForMode:(NSString *)mode parameters:(NSDictionary *)parameters
+                         priority:(LJRequestPriority)priority
 {
     static int connectionID = 1; // to be mostly unique across invocations
     NSDictionary *reply = nil;
@@ -388,6 +594,10 @@ static LJAccount *gAccountListHead = nil;
     NSException *exception = nil;
     NSNotificationCenter *noticeCenter = [NSNotificationCenter defaultCenter];
     NSMutableDictionary *info;
+    NSString *requestKey = nil, *journalName = nil;
+    BOOL isCacheable = NO;
+    // When the request that produced the reply went out, if this call sent it.
+    __block CFAbsoluteTime requestTime = 0;
 
     if ([_delegate respondsToSelector:@selector(accountShouldConnect:)] &&
         ( ! [_delegate accountShouldConnect:self] )) {
@@ -396,6 +606,15 @@ static LJAccount *gAccountListHead = nil;
     if ( ! (_isLoggedIn || [mode isEqualToString:@"login"]) ) {
         [[self _exceptionWithName:@"LJNotLoggedInError"] raise];
     }
+    journalName = parameters[@"usejournal"] ?: [self username];
+    if (LJModeIsReadOnly(mode)) {
+        requestKey = LJCreateCanonicalRequestKey(mode, parameters);
+        isCacheable = [_replyCache _canCacheMode:mode parameters:parameters];
+        if (isCacheable) {
+            reply = [_replyCache _replyForKey:requestKey];
+            if (reply) return reply;
+        }
+    }
     // Post LJAccountWillConnectNotification
     info = [[NSMutableDictionary alloc] init];
     info[@"LJMode"] = mode;
@@ -411,7 +630,17 @@ static LJAccount *gAccountListHead = nil;
 	
     // Do the dirty deed.
     @try {
-        reply = [_server getReplyForMode:mode parameters:parameters];
+        if (requestKey) {
+            // Identical read-only requests made while one is already
+            // in flight wait for and share its reply.
+            LJServer *server = _server;
+            reply = [_singleFlight replyForKey:requestKey fetchBlock:^NSDictionary *{
+                requestTime = CFAbsoluteTimeGetCurrent();
+                return [server getReplyForMode:mode parameters:parameters priority:priority];
+            }];
+        } else {
+            reply = [_server getReplyForMode:mode parameters:parameters priority:priority];
+        }
         success = reply[@"success"];
         if (success == nil) {
             exception = [self _exceptionWithName:@"LJNoSuccessKeyError"];
@@ -432,6 +661,15 @@ static LJAccount *gAccountListHead = nil;
             exception = localException;
         };
     }
+    // Callers who shared another's reply leave caching to the one who sent
+    // the request, since only it knows when the request went out.
+    if (isCacheable && exception == nil && requestTime > 0) {
+        [_replyCache _setReply:reply forKey:requestKey mode:mode journalName:journalName
+                   requestTime:requestTime];
+    }
+    // Even a failed write may have reached the server, so forget anything
+    // it could have changed either way.
+    [_replyCache _removeRepliesInvalidatedByMode:mode journalName:journalName];
     // Post LJAccountDidConnectNotification
     if (reply) info[@"LJReply"] = reply;
     if (exception) info[@"LJException"] = exception;
@@ -449,6 +687,25 @@ static LJAccount *gAccountListHead = nil;
     return reply;
 }
 
+- (void)performBlock:(void (^)(LJAccount *account))block
+{
+    dispatch_async(_executorQueue, ^{
+        block(self);
+    });
+}
+
+- (void)performBlockAndWait:(void (^)(LJAccount *account))block
+{
+    // Running synchronously on our own queue would deadlock.
+    if (dispatch_get_specific(&kExecutorQueueKey) == (__bridge void *)self) {
+        block(self);
+    } else {
+        dispatch_sync(_executorQueue, ^{
+            block(self);
+        });
+    }
+}
+
 - (void)createUserPicturesDictionary:(NSDictionary *)reply
 {
     NSString *key;
@@ -527,6 +784,7 @@ static LJAccount *gAccountListHead = nil;
 		
         [localException raise];
     }
+    [self _lockState];
     // get the full name of the account
     [self _setFullname:reply[@"name"]];
     // get the login message, if present
@@ -538,8 +796,6 @@ static LJAccount *gAccountListHead = nil;
         _server.useFastServers = YES;
     }
     journals = [LJJournal _journalArrayFromLoginReply:reply account:self];
-	// [FS] Changed this from direct ivar access for KVO reasons
-	[self setJournalArray: journals];
     if (loginFlags & LJGetMoodsLoginFlag) {
         [_moods updateMoodsWithLoginReply:reply];
     }
@@ -551,6 +807,10 @@ static LJAccount *gAccountListHead = nil;
     }
     [self updateGroupSetWithReply:reply];
     _isLoggedIn = YES;
+    [self _unlockState];
+	// [FS] Changed this from direct ivar access for KVO reasons
+    // Set after unlocking, since it notifies observers.
+	[self setJournalArray: journals];
     [self didChangeValueForKey:@"loggedIn"];
 	// Get tag lists for main journal
 	LJJournal *j = [self defaultJournal];
@@ -674,12 +934,43 @@ static LJAccount *gAccountListHead = nil;
     return _customInfo;
 }
 
-- (NSString *)identifier
+/*
+ * Points the index entry for identifier at the first account in the list
+ * which has it, or removes the entry if there is none.  Must be called with
+ * gAccountLock held.
+ */
+- (void)_reindexIdentifier:(NSString *)identifier
+{
+    if (identifier == nil) return;
+    if (gAccountsByIdentifier[identifier] != self) return;
+    [gAccountsByIdentifier removeObjectForKey:identifier];
+    for (LJAccount *account in gAccountList) {
+        if (account != self && [account->_identifier isEqualToString:identifier]) {
+            gAccountsByIdentifier[identifier] = account;
+            break;
+        }
+    }
+}
+
+- (void)_updateIdentifier
 {
     NSURL *serverURL = [_server URL];
     int p = [[serverURL port] intValue];
-    return [NSString stringWithFormat:@"%@@%@:%u",
+    NSString *newIdentifier, *oldIdentifier;
+
+    newIdentifier = [NSString stringWithFormat:@"%@@%@:%u",
         [self username], [serverURL host], (p != 0 ? p : 80)];
+    [gAccountLock lock];
+    oldIdentifier = _identifier;
+    if (![oldIdentifier isEqualToString:newIdentifier]) {
+        [self setIdentifier:newIdentifier];
+        [self _reindexIdentifier:oldIdentifier];
+        // The first account registered under an identifier keeps it.
+        if (gAccountsByIdentifier[newIdentifier] == nil) {
+            gAccountsByIdentifier[newIdentifier] = self;
+        }
+    }
+    [gAccountLock unlock];
 }
 
 - (void)_registerDelegateForNotification:(NSString *)n selector:(SEL)s
@@ -715,11 +1006,30 @@ static LJAccount *gAccountListHead = nil;
     return NO;
 }
 
+// Agrees with isEqual:, so it changes along with the identifier; see the
+// identifier documentation.
+- (NSUInteger)hash
+{
+    return [[self identifier] hash];
+}
+
 - (NSComparisonResult)compare:(LJAccount *)account
 {
     return [[self identifier] compare:[account identifier]];
 }
 
+- (LJFriendsSnapshot *)friendsSnapshot
+{
+    // Edits only mark the snapshot stale; the first reader after a run of
+    // edits pays for publishing it.
+    if (atomic_load_explicit(&_friendsSnapshotIsStale, memory_order_acquire)) {
+        [self _lockState];
+        if (atomic_load_explicit(&_friendsSnapshotIsStale, memory_order_relaxed)) [self _publishFriendsSnapshot];
+        [self _unlockState];
+    }
+    return [self _publishedFriendsSnapshot];
+}
+
 - (NSString *)description
 {
     return [self identifier];
@@ -731,6 +1041,9 @@ static LJAccount *gAccountListHead = nil;
     if ([theKey isEqualToString:@"friendArray"]) {
         automatic=NO;
     } 
+	else if ([theKey isEqualToString:@"friendOfArray"]) {
+        automatic=NO;
+    }
 	else if ([theKey isEqualToString:@"groupArray"]) {
         automatic=NO;
     }
@@ -0,0 +1,174 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Cocoa/Cocoa.h>
+
+#ifndef __private_extern
+#define __private_extern __attribute__((visibility("hidden")))
+#endif
+
+/*
+ * The binary account archive written by -[LJAccount writeToFile:].
+ *
+ * The file is a fixed header followed by sections of fixed-size records,
+ * each section starting on an 8-byte boundary.  Strings are stored once,
+ * in a string table at the end, and records refer to them by index, so a
+ * group name or account type shared by thousands of friends costs four
+ * bytes a friend.  Colors are packed 0xRRGGBB ints and dates are seconds
+ * since the reference date, so a friend is one 72-byte record rather than
+ * a dozen keyed objects.  Numbers are in the host's byte order.
+ *
+ * Readers reject a file whose version they don't know; a change to any
+ * record layout must bump LJAccountArchiveVersion.
+ */
+
+#define LJAccountArchiveVersion 1
+
+// An index into the string table; LJArchiveNoString stands for nil.
+typedef uint32_t LJArchiveStringRef;
+#define LJArchiveNoString UINT32_MAX
+
+// Set in a packed color when there is a color at all.
+#define LJArchiveColorPresent (1u << 24)
+
+typedef NS_ENUM(unsigned int, LJArchiveSectionIndex) {
+    LJArchiveStringSection,         // count strings; see below
+    LJArchiveFriendSection,         // LJArchiveFriendRecord
+    LJArchiveGroupSection,          // LJArchiveGroupRecord
+    LJArchiveMoodSection,           // LJArchiveStringPair, name -> mood ID
+    LJArchiveUserPictureSection,    // LJArchiveStringPair, keyword -> URL
+    LJArchiveJournalSection,        // LJArchiveStringRef, journal name
+    LJArchiveCustomInfoSection,     // a keyed archive; count is its length
+    LJArchiveSectionCount
+};
+
+/*
+ * The string section is count + 1 uint32_t offsets into the UTF-8 bytes
+ * which follow them; string i runs from offset i to offset i + 1.
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t count;
+} LJArchiveSection;
+
+// Which of the account's sets exist (nil sets are distinct from empty ones).
+enum {
+    LJArchiveHasFriends = 1 << 0,
+    LJArchiveHasRemovedFriends = 1 << 1,
+    LJArchiveHasFriendOfs = 1 << 2,
+    LJArchiveHasGroups = 1 << 3,
+    LJArchiveHasRemovedGroups = 1 << 4,
+    LJArchiveHasMoods = 1 << 5,
+    LJArchiveHasUserPictures = 1 << 6,
+    LJArchiveHasJournals = 1 << 7
+};
+
+typedef struct {
+    char magic[8];                  // "LJACCT\0\0"
+    uint32_t version;
+    uint32_t flags;
+    LJArchiveStringRef username;
+    LJArchiveStringRef fullname;
+    LJArchiveStringRef serverURL;
+    LJArchiveStringRef defaultUserPictureURL;
+    LJArchiveSection sections[LJArchiveSectionCount];
+} LJArchiveHeader;
+
+// Which of the account's sets a friend or group record belongs to.
+enum {
+    LJArchiveInFriends = 1 << 0,
+    LJArchiveInRemovedFriends = 1 << 1,
+    LJArchiveInFriendOfs = 1 << 2
+};
+enum {
+    LJArchiveInGroups = 1 << 0,
+    LJArchiveInRemovedGroups = 1 << 1
+};
+
+typedef struct {
+    LJArchiveStringRef username;
+    LJArchiveStringRef fullname;
+    LJArchiveStringRef accountType;
+    LJArchiveStringRef accountStatus;
+    uint32_t foregroundColor;
+    uint32_t backgroundColor;
+    uint32_t foregroundColorForYou;
+    uint32_t backgroundColorForYou;
+    uint32_t groupMask;
+    uint8_t friendship;
+    uint8_t membership;
+    uint16_t reserved;
+    double birthDate;
+    double modifiedDate;
+    double addedIncomingDate;
+    double addedOutgoingDate;
+} LJArchiveFriendRecord;
+
+typedef struct {
+    LJArchiveStringRef name;
+    uint8_t number;
+    uint8_t sortOrder;
+    uint8_t isPublic;
+    uint8_t membership;
+    double createdDate;
+    double modifiedDate;
+} LJArchiveGroupRecord;
+
+typedef struct {
+    LJArchiveStringRef key;
+    LJArchiveStringRef value;
+} LJArchiveStringPair;
+
+// Colors are stored as calibrated RGB, as the server sends them.
+__private_extern uint32_t LJArchiveColorForColor(NSColor *color);
+__private_extern NSColor *LJColorForArchiveColor(uint32_t color);
+
+// nil dates are stored as NAN.
+__private_extern double LJArchiveTimeForDate(NSDate *date);
+__private_extern NSDate *LJDateForArchiveTime(double time);
+
+/*
+ * Builds an archive.  Records are filled in by the objects they describe,
+ * which turn their strings into references as they go.
+ */
+@interface LJAccountArchiveWriter : NSObject
+- (LJArchiveStringRef)referenceForString:(NSString *)string;
+// data holds count records, or count bytes for the custom info section.
+- (void)setData:(NSData *)data count:(NSUInteger)count forSection:(LJArchiveSectionIndex)section;
+// Fills in the magic, version, sections and string table of the header.
+- (NSData *)archiveDataWithHeader:(LJArchiveHeader *)header;
+@end
+
+/*
+ * Reads an archive in place, typically from a mapped file.  The whole
+ * layout is checked up front, so the record accessors can't run off the
+ * end of a damaged file.  Each string is made once, however many records
+ * refer to it.
+ */
+@interface LJAccountArchiveReader : NSObject
++ (BOOL)isArchiveData:(NSData *)data;
+// Returns nil if the data is not a valid archive of a known version.
+- (instancetype)initWithData:(NSData *)data;
+@property (nonatomic, readonly) const LJArchiveHeader *header;
+- (const void *)recordsInSection:(LJArchiveSectionIndex)section count:(NSUInteger *)count;
+- (NSData *)dataInSection:(LJArchiveSectionIndex)section;
+- (NSString *)stringForReference:(LJArchiveStringRef)reference;
+@end
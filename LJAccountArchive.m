@@ -0,0 +1,249 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJAccountArchive.h"
+
+static const char kArchiveMagic[8] = "LJACCT\0\0";
+
+// Each section starts on this boundary, so records holding doubles are aligned.
+static const NSUInteger kSectionAlignment = 8;
+
+// The size of one record in each section; the string and custom info
+// sections are sized by hand.
+static const size_t kRecordSizes[LJArchiveSectionCount] = {
+    0,
+    sizeof(LJArchiveFriendRecord),
+    sizeof(LJArchiveGroupRecord),
+    sizeof(LJArchiveStringPair),
+    sizeof(LJArchiveStringPair),
+    sizeof(LJArchiveStringRef),
+    1
+};
+
+uint32_t LJArchiveColorForColor(NSColor *color)
+{
+    NSColor *rgbColor;
+
+    if (color == nil) return 0;
+    rgbColor = [color colorUsingColorSpaceName:NSCalibratedRGBColorSpace];
+    if (rgbColor == nil) return 0;
+    return (LJArchiveColorPresent |
+            ((uint32_t)lround(255.0 * [rgbColor redComponent]) << 16) |
+            ((uint32_t)lround(255.0 * [rgbColor greenComponent]) << 8) |
+            (uint32_t)lround(255.0 * [rgbColor blueComponent]));
+}
+
+NSColor *LJColorForArchiveColor(uint32_t color)
+{
+    if (!(color & LJArchiveColorPresent)) return nil;
+    return [NSColor colorWithCalibratedRed:((color >> 16) & 0xFF) / 255.0
+                                     green:((color >> 8) & 0xFF) / 255.0
+                                      blue:(color & 0xFF) / 255.0
+                                     alpha:1.0];
+}
+
+double LJArchiveTimeForDate(NSDate *date)
+{
+    return date ? [date timeIntervalSinceReferenceDate] : NAN;
+}
+
+NSDate *LJDateForArchiveTime(double time)
+{
+    return isnan(time) ? nil : [NSDate dateWithTimeIntervalSinceReferenceDate:time];
+}
+
+@implementation LJAccountArchiveWriter
+{
+    NSMutableDictionary *_referencesByString;
+    NSMutableArray *_strings;
+    NSData *_sectionData[LJArchiveSectionCount];
+    NSUInteger _sectionCounts[LJArchiveSectionCount];
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _referencesByString = [[NSMutableDictionary alloc] init];
+        _strings = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (LJArchiveStringRef)referenceForString:(NSString *)string
+{
+    NSNumber *reference;
+
+    if (string == nil) return LJArchiveNoString;
+    reference = _referencesByString[string];
+    if (reference == nil) {
+        reference = @([_strings count]);
+        _referencesByString[string] = reference;
+        [_strings addObject:string];
+    }
+    return [reference unsignedIntValue];
+}
+
+- (void)setData:(NSData *)data count:(NSUInteger)count forSection:(LJArchiveSectionIndex)section
+{
+    NSParameterAssert(section != LJArchiveStringSection && section < LJArchiveSectionCount);
+    NSParameterAssert([data length] == count * kRecordSizes[section]);
+    _sectionData[section] = [data copy];
+    _sectionCounts[section] = count;
+}
+
+- (NSData *)_stringTableData
+{
+    NSUInteger count = [_strings count];
+    NSMutableData *bytes = [[NSMutableData alloc] init];
+    NSMutableData *table = [[NSMutableData alloc] initWithLength:(count + 1) * sizeof(uint32_t)];
+    uint32_t *offsets = [table mutableBytes];
+
+    for (NSUInteger i = 0; i < count; i++) {
+        NSData *utf8 = [_strings[i] dataUsingEncoding:NSUTF8StringEncoding];
+        offsets[i] = (uint32_t)[bytes length];
+        [bytes appendData:utf8];
+    }
+    offsets[count] = (uint32_t)[bytes length];
+    [table appendData:bytes];
+    return table;
+}
+
+- (NSData *)archiveDataWithHeader:(LJArchiveHeader *)header
+{
+    NSMutableData *data = [[NSMutableData alloc] initWithLength:sizeof(LJArchiveHeader)];
+
+    _sectionData[LJArchiveStringSection] = [self _stringTableData];
+    _sectionCounts[LJArchiveStringSection] = [_strings count];
+    memcpy(header->magic, kArchiveMagic, sizeof(header->magic));
+    header->version = LJAccountArchiveVersion;
+    for (NSUInteger i = 0; i < LJArchiveSectionCount; i++) {
+        NSUInteger padding = (kSectionAlignment - [data length] % kSectionAlignment) % kSectionAlignment;
+        [data increaseLengthBy:padding];
+        header->sections[i].offset = (uint32_t)[data length];
+        header->sections[i].count = (uint32_t)_sectionCounts[i];
+        if (_sectionData[i]) [data appendData:_sectionData[i]];
+    }
+    [data replaceBytesInRange:NSMakeRange(0, sizeof(LJArchiveHeader)) withBytes:header];
+    return data;
+}
+
+@end
+
+@implementation LJAccountArchiveReader
+{
+    NSData *_data;
+    const uint8_t *_bytes;
+    const uint32_t *_stringOffsets;
+    const char *_stringBytes;
+    NSUInteger _stringCount;
+    __strong NSString **_strings;
+}
+
++ (BOOL)isArchiveData:(NSData *)data
+{
+    return ([data length] >= sizeof(kArchiveMagic) &&
+            memcmp([data bytes], kArchiveMagic, sizeof(kArchiveMagic)) == 0);
+}
+
+- (instancetype)initWithData:(NSData *)data
+{
+    self = [super init];
+    if (self) {
+        const LJArchiveHeader *header;
+        NSUInteger length = [data length];
+        const LJArchiveSection *strings;
+        NSUInteger tableLength;
+
+        if (![[self class] isArchiveData:data] || length < sizeof(LJArchiveHeader)) return nil;
+        _data = data;
+        _bytes = [data bytes];
+        header = (const LJArchiveHeader *)_bytes;
+        if (header->version != LJAccountArchiveVersion) return nil;
+        for (NSUInteger i = 1; i < LJArchiveSectionCount; i++) {
+            const LJArchiveSection *section = &header->sections[i];
+            if (section->offset % kSectionAlignment != 0 ||
+                section->offset > length ||
+                (uint64_t)section->count * kRecordSizes[i] > length - section->offset) {
+                return nil;
+            }
+        }
+        // The string table: offsets must fit, ascend and stay in bounds.
+        strings = &header->sections[LJArchiveStringSection];
+        if (strings->offset % kSectionAlignment != 0 || strings->offset > length) return nil;
+        tableLength = ((NSUInteger)strings->count + 1) * sizeof(uint32_t);
+        if (tableLength > length - strings->offset) return nil;
+        _stringCount = strings->count;
+        _stringOffsets = (const uint32_t *)(_bytes + strings->offset);
+        _stringBytes = (const char *)(_bytes + strings->offset + tableLength);
+        for (NSUInteger i = 0; i < _stringCount; i++) {
+            if (_stringOffsets[i] > _stringOffsets[i + 1]) return nil;
+        }
+        if (_stringOffsets[_stringCount] > length - strings->offset - tableLength) return nil;
+        _strings = (__strong NSString **)calloc(MAX(_stringCount, 1), sizeof(NSString *));
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_strings) {
+        for (NSUInteger i = 0; i < _stringCount; i++) {
+            _strings[i] = nil;
+        }
+        free(_strings);
+    }
+}
+
+- (const LJArchiveHeader *)header
+{
+    return (const LJArchiveHeader *)_bytes;
+}
+
+- (const void *)recordsInSection:(LJArchiveSectionIndex)section count:(NSUInteger *)count
+{
+    const LJArchiveSection *info = &[self header]->sections[section];
+
+    *count = info->count;
+    return _bytes + info->offset;
+}
+
+- (NSData *)dataInSection:(LJArchiveSectionIndex)section
+{
+    const LJArchiveSection *info = &[self header]->sections[section];
+
+    if (info->count == 0) return nil;
+    return [_data subdataWithRange:NSMakeRange(info->offset, info->count)];
+}
+
+- (NSString *)stringForReference:(LJArchiveStringRef)reference
+{
+    if (reference >= _stringCount) return nil;
+    if (_strings[reference] == nil) {
+        // Invalid UTF-8 comes back nil, as a missing string would.
+        _strings[reference] = [[NSString alloc] initWithBytes:_stringBytes + _stringOffsets[reference]
+                                                       length:_stringOffsets[reference + 1] - _stringOffsets[reference]
+                                                     encoding:NSUTF8StringEncoding];
+    }
+    return _strings[reference];
+}
+
+@end
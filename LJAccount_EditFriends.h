@@ -21,6 +21,7 @@
 
 #import <Foundation/Foundation.h>
 #import "LJAccount.h"
+#import "LJFriend.h"
 
 @class LJFriend, LJGroup;
 
@@ -70,6 +71,8 @@ NS_ASSUME_NONNULL_BEGIN
  Returns a sorted NSArray containing the user's friends in the form of LJFriend
  objects.
  If the friends list hasn't been downloaded, returns nil.
+ Observers are sent indexed insertion and removal changes as friends are
+ added and removed.
  This property is preserved during archiving.
 */
 @property (NS_NONATOMIC_IOSONLY, readonly, copy, nullable) NSArray *friendArray;
@@ -184,6 +187,44 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (NS_NONATOMIC_IOSONLY, readonly, copy, nullable) NSSet *joinedCommunitySet;
 
+/*!
+ @method relationshipsWithAccountType:accountStatus:groupMask:friendship:
+ @abstract Returns the relationships that match every given criterion.
+ @discussion
+ Pass nil or 0 for a criterion that shouldn't be tested.  accountType and
+ accountStatus are compared with the LJFriend properties of the same name;
+ "personal" and "active" match the blank type and status of a regular,
+ active user.  A relationship matches groupMask if it is in any of its
+ groups, and friendship if it has any of its bits.
+
+ The criteria are evaluated over packed attribute columns rather than by
+ asking each LJFriend, so queries stay fast with thousands of relationships.
+ For example, the active communities in group 3 are
+ [account relationshipsWithAccountType:@"community" accountStatus:@"active"
+ groupMask:(1 << 3) friendship:0].
+ @result A sorted NSArray of LJFriend objects.
+ */
+- (NSArray<LJFriend*> *)relationshipsWithAccountType:(nullable NSString *)accountType
+                                       accountStatus:(nullable NSString *)accountStatus
+                                           groupMask:(unsigned int)groupMask
+                                          friendship:(LJFriendship)friendship;
+
+/*!
+ @method relationshipsWithBirthdaysFromDate:toDate:
+ @abstract Returns the relationships whose birthdays fall between two dates.
+ @discussion
+ Only the month and day of each date count, and both ends are included.
+ If endDate falls earlier in the year than startDate, the range runs over
+ New Year.  Relationships without a birthday never match.  Like
+ relationshipsWithAccountType:accountStatus:groupMask:friendship:, this
+ is evaluated over packed columns.  For example, the birthdays in the
+ coming week are
+ [account relationshipsWithBirthdaysFromDate:now
+ toDate:[now dateByAddingTimeInterval:6 * 86400]].
+ @result A sorted NSArray of LJFriend objects.
+ */
+- (NSArray<LJFriend*> *)relationshipsWithBirthdaysFromDate:(NSDate *)startDate toDate:(NSDate *)endDate;
+
 /*!
  @method friendNamed:
  @abstract Returns the friend with the given name.
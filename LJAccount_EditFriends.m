@@ -27,23 +27,380 @@
 #import "LJAccount_Private.h"
 #import "LJGroup_Private.h"
 #import "LJFriend_Private.h"
+#import "LJFriendsSnapshot_Private.h"
+#import "LJFriendColumns.h"
 #import "Miscellaneous.h"
 
+/*
+ * Binary searches a sorted array of friends or groups for object.
+ */
+static NSUInteger LJSortedIndexOfObject(NSArray *array, id object, NSBinarySearchingOptions options)
+{
+    return [array indexOfObject:object inSortedRange:NSMakeRange(0, [array count])
+                        options:options usingComparator:^(id a, id b) {
+                            return [a compare:b];
+                        }];
+}
+
+/*
+ * Finds object itself in a sorted array.  Falls back to a linear scan when
+ * the binary search misses, which happens if a group was renamed or
+ * reordered since it was inserted.
+ */
+static NSUInteger LJIndexOfSortedObjectIdenticalTo(NSArray *array, id object)
+{
+    NSUInteger index = LJSortedIndexOfObject(array, object, NSBinarySearchingFirstEqual);
+
+    if (index != NSNotFound && array[index] == object) return index;
+    return [array indexOfObjectIdenticalTo:object];
+}
+
+// Bits 1-30 of a group mask name groups; bit 0 is not a group.
+static const unsigned int kAllGroupBits = 0x7FFFFFFE;
+
 @implementation LJAccount (EditFriends)
 
+/*
+ * _stateLock is taken and released through these, so that KVO
+ * notifications for the sorted arrays are sent once the outermost holder
+ * has let go.  An observer may then call back into the account, from any
+ * thread, without deadlocking on the lock.
+ */
+- (void)_lockState
+{
+    [_stateLock lock];
+    _stateLockDepth++;
+}
+
+- (void)_unlockState
+{
+    NSArray *changes = nil;
+
+    if (--_stateLockDepth == 0 && [_pendingArrayChanges count] > 0) {
+        changes = _pendingArrayChanges;
+        _pendingArrayChanges = nil;
+    }
+    [_stateLock unlock];
+    if (changes) [self _sendArrayChanges:changes];
+}
+
+// Records a change already made to a sorted array; called with the lock held.
+- (void)_queueChange:(NSKeyValueChange)kind valuesAtIndexes:(NSIndexSet *)indexes forKey:(NSString *)key
+{
+    if (_pendingArrayChanges == nil) _pendingArrayChanges = [[NSMutableArray alloc] init];
+    [_pendingArrayChanges addObject:@{@"kind": @(kind), @"indexes": [indexes copy], @"key": key}];
+}
+
+/*
+ * Sends the notifications for changes made under the lock.  The snapshot
+ * is only marked stale between the will and did halves, so observers
+ * asking for old values get the arrays as they were.  A key changed once
+ * is reported with its indexes; a key changed several times is reported
+ * as a whole, since the indexes of the changes in between describe arrays
+ * no snapshot ever held.
+ */
+- (void)_sendArrayChanges:(NSArray *)changes
+{
+    NSMutableArray *keys = [[NSMutableArray alloc] init];
+    NSMutableDictionary *changesByKey = [[NSMutableDictionary alloc] init];
+
+    for (NSDictionary *change in changes) {
+        NSString *key = change[@"key"];
+        if (changesByKey[key] == nil) {
+            [keys addObject:key];
+            changesByKey[key] = change;
+        } else {
+            changesByKey[key] = [NSNull null];
+        }
+    }
+    for (NSString *key in keys) {
+        NSDictionary *change = changesByKey[key];
+        if ([change isKindOfClass:[NSDictionary class]]) {
+            [self willChange:[change[@"kind"] unsignedIntegerValue] valuesAtIndexes:change[@"indexes"] forKey:key];
+        } else {
+            [self willChangeValueForKey:key];
+        }
+    }
+    atomic_store_explicit(&_friendsSnapshotIsStale, true, memory_order_release);
+    for (NSString *key in [keys reverseObjectEnumerator]) {
+        NSDictionary *change = changesByKey[key];
+        if ([change isKindOfClass:[NSDictionary class]]) {
+            [self didChange:[change[@"kind"] unsignedIntegerValue] valuesAtIndexes:change[@"indexes"] forKey:key];
+        } else {
+            [self didChangeValueForKey:key];
+        }
+    }
+}
+
+/*
+ * The sorted arrays below are only changed with _stateLock held, and each
+ * change is reported to observers of key as an indexed insertion or removal
+ * once the lock is released.
+ */
+- (void)_insertObject:(id)object intoSortedArray:(NSMutableArray *)array forKey:(NSString *)key
+{
+    NSUInteger index = LJSortedIndexOfObject(array, object, (NSBinarySearchingInsertionIndex |
+                                                             NSBinarySearchingLastEqual));
+    NSIndexSet *indexes = [NSIndexSet indexSetWithIndex:index];
+
+    [array insertObject:object atIndex:index];
+    [self _queueChange:NSKeyValueChangeInsertion valuesAtIndexes:indexes forKey:key];
+}
+
+- (void)_removeObject:(id)object fromSortedArray:(NSMutableArray *)array forKey:(NSString *)key
+{
+    NSUInteger index = LJIndexOfSortedObjectIdenticalTo(array, object);
+    NSIndexSet *indexes;
+
+    if (index == NSNotFound) return;
+    indexes = [NSIndexSet indexSetWithIndex:index];
+    [array removeObjectAtIndex:index];
+    [self _queueChange:NSKeyValueChangeRemoval valuesAtIndexes:indexes forKey:key];
+}
+
+/*
+ * Brings a sorted array in line with a set after a download, reporting one
+ * removal of everything that left and one insertion of everything that
+ * arrived.  Departures are removed in place and each arrival is inserted
+ * at the index a binary search finds, so only the arrivals are sorted and
+ * a sync that changes nothing costs a single pass.  Nothing is reported,
+ * and the snapshot isn't marked stale, unless the array changed.
+ */
+- (void)_updateSortedArray:(NSMutableArray *)array toObjects:(NSSet *)objects forKey:(NSString *)key
+{
+    NSMutableIndexSet *indexes = [NSMutableIndexSet indexSet];
+    NSMutableSet *arrivalSet = [objects mutableCopy];
+    NSUInteger index = 0;
+
+    for (id object in array) {
+        if ([objects member:object] == object) {
+            [arrivalSet removeObject:object];
+        } else {
+            [indexes addIndex:index];
+        }
+        index++;
+    }
+    if ([indexes count] > 0) {
+        [array removeObjectsAtIndexes:indexes];
+        [self _queueChange:NSKeyValueChangeRemoval valuesAtIndexes:indexes forKey:key];
+    }
+    if ([arrivalSet count] > 0) {
+        NSArray *arrivals = [[arrivalSet allObjects] sortedArrayUsingSelector:@selector(compare:)];
+        NSUInteger *targets = malloc([arrivals count] * sizeof(NSUInteger));
+        NSUInteger i = 0;
+
+        // Arrivals go in ascending order, so the i-th lands i places after
+        // where it would go among the objects already there.
+        indexes = [NSMutableIndexSet indexSet];
+        for (id object in arrivals) {
+            targets[i] = LJSortedIndexOfObject(array, object, (NSBinarySearchingInsertionIndex |
+                                                               NSBinarySearchingLastEqual)) + i;
+            [indexes addIndex:targets[i]];
+            i++;
+        }
+        i = 0;
+        for (id object in arrivals) {
+            [array insertObject:object atIndex:targets[i++]];
+        }
+        [self _queueChange:NSKeyValueChangeInsertion valuesAtIndexes:indexes forKey:key];
+        free(targets);
+    }
+}
+
+- (void)_resortFriendsAndGroups
+{
+    [self _lockState];
+    [_sortedFriendArray setArray:[[_friendSet allObjects] sortedArrayUsingSelector:@selector(compare:)]];
+    [_sortedFriendOfArray setArray:[[_friendOfSet allObjects] sortedArrayUsingSelector:@selector(compare:)]];
+    [_sortedGroupArray setArray:[[_groupSet allObjects] sortedArrayUsingSelector:@selector(compare:)]];
+    atomic_store_explicit(&_friendsSnapshotIsStale, true, memory_order_release);
+    [self _rebuildGroupIndex];
+    [self _rebuildUsernameIndex];
+    [self _unlockState];
+}
+
+- (LJFriend *)_knownFriendWithUsername:(NSString *)username
+{
+    LJFriend *buddy;
+
+    if (username == nil) return nil;
+    [self _lockState];
+    buddy = [_friendsByUsername objectForKey:username];
+    [self _unlockState];
+    return buddy;
+}
+
+- (void)_indexFriend:(LJFriend *)buddy
+{
+    [self _lockState];
+    [_friendsByUsername setObject:buddy forKey:[buddy username]];
+    [self _unlockState];
+}
+
+- (void)_rebuildUsernameIndex
+{
+    [self _lockState];
+    [_friendsByUsername removeAllObjects];
+    for (LJFriend *buddy in _friendSet) [self _indexFriend:buddy];
+    for (LJFriend *buddy in _friendOfSet) [self _indexFriend:buddy];
+    for (LJFriend *buddy in _removedFriendSet) [self _indexFriend:buddy];
+    [self _unlockState];
+}
+
+- (void)_groupSortKeyDidChange:(LJGroup *)group
+{
+    [self _lockState];
+    if ([_sortedGroupArray indexOfObjectIdenticalTo:group] != NSNotFound) {
+        [self _removeObject:group fromSortedArray:_sortedGroupArray forKey:@"groupArray"];
+        [self _insertObject:group intoSortedArray:_sortedGroupArray forKey:@"groupArray"];
+    }
+    [self _unlockState];
+}
+
+/*
+ * The membership index is updated as masks change, one step per changed bit,
+ * and rebuilt whole only when a download replaces the friends and groups.
+ */
+- (void)_addFriend:(LJFriend *)buddy toGroupsWithMask:(unsigned int)mask
+{
+    mask &= kAllGroupBits;
+    while (mask) {
+        int number = __builtin_ctz(mask);
+        NSMutableArray *members = _groupMembers[number];
+
+        mask &= mask - 1;
+        if (members == nil) {
+            members = [[NSMutableArray alloc] init];
+            _groupMembers[number] = members;
+        }
+        [members insertObject:buddy atIndex:LJSortedIndexOfObject(members, buddy, NSBinarySearchingInsertionIndex)];
+    }
+}
+
+- (void)_removeFriend:(LJFriend *)buddy fromGroupsWithMask:(unsigned int)mask
+{
+    mask &= kAllGroupBits;
+    while (mask) {
+        int number = __builtin_ctz(mask);
+        NSMutableArray *members = _groupMembers[number];
+        NSUInteger index = LJIndexOfSortedObjectIdenticalTo(members, buddy);
+
+        mask &= mask - 1;
+        if (index != NSNotFound) [members removeObjectAtIndex:index];
+    }
+}
+
+- (void)_rebuildGroupIndex
+{
+    [self _lockState];
+    for (int number = 1; number <= 30; number++) {
+        _groupsByNumber[number] = nil;
+        [_groupMembers[number] removeAllObjects];
+    }
+    for (LJGroup *group in _groupSet) {
+        _groupsByNumber[[group number]] = group;
+    }
+    // Walking the friends in order keeps every member list sorted.
+    for (LJFriend *buddy in _sortedFriendArray) {
+        unsigned int mask = [buddy groupMask] & kAllGroupBits;
+
+        while (mask) {
+            int number = __builtin_ctz(mask);
+
+            mask &= mask - 1;
+            if (_groupMembers[number] == nil) {
+                _groupMembers[number] = [[NSMutableArray alloc] init];
+            }
+            [_groupMembers[number] addObject:buddy];
+        }
+    }
+    [self _unlockState];
+}
+
+- (void)_friend:(LJFriend *)buddy groupMaskDidChangeFrom:(unsigned int)oldMask
+{
+    unsigned int newMask = [buddy groupMask];
+
+    [self _lockState];
+    [_friendColumns updateGroupMaskOfFriend:buddy];
+    // Removed friends keep their masks but belong to no group.
+    if ([_friendSet member:buddy] == buddy) {
+        [self _removeFriend:buddy fromGroupsWithMask:(oldMask & ~newMask)];
+        [self _addFriend:buddy toGroupsWithMask:(newMask & ~oldMask)];
+    }
+    [self _unlockState];
+}
+
+- (NSArray *)_membersOfGroup:(LJGroup *)group
+{
+    NSArray *members;
+
+    [self _lockState];
+    members = [_groupMembers[[group number]] copy];
+    [self _unlockState];
+    return members ?: @[];
+}
+
+- (NSArray *)_nonMembersOfGroup:(LJGroup *)group
+{
+    NSMutableArray *nonMembers;
+    NSArray *members;
+    NSUInteger i = 0, count;
+
+    [self _lockState];
+    members = _groupMembers[[group number]];
+    count = [members count];
+    nonMembers = [[NSMutableArray alloc] initWithCapacity:([_sortedFriendArray count] - count)];
+    // Both arrays are sorted by username, so one pass separates them.
+    for (LJFriend *buddy in _sortedFriendArray) {
+        if (i < count && members[i] == buddy) {
+            i++;
+        } else {
+            [nonMembers addObject:buddy];
+        }
+    }
+    [self _unlockState];
+    return nonMembers;
+}
+
 - (void)updateGroupSetWithReply:(NSDictionary *)reply
 {
+    [self _lockState];
     _removedGroupSet = nil;
-    if (_groupSet == nil) _groupSet = [[NSMutableSet alloc] initWithCapacity:30];
+    if (_groupSet == nil) {
+        // A set that was nil and is now empty still changes the snapshot.
+        _groupSet = [[NSMutableSet alloc] initWithCapacity:30];
+        atomic_store_explicit(&_friendsSnapshotIsStale, true, memory_order_release);
+    }
     [LJGroup updateGroupSet:_groupSet withReply:reply account:self];
     _groupsSyncDate = [[NSDate alloc] init];
-	
-	// Update the static ordered array cache
-	if(_orderedGroupArrayCache) {
-		[self willChangeValueForKey: @"groupArray"];
-		_orderedGroupArrayCache = [[_groupSet allObjects] sortedArrayUsingSelector: @selector(compare:)];
-		[self didChangeValueForKey: @"groupArray"];
-	}
+    [self _updateSortedArray:_sortedGroupArray toObjects:_groupSet forKey:@"groupArray"];
+    [self _rebuildGroupIndex];
+    [self _unlockState];
+}
+
+- (void)_updateFriendsWithReply:(NSDictionary *)reply
+{
+    [self _lockState];
+    _removedFriendSet = nil;
+    if (_friendSet == nil || _friendOfSet == nil) {
+        // Sets that were nil and are now empty still change the snapshot.
+        if (_friendSet == nil) _friendSet = [[NSMutableSet alloc] init];
+        if (_friendOfSet == nil) _friendOfSet = [[NSMutableSet alloc] init];
+        atomic_store_explicit(&_friendsSnapshotIsStale, true, memory_order_release);
+    }
+    [LJFriend updateFriendSet:_friendSet withReply:reply account:self];
+    [LJFriend updateFriendOfSet:_friendOfSet withReply:reply account:self];
+    _friendsSyncDate = [[NSDate alloc] init];
+    // Drop anyone who is neither a friend nor a friend-of any more.
+    [self _rebuildUsernameIndex];
+    [self _updateSortedArray:_sortedFriendArray toObjects:_friendSet forKey:@"friendArray"];
+    [self _updateSortedArray:_sortedFriendOfArray toObjects:_friendOfSet forKey:@"friendOfArray"];
+    [self updateGroupSetWithReply:reply];
+    // The download may have changed a type, status or birthday without
+    // changing who is in the arrays, which leaves the snapshot as it was.
+    if (_friendColumns && ![_friendColumns matchesFriends]) _friendColumns = nil;
+    [self _unlockState];
 }
 
 - (void)downloadFriends
@@ -59,13 +416,9 @@
                    @"includefriendof": @"1",
                    @"includegroups": @"1"};
     NSDictionary *reply = [self getReplyForMode:@"getfriends" parameters:parameters];
-    _removedFriendSet = nil;
-    if (_friendSet == nil) _friendSet = [[NSMutableSet alloc] init];
-    [LJFriend updateFriendSet:_friendSet withReply:reply account:self];
-    if (_friendOfSet == nil) _friendOfSet = [[NSMutableSet alloc] init];
-    [LJFriend updateFriendOfSet:_friendOfSet withReply:reply account:self];
-    _friendsSyncDate = [[NSDate alloc] init];
-    [self updateGroupSetWithReply:reply];
+    // The request is made without the lock, so readers on other threads are
+    // only held up while the reply is applied.
+    [self _updateFriendsWithReply:reply];
 	
 	note = [NSNotification notificationWithName: LJAccountDidDownloadFriendsNotification object: self];
     dispatch_async(dispatch_get_main_queue(), ^{
@@ -77,10 +430,16 @@
 {
     int i = 1;
     NSDictionary *reply;
+    NSDate *syncDate;
+    NSSet *sentRemovals;
 
     NSMutableDictionary *parameters = [[NSMutableDictionary alloc] init];
+    [self _lockState];
+    // Anything edited from here on is newer than what we are about to send.
+    syncDate = [[NSDate alloc] init];
+    sentRemovals = [_removedFriendSet copy];
     // Add Parameters for Friends to Remove
-    for (LJFriend *buddy in _removedFriendSet) {
+    for (LJFriend *buddy in sentRemovals) {
         [buddy _addDeleteFieldsToParameters:parameters];
     }
     // Add Parameters for Friends to Add/Change
@@ -89,22 +448,19 @@
             [buddy _addAddFieldsToParameters:parameters index:(i++)];
         }
     }
+    [self _unlockState];
     // If there is nothing to change, quit.
     if ([parameters count] == 0) return NO;
     // Send information to the server.
     reply = [self getReplyForMode:@"editfriends" parameters:parameters];
+    [self _lockState];
     // Update the friend objects.
-    [LJFriend updateFriendSet:_friendSet withEditReply:reply];
-    // Clean up.
-    _removedFriendSet = nil;
-    _friendsSyncDate = [[NSDate alloc] init];
-	
-	if(_orderedFriendArrayCache) {
-		// The underlying set changed, so update the cache
-		[self willChangeValueForKey: @"friendArray"];
-		_orderedFriendArrayCache = [[_friendSet allObjects] sortedArrayUsingSelector:@selector(compare:)];
-		[self didChangeValueForKey: @"friendArray"];
-	}
+    [LJFriend updateFriendSet:_friendSet withEditReply:reply account:self];
+    // Clean up, keeping removals made while the request was in flight.
+    [_removedFriendSet minusSet:sentRemovals];
+    if ([_removedFriendSet count] == 0) _removedFriendSet = nil;
+    _friendsSyncDate = syncDate;
+    [self _unlockState];
 
     return YES;
 }
@@ -112,30 +468,35 @@
 - (BOOL)_uploadGroups
 {
     NSMutableDictionary *parameters;
-    NSEnumerator *e;
-    LJGroup *group;
+    NSDate *syncDate;
+    NSSet *sentRemovals;
 
     parameters = [NSMutableDictionary dictionary];
+    [self _lockState];
+    syncDate = [[NSDate alloc] init];
+    sentRemovals = [_removedGroupSet copy];
     // Add Parameters for Friends to Remove
-    e = [_removedGroupSet objectEnumerator];
-    while (group = [e nextObject]) {
+    for (LJGroup *group in sentRemovals) {
         [group _addDeleteFieldsToParameters:parameters];
     }
     // Add Parameters for Friends to Add/Change
-    e = [_groupSet objectEnumerator];
-    while (group = [e nextObject]) {
+    for (LJGroup *group in _groupSet) {
         NSDate *modDate = [group modifiedDate];
         if ([_groupsSyncDate compare:modDate] == NSOrderedAscending) {
             [group _addAddFieldsToParameters:parameters];
         }
     }
+    [self _unlockState];
     // If there is nothing to change, quit.
     if ([parameters count] == 0) return NO;
     // Send information to the server.
     [self getReplyForMode:@"editfriendgroups" parameters:parameters];
     // Clean up.
-    _removedGroupSet = nil;
-    _groupsSyncDate = [[NSDate alloc] init];
+    [self _lockState];
+    [_removedGroupSet minusSet:sentRemovals];
+    if ([_removedGroupSet count] == 0) _removedGroupSet = nil;
+    _groupsSyncDate = syncDate;
+    [self _unlockState];
     return YES;
 }
 
@@ -146,234 +507,279 @@
     return (groupsUpdated || friendsUpdated);
 }
 
+/*
+ * Publishes a snapshot of the sorted arrays as they stand.  Called with
+ * _stateLock held, by the friendsSnapshot getter, once a change has marked
+ * the current one stale.
+ */
+- (void)_publishFriendsSnapshot
+{
+    LJFriendsSnapshot *snapshot;
+
+    snapshot = [[LJFriendsSnapshot alloc] _initWithFriendArray:(_friendSet ? _sortedFriendArray : nil)
+                                                 friendOfArray:(_friendOfSet ? _sortedFriendOfArray : nil)
+                                                    groupArray:(_groupSet ? _sortedGroupArray : nil)
+                                                       version:([[self _publishedFriendsSnapshot] version] + 1)];
+    [self _setPublishedFriendsSnapshot:snapshot];
+    atomic_store_explicit(&_friendsSnapshotIsStale, false, memory_order_release);
+}
+
+// The readers below take the published snapshot with a single atomic load
+// and never lock, copy or sort.
+
 - (NSSet *)friendSet
 {
-    return [_friendSet copy];
+    return [[self friendsSnapshot] friendSet];
 }
         
 - (NSArray *)friendArray
 {
-	// Lazily create the cache the first time it's needed
-	 if(!_orderedFriendArrayCache)
-		_orderedFriendArrayCache = [[_friendSet allObjects] sortedArrayUsingSelector:@selector(compare:)];
-	
-	// return the cached array
-	return [_orderedFriendArrayCache copy];
+    return [[self friendsSnapshot] friendArray];
 }
 
 - (NSEnumerator *)friendEnumerator
 {
-    return [_friendSet objectEnumerator];
+    return [[[self friendsSnapshot] friendSet] objectEnumerator];
 }
 
 - (NSSet *)groupSet
 {
-    return [_groupSet copy];
+    return [[self friendsSnapshot] groupSet];
 }
 
 - (NSArray *)groupArray
 {
-	if(!_orderedGroupArrayCache)
-		_orderedGroupArrayCache = [[_groupSet allObjects] sortedArrayUsingSelector: @selector(compare:)];
-	
-    return [_orderedGroupArrayCache copy];
+    return [[self friendsSnapshot] groupArray];
 }
 
 - (NSEnumerator *)groupEnumerator
 {
-    return [_groupSet objectEnumerator];
+    return [[[self friendsSnapshot] groupSet] objectEnumerator];
 }
 
 - (NSSet *)friendOfSet
 {
-    return [_friendOfSet copy];
+    return [[self friendsSnapshot] friendOfSet];
 }
 
 - (NSArray *)friendOfArray
 {
-    return [[_friendOfSet allObjects] sortedArrayUsingSelector:@selector(compare:)];
+    return [[self friendsSnapshot] friendOfArray];
 }
 
-- (NSArray *)relationshipArray {
-	NSMutableSet *set = [[NSMutableSet alloc] init];
-	[set addObjectsFromArray: [self friendArray]];
-	[set addObjectsFromArray: [self friendOfArray]];
-	
-	return [[set allObjects] sortedArrayUsingSelector: @selector(compare:)];
+- (NSArray *)relationshipArray
+{
+    return [[self friendsSnapshot] relationshipArray] ?: @[];
 }
 
 - (NSEnumerator *)friendOfEnumerator
 {
-    return [_friendOfSet objectEnumerator];
+    return [[[self friendsSnapshot] friendOfSet] objectEnumerator];
 }
 
 - (LJFriend *)friendNamed:(NSString *)username
 {
     LJFriend *amigo;
-    amigo = [_friendSet member:username];
-    if (amigo) return amigo;
-    amigo = [_friendOfSet member:username];
+
+    [self _lockState];
+    amigo = [self _knownFriendWithUsername:username];
+    // The index also holds removed friends, who are neither.
+    if ([_friendSet member:amigo] != amigo && [_friendOfSet member:amigo] != amigo) {
+        amigo = nil;
+    }
+    [self _unlockState];
     return amigo;
 }
 
-- (void)_addFriendsToContainer:(id)container
-                       fromSet:(NSSet *)sourceSet
-                        ofType:(NSString *)accountType
+/*
+ * Runs a predicate over the columns for the current snapshot, building them
+ * first if the snapshot has changed since.  Group mask edits are written
+ * into the columns as they happen; downloads which change other attributes
+ * but not the snapshot discard the columns.
+ */
+- (NSArray *)_relationshipsMatchingPredicate:(LJFriendPredicate)predicate
 {
-    for (LJFriend *friend in sourceSet) {
-        if ([[friend accountType] isEqualToString:accountType]) {
-            [container addObject:friend];
-        }
+    LJFriendsSnapshot *snapshot;
+    NSArray *matches;
+
+    [self _lockState];
+    snapshot = [self friendsSnapshot];
+    if (_friendColumns == nil || [_friendColumns version] != [snapshot version]) {
+        _friendColumns = [[LJFriendColumns alloc] initWithFriends:([snapshot relationshipArray] ?: @[])
+                                                          version:[snapshot version]];
     }
+    matches = [_friendColumns friendsMatchingPredicate:predicate];
+    [self _unlockState];
+    return matches;
 }
 
-- (NSArray *)watchedCommunityArray
+- (NSArray *)relationshipsWithAccountType:(NSString *)accountType
+                            accountStatus:(NSString *)accountStatus
+                                groupMask:(unsigned int)groupMask
+                               friendship:(LJFriendship)friendship
 {
-    NSMutableArray *communities;
+    LJFriendPredicate predicate = { 0 };
 
-    if (_friendSet == nil) return nil;
-    communities = [[NSMutableArray alloc] initWithCapacity:[_friendSet count]];
-    [self _addFriendsToContainer:communities fromSet:_friendSet
-                          ofType:@"community"];
-    [communities sortUsingSelector:@selector(compare:)];
-    return communities;
+    if (accountType) predicate.typeCode = LJFriendTypeCodeForString(accountType);
+    if (accountStatus) predicate.statusCode = LJFriendStatusCodeForString(accountStatus);
+    predicate.groupMask = groupMask;
+    predicate.friendship = (uint8_t)(friendship & LJFriendshipMutual);
+    return [self _relationshipsMatchingPredicate:predicate];
 }
 
-- (NSSet *)watchedCommunitySet
+- (NSArray *)relationshipsWithBirthdaysFromDate:(NSDate *)startDate toDate:(NSDate *)endDate
+{
+    LJFriendPredicate predicate = { 0 };
+    NSArray *matches;
+
+    NSParameterAssert(startDate && endDate);
+    predicate.firstBirthday = LJFriendBirthdayCodeForDate(startDate);
+    predicate.lastBirthday = LJFriendBirthdayCodeForDate(endDate);
+    if (predicate.firstBirthday <= predicate.lastBirthday) {
+        return [self _relationshipsMatchingPredicate:predicate];
+    }
+    // Over New Year: the end of the year, then the start of the next.
+    predicate.lastBirthday = 366;
+    matches = [self _relationshipsMatchingPredicate:predicate];
+    predicate.firstBirthday = 1;
+    predicate.lastBirthday = LJFriendBirthdayCodeForDate(endDate);
+    matches = [matches arrayByAddingObjectsFromArray:[self _relationshipsMatchingPredicate:predicate]];
+    return [matches sortedArrayUsingSelector:@selector(compare:)];
+}
+
+- (NSArray *)_communitiesWithFriendship:(LJFriendship)friendship
 {
-    NSMutableSet *communities;
+    LJFriendPredicate predicate = { 0 };
 
-    if (_friendSet == nil) return nil;
-    communities = [NSMutableSet setWithCapacity:[_friendSet count]];
-    [self _addFriendsToContainer:communities fromSet:_friendSet
-                          ofType:@"community"];
-    return [communities copy];
+    predicate.typeCode = LJFriendTypeCommunity;
+    predicate.friendship = (uint8_t)friendship;
+    return [self _relationshipsMatchingPredicate:predicate];
 }
 
-- (NSArray *)joinedCommunityArray
+- (NSArray *)watchedCommunityArray
 {
-    NSMutableArray *communities;
+    if ([self friendSet] == nil) return nil;
+    return [self _communitiesWithFriendship:LJFriendshipOutgoing];
+}
 
-    if (_friendOfSet == nil) return nil;
-    communities = [[NSMutableArray alloc] initWithCapacity:[_friendOfSet count]];
-    [self _addFriendsToContainer:communities fromSet:_friendOfSet
-                          ofType:@"community"];
-    [communities sortUsingSelector:@selector(compare:)];
-    return [communities copy];
+- (NSSet *)watchedCommunitySet
+{
+    if ([self friendSet] == nil) return nil;
+    return [NSSet setWithArray:[self _communitiesWithFriendship:LJFriendshipOutgoing]];
 }
 
-- (NSSet *)joinedCommunitySet
+- (NSArray *)joinedCommunityArray
 {
-    NSMutableSet *communities;
+    if ([self friendOfSet] == nil) return nil;
+    return [self _communitiesWithFriendship:LJFriendshipIncoming];
+}
 
-    if (_friendOfSet == nil) return nil;
-    communities = [NSMutableSet setWithCapacity:[_friendOfSet count]];
-    [self _addFriendsToContainer:communities fromSet:_friendOfSet
-                          ofType:@"community"];
-    return [communities copy];
+- (NSSet *)joinedCommunitySet
+{
+    if ([self friendOfSet] == nil) return nil;
+    return [NSSet setWithArray:[self _communitiesWithFriendship:LJFriendshipIncoming]];
 }
 
 - (LJFriend *)addFriendWithUsername:(NSString *)username;
 {
     LJFriend *buddy;
 
-    buddy = [_friendSet member:username];
-    if (buddy) {
+    [self _lockState];
+    // One probe of the username index, then identity tests on the sets.
+    buddy = [self _knownFriendWithUsername:username];
+    if (buddy && [_friendSet member:buddy] == buddy) {
         // Nothing to do.
+        [self _unlockState];
         return buddy;
     }
-    buddy = [_removedFriendSet member:username];
-    if (buddy) {
+    if (buddy && [_removedFriendSet member:buddy] == buddy) {
         // Move back to friend set.
         [_friendSet addObject:buddy];
         [_removedFriendSet removeObject:buddy];
         [buddy _setOutgoingFriendship:YES];
+        [self _insertObject:buddy intoSortedArray:_sortedFriendArray forKey:@"friendArray"];
+        [self _addFriend:buddy toGroupsWithMask:[buddy groupMask]];
+        [self _unlockState];
         return buddy;
     }
-    buddy = [_friendOfSet member:username];
-    if (buddy) {
+    if (buddy && [_friendOfSet member:buddy] == buddy) {
         // Move from friend of set.
         [_friendSet addObject:buddy];
         [buddy _setOutgoingFriendship:YES];
+        [self _insertObject:buddy intoSortedArray:_sortedFriendArray forKey:@"friendArray"];
+        [self _addFriend:buddy toGroupsWithMask:[buddy groupMask]];
+        [self _unlockState];
         return buddy;
     }
     buddy = [[LJFriend alloc] initWithUsername:username account:self];
     [buddy _setOutgoingFriendship:YES];
     [_friendSet addObject:buddy];
-	
-
-	if(_orderedFriendArrayCache) {
-		// The underlying set changed, so change the cache
-		[self willChangeValueForKey: @"friendArray"];
-		_orderedFriendArrayCache = [[_friendSet allObjects] sortedArrayUsingSelector:@selector(compare:)];
-		[self didChangeValueForKey: @"friendArray"];
-	}
+    [self _indexFriend:buddy];
+    [self _insertObject:buddy intoSortedArray:_sortedFriendArray forKey:@"friendArray"];
+    [self _unlockState];
 	
     return buddy;
 }
 
 - (void)removeFriend:(LJFriend *)buddy
 {
+    [self _lockState];
     if (_removedFriendSet == nil) {
         _removedFriendSet = [[NSMutableSet alloc] init];
     }
     [_removedFriendSet addObject:buddy];
     [_friendSet removeObject:buddy];
     [buddy _setOutgoingFriendship:NO];
-	
-	if(_orderedFriendArrayCache) {
-		[self willChangeValueForKey: @"friendArray"];
-		_orderedFriendArrayCache = [[_friendSet allObjects] sortedArrayUsingSelector:@selector(compare:)];
-		[self didChangeValueForKey: @"friendArray"];
-	}
+    [self _removeObject:buddy fromSortedArray:_sortedFriendArray forKey:@"friendArray"];
+    [self _removeFriend:buddy fromGroupsWithMask:[buddy groupMask]];
+    [self _unlockState];
 }
 
 - (LJGroup *)newGroupWithName:(NSString *)name
 {
     LJGroup *group;
-    unsigned int allGroupsMask;
     int number;
 
+    [self _lockState];
     if ([_groupSet count] == 30) {
+        [self _unlockState];
         [[self _exceptionWithName:@"LJGroupLimitReached"] raise];
     }
-    allGroupsMask = [self groupMaskFromSet:_groupSet];
-    for (number = 1; (1 << number) & allGroupsMask; number++);
+    for (number = 1; _groupsByNumber[number] != nil; number++);
     group = [[LJGroup alloc] initWithNumber:number account:self];
     [group setName:name];
     [_groupSet addObject:group];
-	
-	// Update the static ordered array cache
-	if(_orderedGroupArrayCache) {
-		[self willChangeValueForKey: @"groupArray"];
-		_orderedGroupArrayCache = [[_groupSet allObjects] sortedArrayUsingSelector: @selector(compare:)];
-		[self didChangeValueForKey: @"groupArray"];
-	}
+    _groupsByNumber[number] = group;
+    [self _insertObject:group intoSortedArray:_sortedGroupArray forKey:@"groupArray"];
+    [self _unlockState];
 	
     return group;
 }
 
 - (void)removeGroup:(LJGroup *)group
 {
+    [self _lockState];
     if (_removedGroupSet == nil) {
         _removedGroupSet = [[NSMutableSet alloc] init];
     }
     [_removedGroupSet addObject:group];
     [_groupSet removeObject:group];
-    // Remove all friends from this group.
-    for (LJFriend *buddy in _friendSet) {
-        [group removeFriend:buddy];
+    [self _removeObject:group fromSortedArray:_sortedGroupArray forKey:@"groupArray"];
+    _groupsByNumber[[group number]] = nil;
+    // Remove all friends from this group.  Only the members need touching,
+    // and they share one modification date.  Going from the end keeps each
+    // removal from the member list cheap.
+    NSDate *modifiedDate = [[NSDate alloc] init];
+    unsigned int groupMask = [group mask];
+    for (LJFriend *buddy in [[self _membersOfGroup:group] reverseObjectEnumerator]) {
+        [buddy _setGroupMask:([buddy groupMask] & ~groupMask) modifiedDate:modifiedDate];
     }
     for (LJFriend *buddy in _removedFriendSet) {
-        [group removeFriend:buddy];
+        if ([buddy groupMask] & groupMask) {
+            [buddy _setGroupMask:([buddy groupMask] & ~groupMask) modifiedDate:modifiedDate];
+        }
     }
-	
-	// Update the static ordered array cache
-	if(_orderedGroupArrayCache) {
-		[self willChangeValueForKey: @"groupArray"];
-		_orderedGroupArrayCache = [[_groupSet allObjects] sortedArrayUsingSelector: @selector(compare:)];
-		[self didChangeValueForKey: @"groupArray"];
-	}
+    [self _unlockState];
 }
 
 - (unsigned int)_groupMaskFromEnumerator:(NSEnumerator *)enumerator
@@ -398,9 +804,16 @@
 
 - (void)_addGroupsWithMask:(unsigned int)groupMask toContainer:(id)container
 {
-    for (LJGroup *group in [self groupEnumerator]) {
-        if ((groupMask & [group mask]) != 0) [container addObject:group];
+    unsigned int mask = groupMask & kAllGroupBits;
+
+    [self _lockState];
+    while (mask) {
+        LJGroup *group = _groupsByNumber[__builtin_ctz(mask)];
+
+        mask &= mask - 1;
+        if (group) [container addObject:group];
     }
+    [self _unlockState];
 }
 
 - (NSArray *)groupArrayFromMask:(unsigned int)groupMask
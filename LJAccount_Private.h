@@ -24,11 +24,64 @@
  */
 
 #import "LJAccount.h"
+#include <stdatomic.h>
+
+@class LJFriend, LJGroup, LJFriendColumns;
 
 @interface LJAccount ()
+{
+@package
+    // Serializes access to the account's mutable state, chiefly the friends
+    // and groups model.  Recursive, because mutators call one another.
+    // Never held across a request to the server.
+    NSRecursiveLock *_stateLock;
+    // How deeply the thread holding _stateLock holds it, and the KVO
+    // changes to the sorted arrays waiting for it to let go.  Guarded by
+    // _stateLock; see _lockState and _unlockState.
+    NSUInteger _stateLockDepth;
+    NSMutableArray *_pendingArrayChanges;
+    // The friends, friend-ofs and groups in compare: order, kept sorted as
+    // they are edited so a snapshot never has to sort.  Guarded by _stateLock.
+    NSMutableArray *_sortedFriendArray;
+    NSMutableArray *_sortedFriendOfArray;
+    NSMutableArray *_sortedGroupArray;
+    // Set when the sorted arrays have changed since the last snapshot was
+    // published.  Stored with release ordering after the change and loaded
+    // with acquire ordering by readers, who don't take the lock; at worst
+    // a reader racing an edit gets the previous snapshot.
+    atomic_bool _friendsSnapshotIsStale;
+    // The membership index, indexed by group number (1-30) and guarded by
+    // _stateLock.  _groupsByNumber holds the account's groups, so a mask
+    // decodes in one step per set bit; _groupMembers holds, for each bit,
+    // the friends in _friendSet whose mask has it, sorted by username.
+    LJGroup *_groupsByNumber[31];
+    NSMutableArray *_groupMembers[31];
+    // Packed attributes of the relationships in the snapshot with the same
+    // version, for predicate queries.  Built on demand; guarded by _stateLock.
+    LJFriendColumns *_friendColumns;
+    // Every LJFriend the account knows of, friends, friend-ofs and removed
+    // friends alike, keyed by username without regard to case.  Guarded by
+    // _stateLock.
+    NSMapTable *_friendsByUsername;
+}
 + (NSString *)_clientVersionForBundle:(NSBundle *)bundle;
 - (NSException *)_exceptionWithName:(NSString *)name;
 - (NSException *)_exceptionWithFormat:(NSString *)format, ...;
+- (void)_updateIdentifier;
+@property (atomic, strong, getter=_publishedFriendsSnapshot, setter=_setPublishedFriendsSnapshot:) LJFriendsSnapshot *publishedFriendsSnapshot;
+- (void)_publishFriendsSnapshot;
+- (void)_lockState;
+- (void)_unlockState;
+- (void)_resortFriendsAndGroups;
+- (void)_groupSortKeyDidChange:(LJGroup *)group;
+- (void)_rebuildGroupIndex;
+- (void)_friend:(LJFriend *)buddy groupMaskDidChangeFrom:(unsigned int)oldMask;
+- (NSArray *)_membersOfGroup:(LJGroup *)group;
+- (NSArray *)_nonMembersOfGroup:(LJGroup *)group;
+- (LJFriend *)_knownFriendWithUsername:(NSString *)username;
+- (void)_indexFriend:(LJFriend *)buddy;
+- (void)_rebuildUsernameIndex;
+- (void)_updateFriendsWithReply:(NSDictionary *)reply;
 @end
 
 static inline void RunOnMainThreadSync(dispatch_block_t theBlock)
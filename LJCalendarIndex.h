@@ -0,0 +1,53 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+/*
+ * Counts a journal's entries by day.  Counts are kept in a table for each
+ * year, alongside running totals for each month and for the year, so the
+ * count for a year, month or day is a couple of array lookups.  Adding or
+ * removing an entry updates the day and its totals in place.
+ *
+ * An index is safe to use from several threads at once.
+ */
+@interface LJCalendarIndex : NSObject
+
+// Builds an index from a getdaycounts reply, whose keys are "yyyy-MM-dd".
+- (instancetype)initWithDayCountsReply:(NSDictionary *)reply NS_DESIGNATED_INITIALIZER;
+
+// When the index was built from the server's counts, as a CFAbsoluteTime;
+// 0 once the index has been invalidated.
+@property (readonly) CFAbsoluteTime validationTime;
+- (void)invalidate;
+
+- (NSUInteger)countForYear:(NSInteger)year;
+- (NSUInteger)countForYear:(NSInteger)year month:(NSInteger)month;
+- (NSUInteger)countForYear:(NSInteger)year month:(NSInteger)month day:(NSInteger)day;
+
+// Adjusts the count for a day, clamping it at zero.
+- (void)addCount:(NSInteger)delta forYear:(NSInteger)year month:(NSInteger)month day:(NSInteger)day;
+
+// Returns the counts as a dictionary from the first moment of each day
+// (in calendar) with entries to an NSNumber.
+- (NSDictionary *)dayCountsWithCalendar:(NSCalendar *)calendar;
+
+@end
@@ -0,0 +1,199 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJCalendarIndex.h"
+
+typedef struct {
+    uint32_t yearTotal;
+    uint32_t monthTotals[12];
+    uint16_t dayCounts[12][31];
+} LJCalendarYear;
+
+// Parses "yyyy-MM-dd" without a date formatter; returns NO for any other key.
+static BOOL LJParseDayKey(NSString *key, NSInteger *year, NSInteger *month, NSInteger *day)
+{
+    unichar c[10];
+
+    if ([key length] != 10) return NO;
+    [key getCharacters:c range:NSMakeRange(0, 10)];
+    if (c[4] != '-' || c[7] != '-') return NO;
+    for (NSUInteger i = 0; i < 10; i++) {
+        if (i != 4 && i != 7 && (c[i] < '0' || c[i] > '9')) return NO;
+    }
+    *year = (c[0] - '0') * 1000 + (c[1] - '0') * 100 + (c[2] - '0') * 10 + (c[3] - '0');
+    *month = (c[5] - '0') * 10 + (c[6] - '0');
+    *day = (c[8] - '0') * 10 + (c[9] - '0');
+    return (*month >= 1 && *month <= 12 && *day >= 1 && *day <= 31);
+}
+
+@implementation LJCalendarIndex
+{
+    NSLock *_lock;
+    NSInteger _firstYear;
+    NSUInteger _yearCount;
+    LJCalendarYear *_years;
+}
+
+- (instancetype)init
+{
+    return [self initWithDayCountsReply:nil];
+}
+
+- (instancetype)initWithDayCountsReply:(NSDictionary *)reply
+{
+    self = [super init];
+    if (self) {
+        _lock = [[NSLock alloc] init];
+        [reply enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *value, BOOL *stop) {
+            NSInteger year, month, day;
+            if (LJParseDayKey(key, &year, &month, &day)) {
+                [self addCount:[value integerValue] forYear:year month:month day:day];
+            }
+        }];
+        _validationTime = CFAbsoluteTimeGetCurrent();
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_years);
+}
+
+- (void)invalidate
+{
+    [_lock lock];
+    _validationTime = 0;
+    [_lock unlock];
+}
+
+// Returns the table for a year, or NULL; must be called with _lock held.
+- (LJCalendarYear *)_year:(NSInteger)year
+{
+    if (_yearCount == 0 || year < _firstYear || year >= _firstYear + (NSInteger)_yearCount) {
+        return NULL;
+    }
+    return &_years[year - _firstYear];
+}
+
+// As _year:, but makes room for the year if needed.
+- (LJCalendarYear *)_makeYear:(NSInteger)year
+{
+    NSInteger firstYear, lastYear;
+    NSUInteger yearCount;
+    LJCalendarYear *years;
+
+    if ([self _year:year]) return [self _year:year];
+    firstYear = (_yearCount == 0) ? year : MIN(year, _firstYear);
+    lastYear = (_yearCount == 0) ? year : MAX(year, _firstYear + (NSInteger)_yearCount - 1);
+    yearCount = (NSUInteger)(lastYear - firstYear + 1);
+    years = calloc(yearCount, sizeof(LJCalendarYear));
+    if (_yearCount > 0) {
+        memcpy(&years[_firstYear - firstYear], _years, _yearCount * sizeof(LJCalendarYear));
+    }
+    free(_years);
+    _years = years;
+    _firstYear = firstYear;
+    _yearCount = yearCount;
+    return [self _year:year];
+}
+
+- (NSUInteger)countForYear:(NSInteger)year
+{
+    LJCalendarYear *y;
+    NSUInteger count;
+
+    [_lock lock];
+    y = [self _year:year];
+    count = y ? y->yearTotal : 0;
+    [_lock unlock];
+    return count;
+}
+
+- (NSUInteger)countForYear:(NSInteger)year month:(NSInteger)month
+{
+    LJCalendarYear *y;
+    NSUInteger count = 0;
+
+    if (month < 1 || month > 12) return 0;
+    [_lock lock];
+    y = [self _year:year];
+    if (y) count = y->monthTotals[month - 1];
+    [_lock unlock];
+    return count;
+}
+
+- (NSUInteger)countForYear:(NSInteger)year month:(NSInteger)month day:(NSInteger)day
+{
+    LJCalendarYear *y;
+    NSUInteger count = 0;
+
+    if (month < 1 || month > 12 || day < 1 || day > 31) return 0;
+    [_lock lock];
+    y = [self _year:year];
+    if (y) count = y->dayCounts[month - 1][day - 1];
+    [_lock unlock];
+    return count;
+}
+
+- (void)addCount:(NSInteger)delta forYear:(NSInteger)year month:(NSInteger)month day:(NSInteger)day
+{
+    LJCalendarYear *y;
+    NSInteger count;
+
+    if (month < 1 || month > 12 || day < 1 || day > 31 || delta == 0) return;
+    [_lock lock];
+    y = (delta > 0) ? [self _makeYear:year] : [self _year:year];
+    if (y) {
+        count = MIN(MAX(y->dayCounts[month - 1][day - 1] + delta, 0), UINT16_MAX);
+        delta = count - y->dayCounts[month - 1][day - 1];
+        y->dayCounts[month - 1][day - 1] = (uint16_t)count;
+        y->monthTotals[month - 1] += delta;
+        y->yearTotal += delta;
+    }
+    [_lock unlock];
+}
+
+- (NSDictionary *)dayCountsWithCalendar:(NSCalendar *)calendar
+{
+    NSMutableDictionary *dayCounts = [[NSMutableDictionary alloc] init];
+    NSDateComponents *comps = [[NSDateComponents alloc] init];
+
+    [_lock lock];
+    for (NSUInteger i = 0; i < _yearCount; i++) {
+        if (_years[i].yearTotal == 0) continue;
+        [comps setYear:_firstYear + i];
+        for (NSInteger m = 0; m < 12; m++) {
+            if (_years[i].monthTotals[m] == 0) continue;
+            [comps setMonth:m + 1];
+            for (NSInteger d = 0; d < 31; d++) {
+                if (_years[i].dayCounts[m][d] == 0) continue;
+                [comps setDay:d + 1];
+                NSDate *date = [calendar dateFromComponents:comps];
+                if (date) dayCounts[date] = @(_years[i].dayCounts[m][d]);
+            }
+        }
+    }
+    [_lock unlock];
+    return [dayCounts copy];
+}
+
+@end
@@ -25,7 +25,7 @@
 #import <Foundation/Foundation.h>
 #import <LJKit/LJEntryRoot.h>
 
-@class LJAccount, LJJournal, LJGroup;
+@class LJAccount, LJJournal, LJGroup, LJEntryProperties;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -73,7 +73,7 @@ FOUNDATION_EXPORT NSString * const LJEntryDidNotSaveToJournalNotification;
 {
 @protected
     NSString *_subject;
-    NSMutableDictionary *_properties;
+    LJEntryProperties *_properties;
     NSMutableDictionary *_customInfo;
 }
 
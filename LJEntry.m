@@ -23,13 +23,16 @@
  */
 
 #import "LJEntry_Private.h"
-#import "LJJournal.h"
+#import "LJJournal_Private.h"
 #import "LJGroup.h"
 #import "Miscellaneous.h"
 #import "URLEncoding.h"
 #import "LJAccount.h"
 #import "LJAccount_EditFriends.h"
 #import "LJMoods.h"
+#import "LJEntry_Metadata.h"
+#import "LJEntryProperties.h"
+#import "LJEntryStore.h"
 
 NSString * const LJEntryWillSaveToJournalNotification =
 @"LJEntryWillSaveToJournal";
@@ -44,6 +47,11 @@ NSString * const LJEntryDidNotSaveToJournalNotification =
 @end
 
 @implementation LJEntry
+{
+    // The date as last downloaded or saved; the day counts know it by this.
+    NSDate *_savedDate;
+    NSString *_outboxID;
+}
 @synthesize edited = _isEdited;
 @dynamic journal;
 @dynamic account;
@@ -54,57 +62,99 @@ NSString * const LJEntryDidNotSaveToJournalNotification =
     self = [super init];
     if (self) {
         _date = [[NSDate alloc] init];
-        _properties = [[NSMutableDictionary alloc] init];
+        _properties = [[LJEntryProperties alloc] init];
     }
     return self;
 }
 
 - (instancetype)initWithReply:(NSDictionary *)info prefix:(NSString *)prefix journal:(LJJournal *)journal
 {
-    self = [super initWithReply:info prefix:prefix journal:journal];
-    if (self) {
-        _subject = info[[prefix stringByAppendingString:@"subject"]];
-        /*
-         Parse Entry Metadata
-
-         Unlike the other data, which has keys of the form event_n_something,
-         LiveJournal sends metadata in a series of three keys: prop_n_itemid,
-         prop_n_name, and prop_n_value.  Thus, we must work backwards.  We use
-         allKeysForObject: with the entry's itemID.  Most keys will be of the
-         form prop_n_itemid.  We parse out the n using NSScanner to find the
-         property name and value, and place the pair in the _properties dictionary.
-         */
-        _properties = [[NSMutableDictionary alloc] init];
-        if (info[@"prop_count"]) {
-            NSScanner *scanner;
-            NSString *infoKey, *propName, *propValue;
-            int propIndex;
-            NSArray *infoKeys;
-            NSEnumerator *enumerator;
-
-            infoKeys = [info allKeysForObject:[NSString stringWithFormat:@"%u", _itemID]];
-            enumerator = [infoKeys objectEnumerator];
-            while (infoKey = [enumerator nextObject]) {
-                scanner = [[NSScanner alloc] initWithString:infoKey];
-                if ([scanner scanString:@"prop_" intoString:nil] &&
-                    [scanner scanInt:&propIndex] &&
-                    [scanner scanString:@"_itemid" intoString:nil])
-                {
-                    propName = [NSString stringWithFormat:@"prop_%d_name", propIndex];
-                    propValue = [NSString stringWithFormat:@"prop_%d_value", propIndex];
-                    _properties[info[propName]] = info[propValue];
-                }
+    return [super initWithReply:info prefix:prefix journal:journal];
+}
+
+- (void)_takeValuesFromReply:(NSDictionary *)info prefix:(NSString *)prefix
+{
+    [super _takeValuesFromReply:info prefix:prefix];
+    _subject = info[[prefix stringByAppendingString:@"subject"]];
+    _savedDate = _date;
+    /*
+     Parse Entry Metadata
+
+     Unlike the other data, which has keys of the form event_n_something,
+     LiveJournal sends metadata in a series of three keys: prop_n_itemid,
+     prop_n_name, and prop_n_value.  Thus, we must work backwards.  We use
+     allKeysForObject: with the entry's itemID.  Most keys will be of the
+     form prop_n_itemid.  We parse out the n using NSScanner to find the
+     property name and value, and place the pair in the _properties store.
+     */
+    _properties = [[LJEntryProperties alloc] init];
+    if (info[@"prop_count"]) {
+        NSScanner *scanner;
+        NSString *infoKey, *propName, *propValue;
+        int propIndex;
+        NSArray *infoKeys;
+        NSEnumerator *enumerator;
+
+        infoKeys = [info allKeysForObject:[NSString stringWithFormat:@"%u", _itemID]];
+        enumerator = [infoKeys objectEnumerator];
+        while (infoKey = [enumerator nextObject]) {
+            scanner = [[NSScanner alloc] initWithString:infoKey];
+            if ([scanner scanString:@"prop_" intoString:nil] &&
+                [scanner scanInt:&propIndex] &&
+                [scanner scanString:@"_itemid" intoString:nil])
+            {
+                propName = [NSString stringWithFormat:@"prop_%d_name", propIndex];
+                propValue = [NSString stringWithFormat:@"prop_%d_value", propIndex];
+                // Known properties are stored compactly; the names and
+                // short values of unknown ones are shared between entries.
+                _properties[LJInternString(info[propName])] = LJInternString(info[propValue]);
             }
         }
-		if (_properties[@"current_moodid"] != nil) {
-			// Save Mood Name for this ID
-			NSString *moodName = [[[_journal account] moods] MoodNameFromID: _properties[@"current_moodid"]];
-			if (moodName != nil ) {
-				_properties[@"current_mood_id_name"] = moodName;
-			}
+    }
+	if (_properties[@"current_moodid"] != nil) {
+		// Save Mood Name for this ID
+		NSString *moodName = [[[_journal account] moods] MoodNameFromID: _properties[@"current_moodid"]];
+		if (moodName != nil ) {
+			_properties[@"current_mood_id_name"] = moodName;
 		}
+	}
+}
+
+/*
+ * Brings the receiver up to date with a fresh copy from the server, and
+ * returns whether anything was taken from it.  Local edits that haven't
+ * been saved win.  The reply may be old (a lazy array keeps its reply as
+ * long as the caller keeps the array), so it is only taken if its revision
+ * is newer than the receiver's; a reply without revision data counts as
+ * the oldest, and never replaces what the receiver has.
+ */
+- (BOOL)_updateWithReply:(NSDictionary *)info prefix:(NSString *)prefix
+{
+    NSArray *keys = @[@"subject", @"content", @"date", @"securityMode",
+                      @"groupsAllowedAccessMask", @"posterUsername"];
+    LJEntry *fresh;
+    SInt64 freshTime, currentTime;
+
+    if (_isEdited) return NO;
+    fresh = [[LJEntry alloc] initWithReply:info prefix:prefix journal:_journal];
+    if ([fresh revisionNumber] < [self revisionNumber]) return NO;
+    if ([fresh revisionNumber] == [self revisionNumber]) {
+        freshTime = [fresh->_properties integerForProperty:LJEntryRevisionTimeProperty];
+        currentTime = [_properties integerForProperty:LJEntryRevisionTimeProperty];
+        if (freshTime <= currentTime) return NO;
     }
-    return self;
+    for (NSString *key in keys) [self willChangeValueForKey:key];
+    _aNum = fresh->_aNum;
+    _content = fresh->_content;
+    _posterUsername = fresh->_posterUsername;
+    _allowGroupMask = fresh->_allowGroupMask;
+    _security = fresh->_security;
+    _date = fresh->_date;
+    _savedDate = fresh->_date;
+    _subject = fresh->_subject;
+    _properties = fresh->_properties;
+    for (NSString *key in [keys reverseObjectEnumerator]) [self didChangeValueForKey:key];
+    return YES;
 }
 
 - (instancetype)initWithCoder:(NSCoder *)decoder
@@ -112,9 +162,11 @@ NSString * const LJEntryDidNotSaveToJournalNotification =
     self = [super initWithCoder:decoder];
     if (self) {
         _subject = [decoder decodeObjectForKey:@"LJEntrySubject"];
-        _properties = [[decoder decodeObjectForKey:@"LJEntryProperties"] mutableCopy];
+        _properties = [[LJEntryProperties alloc] initWithDictionary:[decoder decodeObjectForKey:@"LJEntryProperties"]];
         _customInfo = [[decoder decodeObjectForKey:@"LJEntryCustomInfo"] mutableCopy];
         _isEdited = [decoder decodeBoolForKey:@"LJEntryIsEdited"];
+        if (!_isEdited) _savedDate = _date;
+        _outboxID = [decoder decodeObjectForKey:@"LJEntryOutboxID"];
     }
     return self;
 }
@@ -123,8 +175,10 @@ NSString * const LJEntryDidNotSaveToJournalNotification =
 {
     [super encodeWithCoder:encoder];
     [encoder encodeObject:_subject forKey:@"LJEntrySubject"];
-    [encoder encodeObject:_properties forKey:@"LJEntryProperties"];
+    [encoder encodeObject:[_properties dictionaryRepresentation] forKey:@"LJEntryProperties"];
     [encoder encodeBool:_isEdited forKey:@"LJEntryIsEdited"];
+    // Lets an outbox find the itemID of a post queued before archiving.
+    if (_outboxID) [encoder encodeObject:_outboxID forKey:@"LJEntryOutboxID"];
     if ([_customInfo count] > 0) {
         [encoder encodeObject:_customInfo forKey:@"LJEntryCustomInfo"];
     }
@@ -220,26 +274,35 @@ NSString * const LJEntryDidNotSaveToJournalNotification =
     }
 }
 
-- (void)saveToJournal
+- (NSDate *)_savedDate
+{
+    return _savedDate;
+}
+
+- (NSString *)_outboxID
+{
+    return _outboxID;
+}
+
+- (void)_setOutboxID:(NSString *)outboxID
+{
+    _outboxID = [outboxID copy];
+}
+
+/*
+ * Compiles the postevent or editevent request which saves the entry as it
+ * stands.  An editevent request is one with an itemid.
+ */
+- (NSMutableDictionary *)_saveRequest
 {
     NSMutableDictionary *request;
-    NSDictionary *reply, *info;
-    NSString *mode, *propertyKey, *moodName, *moodID, *s;
-    NSEnumerator *propertyKeys;
-    NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+    NSString *moodName, *moodID, *s;
 
-    NSAssert(_journal != nil, (@"Must set a journal before attempting to save entry."));
-    [center postNotificationName:LJEntryWillSaveToJournalNotification
-                          object:self];
-    // Compile the request to be sent to the server
     request = [NSMutableDictionary dictionaryWithCapacity:20];
     if (![_journal isDefault]) {
         request[@"usejournal"] = [_journal name];
     }
-    if (_itemID == 0) {
-        mode = @"postevent";
-    } else {
-        mode = @"editevent";
+    if (_itemID != 0) {
         request[@"itemid"] = [NSString stringWithFormat:@"%u", _itemID];
     }
     if (_subject) request[@"subject"] = _subject;
@@ -247,7 +310,7 @@ NSString * const LJEntryDidNotSaveToJournalNotification =
     if (_date) {
 #define ourUnits NSCalendarUnitYear | NSCalendarUnitMonth | NSCalendarUnitDay | NSCalendarUnitHour | \
 NSCalendarUnitMinute
-        NSCalendar *gregCalendar = [NSCalendar calendarWithIdentifier:NSGregorianCalendar];
+        NSCalendar *gregCalendar = [NSCalendar calendarWithIdentifier:NSCalendarIdentifierGregorian];
         NSDateComponents *comps = [gregCalendar components:ourUnits fromDate:_date];
         request[@"year"] = [@(comps.year) stringValue];
         request[@"mon"] = [@(comps.month) stringValue];
@@ -278,7 +341,7 @@ NSCalendarUnitMinute
     // We can't do this in the setCurrentMood: method because the entry's journal
     // may not be set, or may change afterwards.
 	// This has been split out now. The mood name *can* be different from the ID.
-    moodName = (NSString *)_properties[@"current_mood_id_name"];
+    moodName = [_properties stringForProperty:LJEntryMoodIDNameProperty];
     if (moodName) {
         moodID = [[[_journal account] moods] IDStringForMoodName:moodName];
     } else {
@@ -291,11 +354,26 @@ NSCalendarUnitMinute
     }
 	[_properties removeObjectForKey:@"current_mood_id_name"]; // Never sent to the server
     // properties: must prefix "prop_" before keys
-    propertyKeys = [_properties keyEnumerator];
-    while (propertyKey = [propertyKeys nextObject]) {
-        request[[@"prop_" stringByAppendingString:propertyKey]] = _properties[propertyKey];
-    }
+    [_properties enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *value, BOOL *stop) {
+        request[[@"prop_" stringByAppendingString:key]] = value;
+    }];
     request[@"lineendings"] = @"unix";
+    return request;
+}
+
+- (void)saveToJournal
+{
+    NSMutableDictionary *request;
+    NSDictionary *reply, *info;
+    NSString *mode;
+    NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+
+    NSAssert(_journal != nil, (@"Must set a journal before attempting to save entry."));
+    [center postNotificationName:LJEntryWillSaveToJournalNotification
+                          object:self];
+    // Compile the request to be sent to the server
+    request = [self _saveRequest];
+    mode = (_itemID == 0) ? @"postevent" : @"editevent";
     // Send to the server
     @try {
         reply = [[_journal account] getReplyForMode:mode parameters:request];
@@ -305,19 +383,38 @@ NSCalendarUnitMinute
                               object:self userInfo:info];
         [localException raise];
     }
-    // Handle reply
+    [self _didSaveWithReply:reply];
+    _isEdited = NO;
+}
+
+/*
+ * Brings the entry and its journal up to date once the server has accepted
+ * a request from _saveRequest, and posts LJEntryDidSaveToJournalNotification.
+ */
+- (void)_didSaveWithReply:(NSDictionary *)reply
+{
+    NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+
     if (_itemID == 0) {
         _itemID = [reply[@"itemid"] intValue];
         _aNum = [reply[@"anum"] intValue];
+        [_journal _rememberEntry:self];
+        [_journal _entryDidMoveFromDate:nil toDate:_date];
+    } else if (_savedDate) {
+        [_journal _entryDidMoveFromDate:_savedDate toDate:_date];
+    } else {
+        // Nobody knows which day the entry used to count towards.
+        [_journal _invalidateDayCounts];
     }
+    _savedDate = _date;
+    [[_journal entryStore] addEntry:self];
     [center postNotificationName:LJEntryDidSaveToJournalNotification
                           object:self];
-    _isEdited = NO;
 }
 
-- (void)removeFromJournal
+- (void)_didRemoveFromJournal
 {
-    [super removeFromJournal];
+    [super _didRemoveFromJournal];
     self.edited = YES;
 }
 
@@ -0,0 +1,89 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Known boolean properties, stored as bits.
+typedef NS_ENUM(NSUInteger, LJEntryBooleanProperty) {
+    LJEntryPreformattedProperty,
+    LJEntryMarkdownProperty,
+    LJEntryNoCommentsProperty,
+    LJEntryBackdatedProperty,
+    LJEntryNoEmailProperty,
+    LJEntryUnknown8bitProperty,
+    LJEntryHasScreenedProperty,
+    LJEntryBooleanPropertyCount
+};
+
+// Known numeric properties, stored as integers.
+typedef NS_ENUM(NSUInteger, LJEntryIntegerProperty) {
+    LJEntryRevisionNumberProperty,
+    LJEntryRevisionTimeProperty,
+    LJEntryCommentAlterTimeProperty,
+    LJEntryMoodIDProperty,
+    LJEntryIntegerPropertyCount
+};
+
+// Known string properties, stored in fixed slots.
+typedef NS_ENUM(NSUInteger, LJEntryStringProperty) {
+    LJEntryMoodProperty,
+    LJEntryMoodIDNameProperty,
+    LJEntryMusicProperty,
+    LJEntryPictureKeywordProperty,
+    LJEntryLocationProperty,
+    LJEntryTagListProperty,
+    LJEntryScreeningProperty,
+    LJEntrySyndicatedIDProperty,
+    LJEntrySyndicatedLinkProperty,
+    LJEntryStringPropertyCount
+};
+
+/*
+ * The metadata properties of an entry.  Outwardly a dictionary of protocol
+ * property names to string values, as the server sends them; inside, the
+ * properties LJKit knows are kept in a bitfield, integer slots and string
+ * slots, and only unknown properties go in a dictionary.  The typed
+ * accessors reach a known property without looking up its name or parsing
+ * its value.
+ */
+@interface LJEntryProperties : NSObject <NSCopying>
+
+- (instancetype)init NS_DESIGNATED_INITIALIZER;
+- (instancetype)initWithDictionary:(nullable NSDictionary *)dictionary;
+
+// Dictionary-style access by property name.  Setting nil removes.
+- (nullable NSString *)objectForKeyedSubscript:(NSString *)key;
+- (void)setObject:(nullable NSString *)value forKeyedSubscript:(NSString *)key;
+- (void)removeObjectForKey:(NSString *)key;
+- (void)enumerateKeysAndObjectsUsingBlock:(void (^)(NSString *key, NSString *value, BOOL *stop))block;
+- (NSDictionary *)dictionaryRepresentation;
+
+- (BOOL)booleanForProperty:(LJEntryBooleanProperty)property;
+- (void)setBoolean:(BOOL)flag forProperty:(LJEntryBooleanProperty)property;
+- (int64_t)integerForProperty:(LJEntryIntegerProperty)property;
+- (nullable NSString *)stringForProperty:(LJEntryStringProperty)property;
+- (void)setString:(nullable NSString *)string forProperty:(LJEntryStringProperty)property;
+
+@end
+
+NS_ASSUME_NONNULL_END
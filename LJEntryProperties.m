@@ -0,0 +1,230 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJEntryProperties.h"
+#import "Miscellaneous.h"
+
+// Protocol names of the known properties, in enum order.
+static NSString * const kBooleanNames[LJEntryBooleanPropertyCount] = {
+    @"opt_preformatted", @"opt_markdown", @"opt_nocomments", @"opt_backdated",
+    @"opt_noemail", @"unknown8bit", @"hasscreened"
+};
+static NSString * const kIntegerNames[LJEntryIntegerPropertyCount] = {
+    @"revnum", @"revtime", @"commentalter", @"current_moodid"
+};
+static NSString * const kStringNames[LJEntryStringPropertyCount] = {
+    @"current_mood", @"current_mood_id_name", @"current_music",
+    @"picture_keyword", @"current_location", @"taglist", @"opt_screening",
+    @"syn_id", @"syn_link"
+};
+
+// Maps a property name to its slot: the kind in the high byte, the index
+// in the low byte.
+enum { kBooleanSlot = 1, kIntegerSlot, kStringSlot };
+static NSDictionary *gSlotsByName = nil;
+
+static inline NSUInteger SlotForName(NSString *name)
+{
+    return [gSlotsByName[name] unsignedIntegerValue];
+}
+
+@implementation LJEntryProperties
+{
+    uint16_t _booleansPresent;
+    uint16_t _booleanValues;
+    uint8_t _integersPresent;
+    int64_t _integers[LJEntryIntegerPropertyCount];
+    NSString *_strings[LJEntryStringPropertyCount];
+    NSMutableDictionary *_overflow;
+}
+
++ (void)initialize
+{
+    if (self == [LJEntryProperties class]) {
+        NSMutableDictionary *slots = [[NSMutableDictionary alloc] init];
+        NSUInteger i;
+
+        for (i = 0; i < LJEntryBooleanPropertyCount; i++) slots[kBooleanNames[i]] = @((kBooleanSlot << 8) | i);
+        for (i = 0; i < LJEntryIntegerPropertyCount; i++) slots[kIntegerNames[i]] = @((kIntegerSlot << 8) | i);
+        for (i = 0; i < LJEntryStringPropertyCount; i++) slots[kStringNames[i]] = @((kStringSlot << 8) | i);
+        gSlotsByName = [slots copy];
+    }
+}
+
+- (instancetype)init
+{
+    return [super init];
+}
+
+- (instancetype)initWithDictionary:(NSDictionary *)dictionary
+{
+    self = [self init];
+    if (self) {
+        for (NSString *key in dictionary) {
+            self[key] = dictionary[key];
+        }
+    }
+    return self;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    return [[LJEntryProperties alloc] initWithDictionary:[self dictionaryRepresentation]];
+}
+
+/*
+ * Parses a value for an integer slot.  Values that aren't plain decimal
+ * integers don't fit and go to the overflow dictionary instead, so they
+ * come back out exactly as they went in.
+ */
+static BOOL ParseInteger(NSString *value, int64_t *result)
+{
+    const char *s = [value UTF8String];
+    char *end;
+
+    // Only canonical forms, so the value reads back as it was written.
+    if (s == NULL || !(isdigit(*s) || *s == '-')) return NO;
+    if (*s == '0' && s[1] != '\0') return NO;
+    *result = strtoll(s, &end, 10);
+    return (*end == '\0');
+}
+
+- (NSString *)objectForKeyedSubscript:(NSString *)key
+{
+    NSUInteger slot = SlotForName(key), index = slot & 0xFF;
+
+    switch (slot >> 8) {
+        case kBooleanSlot:
+            if ((_booleansPresent & (1 << index)) == 0) break;
+            return (_booleanValues & (1 << index)) ? @"1" : @"0";
+        case kIntegerSlot:
+            if ((_integersPresent & (1 << index)) == 0) break;
+            return [NSString stringWithFormat:@"%lld", (long long)_integers[index]];
+        case kStringSlot:
+            return _strings[index];
+    }
+    return _overflow[key];
+}
+
+- (void)setObject:(NSString *)value forKeyedSubscript:(NSString *)key
+{
+    NSUInteger slot = SlotForName(key), index = slot & 0xFF;
+    int64_t number;
+
+    [_overflow removeObjectForKey:key];
+    switch (slot >> 8) {
+        case kBooleanSlot:
+            _booleansPresent &= ~(1 << index);
+            _booleanValues &= ~(1 << index);
+            if ([value isEqualToString:@"1"] || [value isEqualToString:@"0"]) {
+                [self setBoolean:[value isEqualToString:@"1"] forProperty:index];
+                return;
+            }
+            // Any other text is kept as it was sent, but still reads as
+            // true when it is a non-zero number, as it always has.
+            if ([value integerValue] != 0) _booleanValues |= (1 << index);
+            break;
+        case kIntegerSlot:
+            _integersPresent &= ~(1 << index);
+            _integers[index] = 0;
+            if (value && ParseInteger(value, &number)) {
+                _integers[index] = number;
+                _integersPresent |= (1 << index);
+                return;
+            }
+            break;
+        case kStringSlot:
+            [self setString:value forProperty:index];
+            return;
+    }
+    if (value == nil) return;
+    if (_overflow == nil) _overflow = [[NSMutableDictionary alloc] init];
+    _overflow[key] = [value copy];
+}
+
+- (void)removeObjectForKey:(NSString *)key
+{
+    self[key] = nil;
+}
+
+- (void)enumerateKeysAndObjectsUsingBlock:(void (^)(NSString *key, NSString *value, BOOL *stop))block
+{
+    BOOL stop = NO;
+    NSUInteger i;
+
+    for (i = 0; i < LJEntryBooleanPropertyCount && !stop; i++) {
+        if (_booleansPresent & (1 << i)) block(kBooleanNames[i], self[kBooleanNames[i]], &stop);
+    }
+    for (i = 0; i < LJEntryIntegerPropertyCount && !stop; i++) {
+        if (_integersPresent & (1 << i)) block(kIntegerNames[i], self[kIntegerNames[i]], &stop);
+    }
+    for (i = 0; i < LJEntryStringPropertyCount && !stop; i++) {
+        if (_strings[i]) block(kStringNames[i], _strings[i], &stop);
+    }
+    if (!stop) [[_overflow copy] enumerateKeysAndObjectsUsingBlock:block];
+}
+
+- (NSDictionary *)dictionaryRepresentation
+{
+    NSMutableDictionary *dictionary = [[NSMutableDictionary alloc] init];
+
+    [self enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *value, BOOL *stop) {
+        dictionary[key] = value;
+    }];
+    return dictionary;
+}
+
+- (BOOL)booleanForProperty:(LJEntryBooleanProperty)property
+{
+    return (_booleanValues & (1 << property)) != 0;
+}
+
+- (void)setBoolean:(BOOL)flag forProperty:(LJEntryBooleanProperty)property
+{
+    _booleansPresent |= (1 << property);
+    if (flag) {
+        _booleanValues |= (1 << property);
+    } else {
+        _booleanValues &= ~(1 << property);
+    }
+}
+
+- (int64_t)integerForProperty:(LJEntryIntegerProperty)property
+{
+    return _integers[property];
+}
+
+- (NSString *)stringForProperty:(LJEntryStringProperty)property
+{
+    return _strings[property];
+}
+
+- (void)setString:(NSString *)string forProperty:(LJEntryStringProperty)property
+{
+    _strings[property] = LJInternString([string copy]);
+}
+
+- (NSString *)description
+{
+    return [[self dictionaryRepresentation] description];
+}
+
+@end
@@ -28,7 +28,7 @@
 
 #import <Foundation/Foundation.h>
 
-@class LJAccount, LJJournal, LJGroup;
+@class LJAccount, LJJournal, LJGroup, LJUserEntity;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -146,6 +146,16 @@ FOUNDATION_EXPORT NSString * const LJEntryDidNotRemoveFromJournalNotification;
  */
 @property (NS_NONATOMIC_IOSONLY, readonly, copy) NSString *posterUsername;
 
+/*!
+ @property poster
+ @abstract The shared user entity for the entry's poster.
+ @discussion
+ Returns the entity that +[LJUserEntity userEntityWithUsername:server:]
+ gives for posterUsername on the account's server, so entries by the same
+ poster share one object.  Returns nil if posterUsername is nil.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, strong, nullable) LJUserEntity *poster;
+
 /*!
  @property itemID
  @abstract The itemID of the receiver.
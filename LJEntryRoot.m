@@ -25,10 +25,11 @@
  */
 
 #import "LJEntryRoot.h"
-#import "LJJournal.h"
+#import "LJJournal_Private.h"
 #import "LJAccount.h"
 #import "LJAccount_EditFriends.h"
 #import "LJGroup.h"
+#import "LJUserEntity.h"
 #import "URLEncoding.h"
 #import "Miscellaneous.h"
 
@@ -55,44 +56,64 @@ NSString * const LJEntryDidNotRemoveFromJournalNotification =
 {
     self = [super init];
     if (self) {
-        id obj;
-
         // LJJournal does not retain its parent LJAccount.  We need the account
         // to stick around, though, so we must get a reference to the account
         // and retain it ourselves.
         _account = [journal account];
         _journal = journal;
-        obj = info[[prefix stringByAppendingString:@"itemid"]];
-        _itemID = [obj intValue];
-        obj = info[[prefix stringByAppendingString:@"anum"]];
-        _aNum = [obj intValue];
-        obj = info[[prefix stringByAppendingString:@"event"]];
-        _content = LJURLDecodeString(obj);
-        obj = info[[prefix stringByAppendingString:@"poster"]];
-        _posterUsername = obj;
-        obj = info[[prefix stringByAppendingString:@"allowmask"]];
-        _allowGroupMask = [obj intValue];
-        obj = info[[prefix stringByAppendingString:@"security"]];
-        if (obj == nil || [obj isEqualToString:@"public"]) {
-            [self _setSecurityMode:LJSecurityModePublic];
-        } else if ([obj isEqualToString:@"private"]) {
-            [self _setSecurityMode:LJSecurityModePrivate];
-        } else if ([obj isEqualToString:@"usemask"]) {
-            [self _setSecurityMode:(_allowGroupMask == 1) ? LJSecurityModeFriend
-                                                          : LJSecurityModeGroup];
-        } else {
-            NSAssert1(NO, @"Unknown entry security mode: %@", obj);
-        }
-        // parse the date
-        obj = info[[prefix stringByAppendingString:@"eventtime"]];
-        NSDateFormatter *df = [NSDateFormatter new];
-        df.locale = [[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"];
-        df.dateFormat = @"%Y-%M-%d %H:%m:%S";
-        _date = [df dateFromString:obj];
+        [self _takeValuesFromReply:info prefix:prefix];
     }
     return self;
 }
 
+/*
+ * Parses the fields of one event in a getevents reply.  Subclasses parse
+ * their own fields and call super.
+ */
+- (void)_takeValuesFromReply:(NSDictionary *)info prefix:(NSString *)prefix
+{
+    id obj;
+
+    obj = info[[prefix stringByAppendingString:@"itemid"]];
+    _itemID = [obj intValue];
+    obj = info[[prefix stringByAppendingString:@"anum"]];
+    _aNum = [obj intValue];
+    obj = info[[prefix stringByAppendingString:@"event"]];
+    _content = LJURLDecodeString(obj);
+    obj = info[[prefix stringByAppendingString:@"poster"]];
+    _posterUsername = LJInternString(obj);
+    obj = info[[prefix stringByAppendingString:@"allowmask"]];
+    _allowGroupMask = [obj intValue];
+    obj = info[[prefix stringByAppendingString:@"security"]];
+    if (obj == nil || [obj isEqualToString:@"public"]) {
+        [self _setSecurityMode:LJSecurityModePublic];
+    } else if ([obj isEqualToString:@"private"]) {
+        [self _setSecurityMode:LJSecurityModePrivate];
+    } else if ([obj isEqualToString:@"usemask"]) {
+        [self _setSecurityMode:(_allowGroupMask == 1) ? LJSecurityModeFriend
+                                                      : LJSecurityModeGroup];
+    } else {
+        NSAssert1(NO, @"Unknown entry security mode: %@", obj);
+    }
+    // parse the date
+    obj = info[[prefix stringByAppendingString:@"eventtime"]];
+    NSDateFormatter *df = [NSDateFormatter new];
+    df.locale = [[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"];
+    df.dateFormat = @"yyyy-MM-dd HH:mm:ss";
+    _date = [df dateFromString:obj];
+}
+
+/*
+ * The receiver can't tell whether _date still matches the server's copy
+ * (it may have been decoded from an old archive), so it claims not to
+ * know; callers then invalidate the day counts instead of adjusting them.
+ * LJEntry keeps track and overrides this.
+ */
+- (NSDate *)_savedDate
+{
+    return nil;
+}
+
 - (instancetype)initWithCoder:(NSCoder *)decoder
 {
     self = [super init];
@@ -106,7 +127,7 @@ NSString * const LJEntryDidNotRemoveFromJournalNotification =
         _date = [decoder decodeObjectForKey:@"LJEntryDate"];
         _content = [decoder decodeObjectForKey:@"LJEntryContent"];
         obj = [decoder decodeObjectForKey:@"LJEntryPosterUsername"];
-        _posterUsername = obj;
+        _posterUsername = LJInternString(obj);
         _security = [decoder decodeIntForKey:@"LJEntrySecurityMode"];
         _allowGroupMask = [decoder decodeInt32ForKey:@"LJEntryGroupMask"];
     }
@@ -134,6 +155,12 @@ NSString * const LJEntryDidNotRemoveFromJournalNotification =
     [encoder encodeInt32:_allowGroupMask forKey:@"LJEntryGroupMask"];
 }
 
+- (LJUserEntity *)poster
+{
+    if (_posterUsername == nil) return nil;
+    return [LJUserEntity userEntityWithUsername:_posterUsername server:[_account server]];
+}
+
 - (BOOL)writeToFile:(NSString *)path
 {
     return [NSKeyedArchiver archiveRootObject:self toFile:path];
@@ -192,6 +219,20 @@ NSString * const LJEntryDidNotRemoveFromJournalNotification =
     return [NSSet setWithArray:[self groupsAllowedAccessArray]];
 }
 
+// Compiles the editevent request which deletes the entry.
+- (NSMutableDictionary *)_removeRequest
+{
+    NSMutableDictionary *request = [NSMutableDictionary dictionaryWithCapacity:3];
+    request[@"event"] = @"";
+    if (_itemID != 0) {
+        request[@"itemid"] = [NSString stringWithFormat:@"%u", _itemID];
+    }
+    if (![_journal isDefault]) {
+        request[@"usejournal"] = [_journal name];
+    }
+    return request;
+}
+
 - (void)removeFromJournal
 {
     NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
@@ -199,12 +240,7 @@ NSString * const LJEntryDidNotRemoveFromJournalNotification =
     NSAssert(_itemID != 0, @"Cannot remove a journal entry that has never been saved.");
     [center postNotificationName:LJEntryWillRemoveFromJournalNotification object:self];
     // Compile the request to be sent to the server
-    NSMutableDictionary *request = [NSMutableDictionary dictionaryWithCapacity:3];
-    request[@"event"] = @"";
-    request[@"itemid"] = [NSString stringWithFormat:@"%u", _itemID];
-    if (![_journal isDefault]) {
-        request[@"usejournal"] = [_journal name];
-    }
+    NSMutableDictionary *request = [self _removeRequest];
     // Send to the server
     @try {
         [[_journal account] getReplyForMode:@"editevent" parameters:request];
@@ -215,9 +251,17 @@ NSString * const LJEntryDidNotRemoveFromJournalNotification =
                               object:self userInfo:info];
         [localException raise];
     }
+    [self _didRemoveFromJournal];
+}
+
+// Called once the server has accepted the request from _removeRequest.
+- (void)_didRemoveFromJournal
+{
+    [_journal _forgetEntry:self];
     _itemID = 0;
     _aNum = 0;
-    [center postNotificationName:LJEntryDidRemoveFromJournalNotification object:self];
+    [[NSNotificationCenter defaultCenter] postNotificationName:LJEntryDidRemoveFromJournalNotification
+                                                        object:self];
 }
 
 @end
@@ -0,0 +1,146 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class LJEntry;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*!
+ @class LJEntryStore
+ @abstract A local file of downloaded entries.
+ @discussion
+ An LJEntryStore keeps archived LJEntry objects in a single append-only
+ file, so that a journal's entries can be read back without contacting
+ the server.  Saving an entry appends a record; the file is memory-mapped
+ for reading, and only an index of itemIDs and dates is kept in memory,
+ so a store can hold many thousands of entries cheaply.
+
+ Because records are never rewritten in place, superseded versions of an
+ entry take up space until the store is compacted.  A record left
+ incomplete by a crash is discarded the next time the store is opened.
+
+ Give an LJJournal a store with its entryStore property to have it save
+ every entry it downloads and answer getEntryForItemID: while the account
+ is logged out.  A store may be used from several threads at once.
+ */
+@interface LJEntryStore : NSObject
+
+/*!
+ @method initWithFileURL:
+ @abstract Opens the store in a file, creating the file if necessary.
+ @result The store, or nil if the file could not be created or is not an
+ entry store.
+ */
+- (nullable instancetype)initWithFileURL:(NSURL *)fileURL NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+/*!
+ @property fileURL
+ @abstract The file in which the receiver keeps its entries.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, copy) NSURL *fileURL;
+
+/*!
+ @property compressesContent
+ @abstract Whether newly saved entries are compressed.
+ @discussion
+ If YES, entries are compressed with zlib before they are written, which
+ is worthwhile for long entries.  Entries already in the store are read
+ back either way.  The default is NO.
+ */
+@property (atomic) BOOL compressesContent;
+
+/*!
+ @property count
+ @abstract The number of entries in the receiver.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger count;
+
+/*!
+ @property lastItemID
+ @abstract The highest itemID in the receiver, or 0 if it is empty.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) int lastItemID;
+
+/*!
+ @property syncCursor
+ @abstract The server time up to which the receiver has been synchronized.
+ @discussion
+ LJJournal's synchronizeEntryStore method keeps this in the server's
+ "yyyy-MM-dd HH:mm:ss" form and passes it back to syncitems as lastsync.
+ It is saved in the store's file along with the entries, so it is only
+ ever as new as the entries themselves.  Nil if the store has never been
+ synchronized.
+ */
+@property (NS_NONATOMIC_IOSONLY, copy, nullable) NSString *syncCursor;
+
+/*!
+ @method addEntry:
+ @abstract Saves an entry, replacing any entry already stored with its itemID.
+ @discussion
+ Nothing is written if the store already holds an identical copy of
+ the entry.  Entries which have not been posted (itemID 0) are ignored.
+ */
+- (void)addEntry:(LJEntry *)entry;
+
+/*!
+ @method removeEntryWithItemID:
+ @abstract Removes the entry with an itemID from the receiver.
+ */
+- (void)removeEntryWithItemID:(int)itemID;
+
+/*!
+ @method entryWithItemID:
+ @abstract Reads back the stored entry with an itemID.
+ @result A new LJEntry, or nil if no entry with that itemID is stored.
+ */
+- (nullable LJEntry *)entryWithItemID:(int)itemID;
+
+/*!
+ @method itemIDsFromDate:toDate:
+ @abstract Returns the itemIDs of the stored entries posted within a range of dates.
+ @discussion
+ The range includes startDate but not endDate.  The itemIDs are ordered by
+ the entries' dates.  Looking them up reads nothing from the file.
+ */
+- (NSArray<NSNumber*> *)itemIDsFromDate:(NSDate *)startDate toDate:(NSDate *)endDate;
+
+/*!
+ @method entriesFromDate:toDate:
+ @abstract Reads back the stored entries posted within a range of dates.
+ @discussion
+ The range includes startDate but not endDate.  The entries are ordered by date.
+ */
+- (NSArray<LJEntry*> *)entriesFromDate:(NSDate *)startDate toDate:(NSDate *)endDate;
+
+/*!
+ @method compact
+ @abstract Rewrites the file without superseded and removed entries.
+ @result YES if the file was rewritten, NO if an error occurred.
+ */
+- (BOOL)compact;
+
+@end
+
+NS_ASSUME_NONNULL_END
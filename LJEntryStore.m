@@ -0,0 +1,577 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJEntryStore.h"
+#import "LJEntry.h"
+#include <zlib.h>
+#include <stdio.h>
+
+// The first bytes of every store file.
+static const char kStoreMagic[8] = {'L', 'J', 'E', 'S', 'T', 'O', 'R', '1'};
+
+enum {
+    kRecordIsCompressed = 1 << 0,
+    kRecordIsRemoval = 1 << 1,
+    kRecordIsSyncCursor = 1 << 2, // payload is the cursor in UTF-8
+};
+
+// Precedes each record in the file.  A store is a local cache, so fields
+// are kept in the host's byte order.
+typedef struct {
+    uint32_t length;        // bytes of payload following the header
+    uint32_t rawLength;     // bytes of archive once inflated
+    uint32_t checksum;      // CRC-32 of the inflated archive
+    int32_t itemID;
+    uint32_t flags;
+    uint32_t reserved;
+    double date;            // seconds since the reference date
+} LJEntryStoreRecordHeader;
+
+// The in-memory index holds one of these for each stored itemID, sorted by
+// itemID, and one LJEntryStoreDateItem, sorted by date and then itemID.
+typedef struct {
+    int32_t itemID;
+    uint32_t checksum;
+    uint64_t offset;        // of the record header
+    double date;
+} LJEntryStoreIndexItem;
+
+typedef struct {
+    double date;
+    int32_t itemID;
+} LJEntryStoreDateItem;
+
+typedef struct {
+    LJEntryStoreIndexItem item;
+    uint32_t flags;
+} LJEntryStoreScanItem;
+
+static int LJCompareScanItems(const void *p1, const void *p2)
+{
+    const LJEntryStoreScanItem *a = p1, *b = p2;
+
+    if (a->item.itemID != b->item.itemID) return (a->item.itemID < b->item.itemID) ? -1 : 1;
+    if (a->item.offset != b->item.offset) return (a->item.offset < b->item.offset) ? -1 : 1;
+    return 0;
+}
+
+static int LJCompareDateItems(const void *p1, const void *p2)
+{
+    const LJEntryStoreDateItem *a = p1, *b = p2;
+
+    if (a->date != b->date) return (a->date < b->date) ? -1 : 1;
+    if (a->itemID != b->itemID) return (a->itemID < b->itemID) ? -1 : 1;
+    return 0;
+}
+
+// Returns the index of the first item whose itemID is not less than itemID.
+static NSUInteger LJLowerBoundOfItemID(const LJEntryStoreIndexItem *items, NSUInteger count, int32_t itemID)
+{
+    NSUInteger low = 0, high = count;
+
+    while (low < high) {
+        NSUInteger mid = low + (high - low) / 2;
+        if (items[mid].itemID < itemID) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// Returns the index of the first date item not ordered before key.
+static NSUInteger LJLowerBoundOfDateItem(const LJEntryStoreDateItem *dates, NSUInteger count, LJEntryStoreDateItem key)
+{
+    NSUInteger low = 0, high = count;
+
+    while (low < high) {
+        NSUInteger mid = low + (high - low) / 2;
+        if (LJCompareDateItems(&dates[mid], &key) < 0) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+static NSData *LJDeflateData(NSData *data)
+{
+    uLongf length = compressBound((uLong)[data length]);
+    NSMutableData *buffer = [NSMutableData dataWithLength:length];
+
+    if (compress2([buffer mutableBytes], &length, [data bytes], (uLong)[data length],
+                  Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return nil;
+    }
+    [buffer setLength:length];
+    return buffer;
+}
+
+static NSData *LJInflateBytes(const void *bytes, NSUInteger length, NSUInteger rawLength)
+{
+    uLongf inflatedLength = rawLength;
+    NSMutableData *buffer = [NSMutableData dataWithLength:rawLength];
+
+    if (uncompress([buffer mutableBytes], &inflatedLength, bytes, (uLong)length) != Z_OK ||
+        inflatedLength != rawLength) {
+        return nil;
+    }
+    return buffer;
+}
+
+@implementation LJEntryStore
+{
+    NSLock *_lock;
+    NSFileHandle *_fileHandle;
+    uint64_t _fileLength;
+    NSData *_mappedData;
+    LJEntryStoreIndexItem *_items;
+    LJEntryStoreDateItem *_dates;
+    NSUInteger _count, _capacity;
+    NSString *_syncCursor;
+}
+
+- (instancetype)initWithFileURL:(NSURL *)fileURL
+{
+    self = [super init];
+    if (self) {
+        NSParameterAssert([fileURL isFileURL]);
+        _fileURL = [fileURL copy];
+        _lock = [[NSLock alloc] init];
+        if (![self _openFile]) return nil;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_fileHandle closeFile];
+    free(_items);
+    free(_dates);
+}
+
+- (NSUInteger)count
+{
+    NSUInteger count;
+
+    [_lock lock];
+    count = _count;
+    [_lock unlock];
+    return count;
+}
+
+- (int)lastItemID
+{
+    int itemID;
+
+    [_lock lock];
+    itemID = (_count > 0) ? _items[_count - 1].itemID : 0;
+    [_lock unlock];
+    return itemID;
+}
+
+#pragma mark File
+
+- (BOOL)_openFile
+{
+    NSString *path = [_fileURL path];
+
+    if (![[NSFileManager defaultManager] fileExistsAtPath:path]) {
+        NSData *magic = [NSData dataWithBytes:kStoreMagic length:sizeof(kStoreMagic)];
+        if (![magic writeToFile:path atomically:YES]) return NO;
+    }
+    _fileHandle = [NSFileHandle fileHandleForUpdatingAtPath:path];
+    if (_fileHandle == nil || ![self _mapFile]) return NO;
+    if ([_mappedData length] < sizeof(kStoreMagic) ||
+        memcmp([_mappedData bytes], kStoreMagic, sizeof(kStoreMagic)) != 0) {
+        NSLog(@"LJEntryStore: %@ is not an entry store.", path);
+        return NO;
+    }
+    [self _loadIndex];
+    return YES;
+}
+
+- (BOOL)_mapFile
+{
+    NSData *data = [NSData dataWithContentsOfURL:_fileURL options:NSDataReadingMappedAlways error:NULL];
+
+    if (data == nil) return NO;
+    _mappedData = data;
+    return YES;
+}
+
+// Reads every record header once to rebuild the index.  Only the latest
+// record for each itemID counts, and a trailing record cut short by a
+// crash is cut off the file.
+- (void)_loadIndex
+{
+    const uint8_t *bytes = [_mappedData bytes];
+    uint64_t length = [_mappedData length], offset = sizeof(kStoreMagic);
+    NSUInteger scanCount = 0, scanCapacity = 256;
+    LJEntryStoreScanItem *scan = malloc(scanCapacity * sizeof(*scan));
+
+    while (offset + sizeof(LJEntryStoreRecordHeader) <= length) {
+        LJEntryStoreRecordHeader header;
+        memcpy(&header, bytes + offset, sizeof(header));
+        if (header.length > length - offset - sizeof(header)) break;
+        if (scanCount == scanCapacity) {
+            scanCapacity *= 2;
+            scan = realloc(scan, scanCapacity * sizeof(*scan));
+        }
+        if (header.flags & kRecordIsSyncCursor) {
+            // An empty cursor records that the cursor was cleared.
+            _syncCursor = (header.length == 0) ? nil :
+                [[NSString alloc] initWithBytes:bytes + offset + sizeof(header)
+                                         length:header.length
+                                       encoding:NSUTF8StringEncoding];
+            offset += sizeof(header) + header.length;
+            continue;
+        }
+        scan[scanCount].item = (LJEntryStoreIndexItem){header.itemID, header.checksum, offset, header.date};
+        scan[scanCount].flags = header.flags;
+        scanCount++;
+        offset += sizeof(header) + header.length;
+    }
+    if (offset < length) {
+        NSLog(@"LJEntryStore: discarding %llu bytes of incomplete record in %@.",
+              length - offset, [_fileURL path]);
+        [_fileHandle truncateFileAtOffset:offset];
+        // Touching mapped pages past the new end of file would fault.
+        [self _mapFile];
+    }
+    _fileLength = offset;
+
+    qsort(scan, scanCount, sizeof(*scan), LJCompareScanItems);
+    _count = 0;
+    [self _reserveCapacity:scanCount];
+    for (NSUInteger i = 0; i < scanCount; i++) {
+        if (i + 1 < scanCount && scan[i + 1].item.itemID == scan[i].item.itemID) continue;
+        if (scan[i].flags & kRecordIsRemoval) continue;
+        _items[_count] = scan[i].item;
+        _dates[_count] = (LJEntryStoreDateItem){scan[i].item.date, scan[i].item.itemID};
+        _count++;
+    }
+    free(scan);
+    qsort(_dates, _count, sizeof(*_dates), LJCompareDateItems);
+}
+
+// Appends a record; must be called with _lock held.
+- (BOOL)_appendRecordWithHeader:(LJEntryStoreRecordHeader)header payload:(NSData *)payload offset:(uint64_t *)offset
+{
+    NSMutableData *record = [[NSMutableData alloc] initWithCapacity:sizeof(header) + [payload length]];
+
+    [record appendBytes:&header length:sizeof(header)];
+    if (payload) [record appendData:payload];
+    @try {
+        [_fileHandle seekToFileOffset:_fileLength];
+        [_fileHandle writeData:record];
+    } @catch (NSException *localException) {
+        NSLog(@"LJEntryStore: could not write to %@: %@", [_fileURL path], [localException reason]);
+        return NO;
+    }
+    if (offset) *offset = _fileLength;
+    _fileLength += [record length];
+    return YES;
+}
+
+// Returns the inflated archive of the record at offset, or nil if it is
+// damaged; must be called with _lock held.
+- (NSData *)_archiveAtOffset:(uint64_t)offset
+{
+    LJEntryStoreRecordHeader header;
+    const uint8_t *payload;
+    NSData *archive;
+
+    // Records appended since the file was mapped need a fresh mapping.
+    if (offset + sizeof(header) > [_mappedData length] && ![self _mapFile]) return nil;
+    if (offset + sizeof(header) > [_mappedData length]) return nil;
+    memcpy(&header, (const uint8_t *)[_mappedData bytes] + offset, sizeof(header));
+    if (header.length > [_mappedData length] - offset - sizeof(header)) {
+        if (![self _mapFile] || header.length > [_mappedData length] - offset - sizeof(header)) {
+            return nil;
+        }
+    }
+    payload = (const uint8_t *)[_mappedData bytes] + offset + sizeof(header);
+    if (header.flags & kRecordIsCompressed) {
+        archive = LJInflateBytes(payload, header.length, header.rawLength);
+    } else {
+        archive = [NSData dataWithBytes:payload length:header.length];
+    }
+    if (archive == nil || crc32(0, [archive bytes], (uInt)[archive length]) != header.checksum) {
+        NSLog(@"LJEntryStore: damaged record for item %d in %@.", header.itemID, [_fileURL path]);
+        return nil;
+    }
+    return archive;
+}
+
+- (LJEntry *)_entryFromArchive:(NSData *)archive
+{
+    id entry = nil;
+
+    @try {
+        entry = [NSKeyedUnarchiver unarchiveObjectWithData:archive];
+    } @catch (NSException *localException) {
+        NSLog(@"LJEntryStore: could not unarchive an entry: %@", [localException reason]);
+    }
+    return [entry isKindOfClass:[LJEntry class]] ? entry : nil;
+}
+
+#pragma mark Index
+
+- (void)_reserveCapacity:(NSUInteger)capacity
+{
+    if (capacity <= _capacity) return;
+    _capacity = MAX(capacity, MAX(2 * _capacity, 64));
+    _items = realloc(_items, _capacity * sizeof(*_items));
+    _dates = realloc(_dates, _capacity * sizeof(*_dates));
+}
+
+// Returns the position of itemID in _items, or NSNotFound.
+- (NSUInteger)_indexOfItemID:(int32_t)itemID
+{
+    NSUInteger i = LJLowerBoundOfItemID(_items, _count, itemID);
+    return (i < _count && _items[i].itemID == itemID) ? i : NSNotFound;
+}
+
+- (void)_removeDateItem:(LJEntryStoreDateItem)key
+{
+    NSUInteger i = LJLowerBoundOfDateItem(_dates, _count, key);
+    NSAssert(i < _count && _dates[i].itemID == key.itemID, @"LJEntryStore date index is inconsistent.");
+    memmove(&_dates[i], &_dates[i + 1], (_count - i - 1) * sizeof(*_dates));
+}
+
+- (void)_insertDateItem:(LJEntryStoreDateItem)key count:(NSUInteger)count
+{
+    NSUInteger i = LJLowerBoundOfDateItem(_dates, count, key);
+    memmove(&_dates[i + 1], &_dates[i], (count - i) * sizeof(*_dates));
+    _dates[i] = key;
+}
+
+- (void)_setIndexItem:(LJEntryStoreIndexItem)item
+{
+    NSUInteger i = LJLowerBoundOfItemID(_items, _count, item.itemID);
+
+    if (i < _count && _items[i].itemID == item.itemID) {
+        [self _removeDateItem:(LJEntryStoreDateItem){_items[i].date, item.itemID}];
+        _items[i] = item;
+        [self _insertDateItem:(LJEntryStoreDateItem){item.date, item.itemID} count:_count - 1];
+    } else {
+        [self _reserveCapacity:_count + 1];
+        memmove(&_items[i + 1], &_items[i], (_count - i) * sizeof(*_items));
+        _items[i] = item;
+        [self _insertDateItem:(LJEntryStoreDateItem){item.date, item.itemID} count:_count];
+        _count++;
+    }
+}
+
+- (void)_removeIndexItemAtIndex:(NSUInteger)i
+{
+    [self _removeDateItem:(LJEntryStoreDateItem){_items[i].date, _items[i].itemID}];
+    memmove(&_items[i], &_items[i + 1], (_count - i - 1) * sizeof(*_items));
+    _count--;
+}
+
+// Returns the range of _dates within [startDate, endDate).
+- (NSRange)_dateRangeFromDate:(NSDate *)startDate toDate:(NSDate *)endDate
+{
+    LJEntryStoreDateItem start = {[startDate timeIntervalSinceReferenceDate], INT32_MIN};
+    LJEntryStoreDateItem end = {[endDate timeIntervalSinceReferenceDate], INT32_MIN};
+    NSUInteger first = LJLowerBoundOfDateItem(_dates, _count, start);
+    NSUInteger last = LJLowerBoundOfDateItem(_dates, _count, end);
+
+    return NSMakeRange(first, (last > first) ? last - first : 0);
+}
+
+#pragma mark Public
+
+- (NSString *)syncCursor
+{
+    NSString *cursor;
+
+    [_lock lock];
+    cursor = _syncCursor;
+    [_lock unlock];
+    return cursor;
+}
+
+- (void)setSyncCursor:(NSString *)cursor
+{
+    LJEntryStoreRecordHeader header = {0};
+    NSData *payload = [cursor dataUsingEncoding:NSUTF8StringEncoding];
+
+    header.length = header.rawLength = (uint32_t)[payload length];
+    header.checksum = (uint32_t)crc32(0, [payload bytes], (uInt)[payload length]);
+    header.flags = kRecordIsSyncCursor;
+    [_lock lock];
+    if (!(_syncCursor == cursor || [_syncCursor isEqualToString:cursor]) &&
+        [self _appendRecordWithHeader:header payload:payload offset:NULL]) {
+        _syncCursor = [cursor copy];
+    }
+    [_lock unlock];
+}
+
+- (void)addEntry:(LJEntry *)entry
+{
+    LJEntryStoreRecordHeader header = {0};
+    NSData *archive, *payload;
+    NSUInteger i;
+    uint64_t offset;
+
+    if ([entry itemID] == 0) return;
+    archive = [NSKeyedArchiver archivedDataWithRootObject:entry];
+    header.length = header.rawLength = (uint32_t)[archive length];
+    header.checksum = (uint32_t)crc32(0, [archive bytes], (uInt)[archive length]);
+    header.itemID = [entry itemID];
+    header.date = [[entry date] timeIntervalSinceReferenceDate];
+
+    [_lock lock];
+    i = [self _indexOfItemID:header.itemID];
+    BOOL isStored = (i != NSNotFound && _items[i].checksum == header.checksum && _items[i].date == header.date);
+    [_lock unlock];
+    if (isStored) return;
+
+    payload = archive;
+    if ([self compressesContent]) {
+        NSData *compressed = LJDeflateData(archive);
+        if (compressed && [compressed length] < [archive length]) {
+            payload = compressed;
+            header.length = (uint32_t)[compressed length];
+            header.flags |= kRecordIsCompressed;
+        }
+    }
+    [_lock lock];
+    if ([self _appendRecordWithHeader:header payload:payload offset:&offset]) {
+        [self _setIndexItem:(LJEntryStoreIndexItem){header.itemID, header.checksum, offset, header.date}];
+    }
+    [_lock unlock];
+}
+
+- (void)removeEntryWithItemID:(int)itemID
+{
+    LJEntryStoreRecordHeader header = {0};
+    NSUInteger i;
+
+    header.itemID = itemID;
+    header.flags = kRecordIsRemoval;
+    [_lock lock];
+    i = [self _indexOfItemID:itemID];
+    if (i != NSNotFound && [self _appendRecordWithHeader:header payload:nil offset:NULL]) {
+        [self _removeIndexItemAtIndex:i];
+    }
+    [_lock unlock];
+}
+
+- (LJEntry *)entryWithItemID:(int)itemID
+{
+    NSData *archive = nil;
+    NSUInteger i;
+
+    [_lock lock];
+    i = [self _indexOfItemID:itemID];
+    if (i != NSNotFound) archive = [self _archiveAtOffset:_items[i].offset];
+    [_lock unlock];
+    return archive ? [self _entryFromArchive:archive] : nil;
+}
+
+- (NSArray *)itemIDsFromDate:(NSDate *)startDate toDate:(NSDate *)endDate
+{
+    NSMutableArray *itemIDs;
+    NSRange range;
+
+    [_lock lock];
+    range = [self _dateRangeFromDate:startDate toDate:endDate];
+    itemIDs = [[NSMutableArray alloc] initWithCapacity:range.length];
+    for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+        [itemIDs addObject:@(_dates[i].itemID)];
+    }
+    [_lock unlock];
+    return [itemIDs copy];
+}
+
+- (NSArray *)entriesFromDate:(NSDate *)startDate toDate:(NSDate *)endDate
+{
+    NSMutableArray *archives, *entries;
+    NSRange range;
+
+    [_lock lock];
+    range = [self _dateRangeFromDate:startDate toDate:endDate];
+    archives = [[NSMutableArray alloc] initWithCapacity:range.length];
+    for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+        NSUInteger j = [self _indexOfItemID:_dates[i].itemID];
+        NSData *archive = [self _archiveAtOffset:_items[j].offset];
+        if (archive) [archives addObject:archive];
+    }
+    [_lock unlock];
+    // Unarchive outside the lock; it is the slow part.
+    entries = [[NSMutableArray alloc] initWithCapacity:[archives count]];
+    for (NSData *archive in archives) {
+        LJEntry *entry = [self _entryFromArchive:archive];
+        if (entry) [entries addObject:entry];
+    }
+    return [entries copy];
+}
+
+- (BOOL)compact
+{
+    NSString *path = [_fileURL path];
+    NSString *tempPath = [path stringByAppendingString:@".compact"];
+    NSMutableData *contents;
+    uint64_t *offsets;
+    BOOL success = NO;
+
+    [_lock lock];
+    if ([_mappedData length] < _fileLength && ![self _mapFile]) {
+        [_lock unlock];
+        return NO;
+    }
+    // The live records are copied as they stand, compressed or not.
+    contents = [[NSMutableData alloc] initWithBytes:kStoreMagic length:sizeof(kStoreMagic)];
+    offsets = malloc(MAX(_count, 1) * sizeof(*offsets));
+    for (NSUInteger i = 0; i < _count; i++) {
+        const uint8_t *record = (const uint8_t *)[_mappedData bytes] + _items[i].offset;
+        LJEntryStoreRecordHeader header;
+        memcpy(&header, record, sizeof(header));
+        offsets[i] = [contents length];
+        [contents appendBytes:record length:sizeof(header) + header.length];
+    }
+    if (_syncCursor) {
+        NSData *payload = [_syncCursor dataUsingEncoding:NSUTF8StringEncoding];
+        LJEntryStoreRecordHeader header = {0};
+        header.length = header.rawLength = (uint32_t)[payload length];
+        header.checksum = (uint32_t)crc32(0, [payload bytes], (uInt)[payload length]);
+        header.flags = kRecordIsSyncCursor;
+        [contents appendBytes:&header length:sizeof(header)];
+        [contents appendData:payload];
+    }
+    if ([contents writeToFile:tempPath atomically:NO] &&
+        rename([tempPath fileSystemRepresentation], [path fileSystemRepresentation]) == 0) {
+        [_fileHandle closeFile];
+        _fileHandle = [NSFileHandle fileHandleForUpdatingAtPath:path];
+        _fileLength = [contents length];
+        for (NSUInteger i = 0; i < _count; i++) {
+            _items[i].offset = offsets[i];
+        }
+        success = (_fileHandle != nil && [self _mapFile]);
+    } else {
+        [[NSFileManager defaultManager] removeItemAtPath:tempPath error:NULL];
+    }
+    free(offsets);
+    [_lock unlock];
+    return success;
+}
+
+@end
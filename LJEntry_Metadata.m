@@ -21,6 +21,7 @@
 
 #import "LJEntry.h"
 #import "LJEntry_Metadata.h"
+#import "LJEntryProperties.h"
 
 @implementation LJEntry (Metadata)
 
@@ -28,11 +29,7 @@
 
 - (void)setString:(NSString *)string forProperty:(NSString *)property
 {
-    if (string) {
-        _properties[property] = [string copy];
-    } else {
-        [_properties removeObjectForKey:property];
-    }
+    _properties[property] = string;
 }
 
 - (NSString *)stringForProperty:(NSString *)property
@@ -51,164 +48,168 @@
 }
 
 // Specific Property Access
+//
+// These go straight to the typed slots of the property store, without
+// looking up the property name or parsing its value.
 
 - (NSString *)currentMood
 {
-    return [self stringForProperty:@"current_mood_id_name"];
+    return [_properties stringForProperty:LJEntryMoodIDNameProperty];
 }
 
 - (void)setCurrentMood:(NSString *)moodName
 {
-    [self setString:moodName forProperty:@"current_mood_id_name"];
+    [_properties setString:moodName forProperty:LJEntryMoodIDNameProperty];
     // The mood ID is set in [LJEntry saveToJournal]
 }
 
 - (NSString *)currentMoodName
 {
-    return [self stringForProperty:@"current_mood"];
+    return [_properties stringForProperty:LJEntryMoodProperty];
 }
 
 - (void)setCurrentMoodName:(NSString *)moodName
 {
-    [self setString:moodName forProperty:@"current_mood"];
+    [_properties setString:moodName forProperty:LJEntryMoodProperty];
     // The mood ID is set in [LJEntry saveToJournal]
 }
 
 - (NSString *)currentMusic
 {
-    return [self stringForProperty:@"current_music"];
+    return [_properties stringForProperty:LJEntryMusicProperty];
 }
 
 - (void)setCurrentMusic:(NSString *)music
 {
-    [self setString:music forProperty:@"current_music"];
+    [_properties setString:music forProperty:LJEntryMusicProperty];
 }
 
 - (BOOL)optionPreformatted
 {
-    return [self booleanForProperty:@"opt_preformatted"];
+    return [_properties booleanForProperty:LJEntryPreformattedProperty];
 }
 
 - (void)setOptionPreformatted:(BOOL)flag
 {
-    [self setBoolean:flag forProperty:@"opt_preformatted"];
+    [_properties setBoolean:flag forProperty:LJEntryPreformattedProperty];
 }
 
 - (BOOL)markdownFormat
 {
-    return [self booleanForProperty:@"opt_markdown"];
+    return [_properties booleanForProperty:LJEntryMarkdownProperty];
 }
 
 - (void)setMarkdownFormat:(BOOL)flag
 {
-    [self setBoolean:flag forProperty:@"opt_markdown"];
+    [_properties setBoolean:flag forProperty:LJEntryMarkdownProperty];
 }
 
 - (BOOL)optionNoComments
 {
-    return [self booleanForProperty:@"opt_nocomments"];
+    return [_properties booleanForProperty:LJEntryNoCommentsProperty];
 }
 
 - (void)setOptionNoComments:(BOOL)flag
 {
-    [self setBoolean:flag forProperty:@"opt_nocomments"];
+    [_properties setBoolean:flag forProperty:LJEntryNoCommentsProperty];
 }
 
 - (NSString *)pictureKeyword
 {
-    return [self stringForProperty:@"picture_keyword"];
+    return [_properties stringForProperty:LJEntryPictureKeywordProperty];
 }
 
 - (void)setPictureKeyword:(NSString *)keyword
 {
-    [self setString:keyword forProperty:@"picture_keyword"];
+    [_properties setString:keyword forProperty:LJEntryPictureKeywordProperty];
 }
 
 - (BOOL)optionBackdated
 {
-    return [self booleanForProperty:@"opt_backdated"];
+    return [_properties booleanForProperty:LJEntryBackdatedProperty];
 }
 
 - (void)setOptionBackdated:(BOOL)flag
 {
-    [self setBoolean:flag forProperty:@"opt_backdated"];
+    [_properties setBoolean:flag forProperty:LJEntryBackdatedProperty];
 }
 
 - (BOOL)optionNoEmail
 {
-    return [self booleanForProperty:@"opt_noemail"];
+    return [_properties booleanForProperty:LJEntryNoEmailProperty];
 }
 
 - (void)setOptionNoEmail:(BOOL)flag
 {
-    [self setBoolean:flag forProperty:@"opt_noemail"];
+    [_properties setBoolean:flag forProperty:LJEntryNoEmailProperty];
 }
 
 - (BOOL)hasUnknown8bitData
 {
-    return [self booleanForProperty:@"unknown8bit"];
+    return [_properties booleanForProperty:LJEntryUnknown8bitProperty];
 }
 
 - (unichar)optionScreenReplies
 {
-    return [_properties[@"opt_screening"] characterAtIndex:0];
+    NSString *screening = [_properties stringForProperty:LJEntryScreeningProperty];
+    return [screening length] ? [screening characterAtIndex:0] : 0;
 }
 
 - (void)setOptionScreenReplies:(NSString *)singleChar
 {
-	[self setString:singleChar forProperty:@"opt_screening"];
+	[_properties setString:singleChar forProperty:LJEntryScreeningProperty];
 }
 
 - (BOOL)hasScreenedReplies
 {
-    return [self booleanForProperty:@"hasscreened"];
+    return [_properties booleanForProperty:LJEntryHasScreenedProperty];
 }
 
 - (int)revisionNumber
 {
-    return [_properties[@"revnum"] intValue];
+    return (int)[_properties integerForProperty:LJEntryRevisionNumberProperty];
 }
 
 - (NSDate *)revisionDate
 {
-    SInt64 unixtime = [_properties[@"revtime"] unsignedLongLongValue];
+    SInt64 unixtime = [_properties integerForProperty:LJEntryRevisionTimeProperty];
     return [NSDate dateWithTimeIntervalSince1970:unixtime];
 }
 
 - (NSDate *)commentsAlteredDate
 {
-    SInt64 unixtime = [_properties[@"commentalter"] unsignedLongLongValue];
+    SInt64 unixtime = [_properties integerForProperty:LJEntryCommentAlterTimeProperty];
     return [NSDate dateWithTimeIntervalSince1970:unixtime];
 }
 
 - (NSString *)syndicatedItemID
 {
-    return [self stringForProperty:@"syn_id"];
+    return [_properties stringForProperty:LJEntrySyndicatedIDProperty];
 }
 
 - (NSURL *)syndicatedItemURL
 {
-    return [NSURL URLWithString:_properties[@"syn_link"]];
+    return [NSURL URLWithString:[_properties stringForProperty:LJEntrySyndicatedLinkProperty]];
 }
 
 - (NSString *)currentLocation
 {
-    return [self stringForProperty:@"current_location"];
+    return [_properties stringForProperty:LJEntryLocationProperty];
 }
 
 - (void)setCurrentLocation:(NSString *)locationName
 {
-    [self setString:locationName forProperty:@"current_location"];
+    [_properties setString:locationName forProperty:LJEntryLocationProperty];
 }
 
 - (NSString *)tags
 {
-	return [self stringForProperty: @"taglist"];
+	return [_properties stringForProperty:LJEntryTagListProperty];
 }
 
 - (void)setTags:(NSString *)newTags
 {
-	[self setString:newTags forProperty:@"taglist"];
+	[_properties setString:newTags forProperty:LJEntryTagListProperty];
 }
 
 - (void)addTag:(NSString *)newTag
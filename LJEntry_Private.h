@@ -29,4 +29,18 @@
 
 @interface LJEntryRoot ()
 - (instancetype)initWithReply:(NSDictionary *)info prefix:(NSString *)prefix journal:(LJJournal *)journal;
+- (void)_takeValuesFromReply:(NSDictionary *)info prefix:(NSString *)prefix;
+// The date the server has for the entry, which may differ from an edited date.
+- (NSDate *)_savedDate;
+- (NSMutableDictionary *)_removeRequest;
+- (void)_didRemoveFromJournal;
+@end
+
+@interface LJEntry ()
+- (BOOL)_updateWithReply:(NSDictionary *)info prefix:(NSString *)prefix;
+- (NSMutableDictionary *)_saveRequest;
+- (void)_didSaveWithReply:(NSDictionary *)reply;
+// Identifies an entry which an outbox will post, until it has an itemID.
+- (NSString *)_outboxID;
+- (void)_setOutboxID:(NSString *)outboxID;
 @end
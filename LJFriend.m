@@ -24,6 +24,8 @@
 #import "LJGroup.h"
 #import "LJAccount_EditFriends.h"
 #import "Miscellaneous.h"
+#import "LJAccount_Private.h"
+#import "LJAccountArchive.h"
 
 @interface LJFriend ()
 - (instancetype)initWithUsername:(NSString *)username account:(LJAccount *)account NS_DESIGNATED_INITIALIZER;
@@ -41,17 +43,18 @@
 {
     NSString *key = [prefix stringByAppendingString:@"user"];
     NSString *value = reply[key];
-    LJFriend *amigo = [account friendNamed:value];
+    LJFriend *amigo = [account _knownFriendWithUsername:value];
     if (amigo == nil) {
         amigo = [[LJFriend alloc] initWithUsername:value account:account];
+        [account _indexFriend:amigo];
     }
     // Parse field common to friendof and getfriends modes
     key = [prefix stringByAppendingString:@"name"];
     [amigo _setFullname:reply[key]];
     key = [prefix stringByAppendingString:@"type"];
-	amigo.accountType = reply[key];
+	amigo.accountType = LJInternString(reply[key]);
     key = [prefix stringByAppendingString:@"status"];
-	amigo.accountStatus = reply[key];
+	amigo.accountStatus = LJInternString(reply[key]);
     return amigo;
 }
 
@@ -87,7 +90,7 @@
             dc.year = [yr integerValue];
             dc.month = [mo integerValue];
             dc.day = [dy integerValue];
-            NSCalendar *greg = [NSCalendar calendarWithIdentifier:NSGregorianCalendar];
+            NSCalendar *greg = [NSCalendar calendarWithIdentifier:NSCalendarIdentifierGregorian];
             bd = [greg dateFromComponents:dc];
         } else {
             bd = nil;
@@ -128,15 +131,14 @@
 }
 
 + (void)updateFriendSet:(NSSet *)friends withEditReply:(NSDictionary *)reply
+                account:(LJAccount *)account
 {
     NSInteger count = [reply[@"friends_added"] integerValue];
     for (NSInteger i = 1; i <= count; i++ ) {
         NSString *userKey = [NSString stringWithFormat:@"friend_%ld_user", (long)i];
         NSString *nameKey = [NSString stringWithFormat:@"friend_%ld_name", (long)i];
-        // Because LJFriend considers a string with the friends's name to be
-        // equal, we can use member: to retrieve the friend object.
-        LJFriend *amigo = [friends member:reply[userKey]];
-        if (amigo) {
+        LJFriend *amigo = [account _knownFriendWithUsername:reply[userKey]];
+        if (amigo && [friends member:amigo] == amigo) {
             [amigo _setFullname:reply[nameKey]];
         } else {
             NSLog(@"Server says friend %@ was added, but friend doesn't appear"
@@ -176,8 +178,8 @@
         _fgColorForYou = [decoder decodeObjectForKey:@"LJFriendForegroundColorForYou"];
         _bgColorForYou = [decoder decodeObjectForKey:@"LJFriendBackgroundColorForYou"];
         _groupMask = [decoder decodeInt32ForKey:@"LJFriendGroupMask"];
-        _accountType = [decoder decodeObjectForKey:@"LJFriendAccountType"];
-        _accountStatus = [decoder decodeObjectForKey:@"LJFriendAccountStatus"];
+        _accountType = LJInternString([decoder decodeObjectForKey:@"LJFriendAccountType"]);
+        _accountStatus = LJInternString([decoder decodeObjectForKey:@"LJFriendAccountStatus"]);
         _friendship = [decoder decodeIntForKey:@"LJFriendFriendship"];
         _modifiedDate = [decoder decodeObjectForKey:@"LJFriendModifiedDate"];
         _addedIncomingDate = [decoder decodeObjectForKey:@"LJFriendAddedIncomingDate"];
@@ -209,6 +211,49 @@
     }
 }
 
+- (instancetype)_initWithArchiveRecord:(const LJArchiveFriendRecord *)record
+                                reader:(LJAccountArchiveReader *)reader
+                               account:(LJAccount *)account
+{
+    self = [super init];
+    if (self) {
+        _account = account;
+        _username = [reader stringForReference:record->username];
+        _fullname = [reader stringForReference:record->fullname];
+        _birthDate = LJDateForArchiveTime(record->birthDate);
+        _fgColor = LJColorForArchiveColor(record->foregroundColor);
+        _bgColor = LJColorForArchiveColor(record->backgroundColor);
+        _fgColorForYou = LJColorForArchiveColor(record->foregroundColorForYou);
+        _bgColorForYou = LJColorForArchiveColor(record->backgroundColorForYou);
+        _groupMask = record->groupMask;
+        _accountType = LJInternString([reader stringForReference:record->accountType]);
+        _accountStatus = LJInternString([reader stringForReference:record->accountStatus]);
+        _friendship = record->friendship;
+        _modifiedDate = LJDateForArchiveTime(record->modifiedDate);
+        _addedIncomingDate = LJDateForArchiveTime(record->addedIncomingDate);
+        _addedOutgoingDate = LJDateForArchiveTime(record->addedOutgoingDate);
+    }
+    return self;
+}
+
+- (void)_getArchiveRecord:(LJArchiveFriendRecord *)record writer:(LJAccountArchiveWriter *)writer
+{
+    record->username = [writer referenceForString:_username];
+    record->fullname = [writer referenceForString:_fullname];
+    record->accountType = [writer referenceForString:_accountType];
+    record->accountStatus = [writer referenceForString:_accountStatus];
+    record->foregroundColor = LJArchiveColorForColor(_fgColor);
+    record->backgroundColor = LJArchiveColorForColor(_bgColor);
+    record->foregroundColorForYou = LJArchiveColorForColor(_fgColorForYou);
+    record->backgroundColorForYou = LJArchiveColorForColor(_bgColorForYou);
+    record->groupMask = _groupMask;
+    record->friendship = (uint8_t)_friendship;
+    record->birthDate = LJArchiveTimeForDate(_birthDate);
+    record->modifiedDate = LJArchiveTimeForDate(_modifiedDate);
+    record->addedIncomingDate = LJArchiveTimeForDate(_addedIncomingDate);
+    record->addedOutgoingDate = LJArchiveTimeForDate(_addedOutgoingDate);
+}
+
 - (void)_updateModifiedDate
 {
     _modifiedDate = [[NSDate alloc] init];
@@ -231,10 +276,22 @@
 }
 
 - (void)setGroupMask:(unsigned int)newMask
+{
+    [self _setGroupMask:newMask modifiedDate:nil];
+}
+
+/*
+ * Bulk edits pass one date for every friend they touch rather than
+ * allocating one per friend; nil stamps the current time.
+ */
+- (void)_setGroupMask:(unsigned int)newMask modifiedDate:(NSDate *)date
 {
     if (_groupMask != newMask) {
+        unsigned int oldMask = _groupMask;
+
         _groupMask = newMask;
-        [self _updateModifiedDate];
+        _modifiedDate = date ?: [[NSDate alloc] init];
+        [[self account] _friend:self groupMaskDidChangeFrom:oldMask];
     }
 }
 
@@ -246,7 +303,7 @@
 - (BOOL)isEqual:(id)object
 {
     if ([object isKindOfClass:[NSString class]]) {
-        return [[self username] isEqualToString:[object lowercaseString]];
+        return [[self username] caseInsensitiveCompare:object] == NSOrderedSame;
     }
     if ([object isKindOfClass:[LJFriend class]]) {
         return (_account == ((LJFriend*)object).account &&
@@ -261,7 +318,7 @@
         return [[self username] compare:[object username]];
     }
     if ([object isKindOfClass:[NSString class]]) {
-        return [[self username] compare:[object lowercaseString]];
+        return [[self username] caseInsensitiveCompare:object];
     }
     NSAssert1(YES, @"Can't compare an LJFriend to %@", object);
     return NSOrderedSame;
@@ -0,0 +1,97 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class LJFriend;
+
+#ifndef __private_extern
+#define __private_extern __attribute__((visibility("hidden")))
+#endif
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*
+ * Column codes.  Zero never appears in a row, so a zero field in an
+ * LJFriendPredicate means "any".
+ */
+enum {
+    LJFriendTypePersonal = 1,
+    LJFriendTypeCommunity,
+    LJFriendTypeSyndicated,
+    LJFriendTypeNews,
+    LJFriendTypeShared,
+    LJFriendTypeIdentity,
+    LJFriendTypeOther
+};
+
+enum {
+    LJFriendStatusActive = 1,
+    LJFriendStatusDeleted,
+    LJFriendStatusSuspended,
+    LJFriendStatusPurged,
+    LJFriendStatusOther
+};
+
+__private_extern uint8_t LJFriendTypeCodeForString(NSString * _Nullable accountType);
+__private_extern uint8_t LJFriendStatusCodeForString(NSString * _Nullable accountStatus);
+// The birthday code of a date's month and day, as used in LJFriendPredicate.
+__private_extern uint16_t LJFriendBirthdayCodeForDate(NSDate *date);
+
+/*
+ * A conjunction of tests on the columns.  Zero fields are ignored.
+ * friendship and groupMask match rows sharing any bit with them;
+ * birthdays match rows whose day of year (1-366, in a leap year) lies
+ * in firstBirthday...lastBirthday.
+ */
+typedef struct {
+    uint8_t typeCode;
+    uint8_t statusCode;
+    uint8_t friendship;
+    uint32_t groupMask;
+    uint16_t firstBirthday;
+    uint16_t lastBirthday;
+} LJFriendPredicate;
+
+/*
+ * A struct-of-arrays copy of the attributes of a sorted array of friends,
+ * so predicates run over packed columns with vector compares instead of a
+ * message send per friend and attribute.  Row i is [friends objectAtIndex:i].
+ * Not thread safe; the account guards it with its state lock.
+ */
+@interface LJFriendColumns : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+- (instancetype)initWithFriends:(NSArray<LJFriend*> *)friends version:(NSUInteger)version NS_DESIGNATED_INITIALIZER;
+
+// The snapshot version the columns were built from.
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger version;
+@property (NS_NONATOMIC_IOSONLY, readonly, copy) NSArray<LJFriend*> *friends;
+
+- (void)updateGroupMaskOfFriend:(LJFriend *)buddy;
+// Whether every row still holds its friend's current attributes.
+- (BOOL)matchesFriends;
+- (NSIndexSet *)indexesOfFriendsMatchingPredicate:(LJFriendPredicate)predicate;
+- (NSArray<LJFriend*> *)friendsMatchingPredicate:(LJFriendPredicate)predicate;
+
+@end
+
+NS_ASSUME_NONNULL_END
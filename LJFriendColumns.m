@@ -0,0 +1,256 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJFriendColumns.h"
+#import "LJFriend.h"
+
+// Rows are processed sixteen at a time; every column is padded to a whole
+// number of blocks so vector loads never run off the end.
+#define BLOCK_ROWS 16
+
+typedef uint8_t  LJByteVector  __attribute__((ext_vector_type(16)));
+typedef uint8_t  LJByte8Vector __attribute__((ext_vector_type(8)));
+typedef uint8_t  LJByte4Vector __attribute__((ext_vector_type(4)));
+typedef uint16_t LJShortVector __attribute__((ext_vector_type(8)));
+typedef uint32_t LJWordVector  __attribute__((ext_vector_type(4)));
+
+uint8_t LJFriendTypeCodeForString(NSString *accountType)
+{
+    if ([accountType length] == 0) return LJFriendTypePersonal;
+    if ([accountType isEqualToString:@"community"]) return LJFriendTypeCommunity;
+    if ([accountType isEqualToString:@"syndicated"]) return LJFriendTypeSyndicated;
+    if ([accountType isEqualToString:@"news"]) return LJFriendTypeNews;
+    if ([accountType isEqualToString:@"shared"]) return LJFriendTypeShared;
+    if ([accountType isEqualToString:@"identity"]) return LJFriendTypeIdentity;
+    if ([accountType isEqualToString:@"personal"]) return LJFriendTypePersonal;
+    return LJFriendTypeOther;
+}
+
+uint8_t LJFriendStatusCodeForString(NSString *accountStatus)
+{
+    if ([accountStatus length] == 0) return LJFriendStatusActive;
+    if ([accountStatus isEqualToString:@"deleted"]) return LJFriendStatusDeleted;
+    if ([accountStatus isEqualToString:@"suspended"]) return LJFriendStatusSuspended;
+    if ([accountStatus isEqualToString:@"purged"]) return LJFriendStatusPurged;
+    if ([accountStatus isEqualToString:@"active"]) return LJFriendStatusActive;
+    return LJFriendStatusOther;
+}
+
+/*
+ * Day of the year counted in a leap year, so that every birthday, February
+ * 29 included, has a code of its own.
+ */
+static uint16_t LJBirthdayCode(NSCalendar *calendar, NSDate *birthDate)
+{
+    static const uint16_t daysBeforeMonth[12] = {
+        0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335
+    };
+    NSDateComponents *components;
+
+    if (birthDate == nil) return 0;
+    components = [calendar components:(NSCalendarUnitMonth | NSCalendarUnitDay) fromDate:birthDate];
+    if ([components month] < 1 || [components month] > 12) return 0;
+    return daysBeforeMonth[[components month] - 1] + (uint16_t)[components day];
+}
+
+uint16_t LJFriendBirthdayCodeForDate(NSDate *date)
+{
+    NSCalendar *calendar = [NSCalendar calendarWithIdentifier:NSCalendarIdentifierGregorian];
+
+    return LJBirthdayCode(calendar, date);
+}
+
+@implementation LJFriendColumns
+{
+    NSUInteger _count;
+    uint8_t *_typeCodes;
+    uint8_t *_statusCodes;
+    uint8_t *_friendships;
+    uint32_t *_groupMasks;
+    uint16_t *_birthdays;
+}
+
+- (instancetype)initWithFriends:(NSArray *)friends version:(NSUInteger)version
+{
+    self = [super init];
+    if (self) {
+        NSCalendar *calendar = [[NSCalendar alloc] initWithCalendarIdentifier:NSCalendarIdentifierGregorian];
+        NSUInteger capacity, row = 0;
+
+        _version = version;
+        _friends = [friends copy];
+        _count = [_friends count];
+        capacity = (_count + BLOCK_ROWS - 1) / BLOCK_ROWS * BLOCK_ROWS;
+        if (capacity == 0) capacity = BLOCK_ROWS;
+        _typeCodes = calloc(capacity, sizeof(uint8_t));
+        _statusCodes = calloc(capacity, sizeof(uint8_t));
+        _friendships = calloc(capacity, sizeof(uint8_t));
+        _groupMasks = calloc(capacity, sizeof(uint32_t));
+        _birthdays = calloc(capacity, sizeof(uint16_t));
+        for (LJFriend *buddy in _friends) {
+            _typeCodes[row] = LJFriendTypeCodeForString([buddy accountType]);
+            _statusCodes[row] = LJFriendStatusCodeForString([buddy accountStatus]);
+            _friendships[row] = (uint8_t)([buddy friendship] & LJFriendshipMutual);
+            _groupMasks[row] = [buddy groupMask];
+            _birthdays[row] = LJBirthdayCode(calendar, [buddy birthDate]);
+            row++;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_typeCodes);
+    free(_statusCodes);
+    free(_friendships);
+    free(_groupMasks);
+    free(_birthdays);
+}
+
+- (void)updateGroupMaskOfFriend:(LJFriend *)buddy
+{
+    NSUInteger row;
+
+    row = [_friends indexOfObject:buddy inSortedRange:NSMakeRange(0, _count)
+                          options:NSBinarySearchingFirstEqual
+                  usingComparator:^(id a, id b) {
+                      return [a compare:b];
+                  }];
+    if (row != NSNotFound && _friends[row] == buddy) {
+        _groupMasks[row] = [buddy groupMask];
+    }
+}
+
+- (BOOL)matchesFriends
+{
+    NSCalendar *calendar = [[NSCalendar alloc] initWithCalendarIdentifier:NSCalendarIdentifierGregorian];
+    NSUInteger row = 0;
+
+    for (LJFriend *buddy in _friends) {
+        if (_typeCodes[row] != LJFriendTypeCodeForString([buddy accountType]) ||
+            _statusCodes[row] != LJFriendStatusCodeForString([buddy accountStatus]) ||
+            _friendships[row] != (uint8_t)([buddy friendship] & LJFriendshipMutual) ||
+            _groupMasks[row] != [buddy groupMask] ||
+            _birthdays[row] != LJBirthdayCode(calendar, [buddy birthDate])) {
+            return NO;
+        }
+        row++;
+    }
+    return YES;
+}
+
+/*
+ * Evaluates the predicate over one block of rows, giving 0xFF in each lane
+ * that matches and 0 elsewhere.
+ */
+static LJByteVector LJMatchBlock(LJFriendColumns *columns, NSUInteger start,
+                                 const LJFriendPredicate *predicate)
+{
+    LJByteVector match = 0xFF;
+    LJByteVector bytes;
+
+    if (predicate->typeCode) {
+        memcpy(&bytes, columns->_typeCodes + start, sizeof(bytes));
+        match &= (LJByteVector)(bytes == predicate->typeCode);
+    }
+    if (predicate->statusCode) {
+        memcpy(&bytes, columns->_statusCodes + start, sizeof(bytes));
+        match &= (LJByteVector)(bytes == predicate->statusCode);
+    }
+    if (predicate->friendship) {
+        memcpy(&bytes, columns->_friendships + start, sizeof(bytes));
+        match &= (LJByteVector)((bytes & predicate->friendship) != 0);
+    }
+    if (predicate->groupMask) {
+        LJByte4Vector hits[4];
+
+        for (int i = 0; i < 4; i++) {
+            LJWordVector words;
+
+            memcpy(&words, columns->_groupMasks + start + 4 * i, sizeof(words));
+            hits[i] = __builtin_convertvector((LJWordVector)((words & predicate->groupMask) != 0),
+                                              LJByte4Vector);
+        }
+        memcpy(&bytes, hits, sizeof(bytes));
+        match &= bytes;
+    }
+    if (predicate->firstBirthday || predicate->lastBirthday) {
+        uint16_t first = predicate->firstBirthday ?: 1;
+        uint16_t last = predicate->lastBirthday ?: 366;
+        LJByte8Vector hits[2];
+
+        for (int i = 0; i < 2; i++) {
+            LJShortVector days;
+
+            memcpy(&days, columns->_birthdays + start + 8 * i, sizeof(days));
+            hits[i] = __builtin_convertvector((LJShortVector)((days >= first) & (days <= last)),
+                                              LJByte8Vector);
+        }
+        memcpy(&bytes, hits, sizeof(bytes));
+        match &= bytes;
+    }
+    return match;
+}
+
+- (NSIndexSet *)indexesOfFriendsMatchingPredicate:(LJFriendPredicate)predicate
+{
+    NSMutableIndexSet *indexes = [NSMutableIndexSet indexSet];
+    NSUInteger runStart = NSNotFound;
+
+    for (NSUInteger start = 0; start < _count; start += BLOCK_ROWS) {
+        LJByteVector match = LJMatchBlock(self, start, &predicate);
+        uint64_t halves[2];
+        NSUInteger lanes = MIN(BLOCK_ROWS, _count - start);
+
+        memcpy(halves, &match, sizeof(halves));
+        if ((halves[0] | halves[1]) == 0) {
+            // Nothing in this block; close any run still open.
+            if (runStart != NSNotFound) {
+                [indexes addIndexesInRange:NSMakeRange(runStart, start - runStart)];
+                runStart = NSNotFound;
+            }
+            continue;
+        }
+        // Matching rows tend to cluster, so collect them as ranges.
+        for (NSUInteger lane = 0; lane < lanes; lane++) {
+            NSUInteger row = start + lane;
+
+            if (match[lane]) {
+                if (runStart == NSNotFound) runStart = row;
+            } else if (runStart != NSNotFound) {
+                [indexes addIndexesInRange:NSMakeRange(runStart, row - runStart)];
+                runStart = NSNotFound;
+            }
+        }
+    }
+    if (runStart != NSNotFound) {
+        [indexes addIndexesInRange:NSMakeRange(runStart, _count - runStart)];
+    }
+    return indexes;
+}
+
+- (NSArray *)friendsMatchingPredicate:(LJFriendPredicate)predicate
+{
+    return [_friends objectsAtIndexes:[self indexesOfFriendsMatchingPredicate:predicate]];
+}
+
+@end
@@ -24,6 +24,7 @@
  */
 
 #import "LJFriend.h"
+#import "LJAccountArchive.h"
 
 @interface LJFriend ()
 @property (NS_NONATOMIC_IOSONLY, readwrite, copy) NSString *accountType;
@@ -33,12 +34,18 @@
 @property (NS_NONATOMIC_IOSONLY, readwrite, copy) NSColor *foregroundColorForYou;
 + (void)updateFriendSet:(NSMutableSet *)friends withReply:(NSDictionary *)reply account:(LJAccount *)account;
 + (void)updateFriendOfSet:(NSMutableSet *)friendOfs withReply:(NSDictionary *)reply account:(LJAccount *)account;
-+ (void)updateFriendSet:(NSSet *)friends withEditReply:(NSDictionary *)reply;
++ (void)updateFriendSet:(NSSet *)friends withEditReply:(NSDictionary *)reply account:(LJAccount *)account;
 - (id)initWithUsername:(NSString *)username account:(LJAccount *)account;
+// Fills in everything but the membership field, which is the account's.
+- (instancetype)_initWithArchiveRecord:(const LJArchiveFriendRecord *)record
+                                reader:(LJAccountArchiveReader *)reader
+                               account:(LJAccount *)account;
+- (void)_getArchiveRecord:(LJArchiveFriendRecord *)record writer:(LJAccountArchiveWriter *)writer;
 - (void)_addAddFieldsToParameters:(NSMutableDictionary *)parameters index:(int)i;
 - (void)_addDeleteFieldsToParameters:(NSMutableDictionary *)parameters;
 //- (void)_enqueueNotificationName:(NSString *)name;
 - (void)_updateModifiedDate;
+- (void)_setGroupMask:(unsigned int)newMask modifiedDate:(NSDate *)date;
 - (void)_setOutgoingFriendship:(BOOL)flag;
 - (void)_setIncomingFriendship:(BOOL)flag;
 @end
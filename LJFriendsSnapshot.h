@@ -0,0 +1,96 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class LJFriend, LJGroup;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*!
+ @class LJFriendsSnapshot
+ @abstract An immutable view of an account's friends and groups.
+ @discussion
+ An account publishes a new snapshot the first time it is read after its
+ friends or groups change, whether by downloadFriends or a local edit.  A snapshot never
+ changes once published, so it can be read from any thread without locking,
+ and its collections are returned without being copied.  Each snapshot has a
+ version number one greater than the one it replaced.
+
+ The snapshot fixes which friends and groups the account has; the LJFriend
+ and LJGroup objects themselves are shared with the account and may still be
+ edited.
+ */
+@interface LJFriendsSnapshot : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/*!
+ @property version
+ @abstract Increases by one with every snapshot an account publishes.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger version;
+
+/*!
+ @property friendSet
+ @abstract The friends, or nil if they haven't been downloaded.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, nullable) NSSet<LJFriend*> *friendSet;
+
+/*!
+ @property friendArray
+ @abstract The friends, sorted, or nil if they haven't been downloaded.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, nullable) NSArray<LJFriend*> *friendArray;
+
+/*!
+ @property friendOfSet
+ @abstract The users who list the account as a friend, or nil.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, nullable) NSSet<LJFriend*> *friendOfSet;
+
+/*!
+ @property friendOfArray
+ @abstract The users who list the account as a friend, sorted, or nil.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, nullable) NSArray<LJFriend*> *friendOfArray;
+
+/*!
+ @property relationshipArray
+ @abstract Everyone who is a friend, a friend-of, or both, sorted.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSArray<LJFriend*> *relationshipArray;
+
+/*!
+ @property groupSet
+ @abstract The friend groups, or nil if they haven't been downloaded.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, nullable) NSSet<LJGroup*> *groupSet;
+
+/*!
+ @property groupArray
+ @abstract The friend groups, sorted, or nil if they haven't been downloaded.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, nullable) NSArray<LJGroup*> *groupArray;
+
+@end
+
+NS_ASSUME_NONNULL_END
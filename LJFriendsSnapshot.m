@@ -0,0 +1,82 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJFriendsSnapshot_Private.h"
+#import "LJFriend.h"
+
+/*
+ * Merges the two sorted arrays into one sorted array without duplicates.
+ * A user who is both a friend and a friend-of is the same LJFriend object
+ * in both arrays.
+ */
+static NSArray *LJMergeSortedFriendArrays(NSArray *a, NSArray *b)
+{
+    NSUInteger i = 0, j = 0, countA = [a count], countB = [b count];
+    NSMutableArray *merged = [[NSMutableArray alloc] initWithCapacity:(countA + countB)];
+
+    while (i < countA && j < countB) {
+        LJFriend *x = a[i], *y = b[j];
+        NSComparisonResult order = (x == y) ? NSOrderedSame : [x compare:y];
+
+        if (order == NSOrderedAscending) {
+            [merged addObject:x]; i++;
+        } else if (order == NSOrderedDescending) {
+            [merged addObject:y]; j++;
+        } else {
+            [merged addObject:x]; i++; j++;
+        }
+    }
+    while (i < countA) [merged addObject:a[i++]];
+    while (j < countB) [merged addObject:b[j++]];
+    return merged;
+}
+
+@implementation LJFriendsSnapshot
+
+- (instancetype)_initWithFriendArray:(NSArray *)friendArray
+                       friendOfArray:(NSArray *)friendOfArray
+                          groupArray:(NSArray *)groupArray
+                             version:(NSUInteger)version
+{
+    self = [super init];
+    if (self) {
+        _version = version;
+        // The arrays arrive sorted; copy them so nothing the account does
+        // later can reach into a published snapshot.
+        _friendArray = [friendArray copy];
+        _friendOfArray = [friendOfArray copy];
+        _groupArray = [groupArray copy];
+        _friendSet = _friendArray ? [[NSSet alloc] initWithArray:_friendArray] : nil;
+        _friendOfSet = _friendOfArray ? [[NSSet alloc] initWithArray:_friendOfArray] : nil;
+        _groupSet = _groupArray ? [[NSSet alloc] initWithArray:_groupArray] : nil;
+        _relationshipArray = LJMergeSortedFriendArrays(_friendArray, _friendOfArray);
+    }
+    return self;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<LJFriendsSnapshot %lu: %lu friends, %lu friend-ofs, %lu groups>",
+            (unsigned long)_version, (unsigned long)[_friendSet count],
+            (unsigned long)[_friendOfSet count], (unsigned long)[_groupSet count]];
+}
+
+@end
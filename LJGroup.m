@@ -29,6 +29,7 @@
 #import "LJAccount_EditFriends.h"
 #import "Miscellaneous.h"
 #import "LJGroup_Private.h"
+#import "LJAccount_Private.h"
 
 @implementation LJGroup
 @synthesize public = _isPublic;
@@ -105,11 +106,40 @@
     [encoder encodeObject:_modifiedDate forKey:@"LJGroupModifiedDate"];
 }
 
+- (instancetype)_initWithArchiveRecord:(const LJArchiveGroupRecord *)record
+                                reader:(LJAccountArchiveReader *)reader
+                               account:(LJAccount *)account
+{
+    self = [super init];
+    if (self) {
+        _account = account;
+        _number = record->number;
+        _mask = (1 << _number);
+        _name = [reader stringForReference:record->name];
+        _sortOrder = record->sortOrder;
+        _isPublic = (record->isPublic != 0);
+        _createdDate = LJDateForArchiveTime(record->createdDate);
+        _modifiedDate = LJDateForArchiveTime(record->modifiedDate);
+    }
+    return self;
+}
+
+- (void)_getArchiveRecord:(LJArchiveGroupRecord *)record writer:(LJAccountArchiveWriter *)writer
+{
+    record->name = [writer referenceForString:_name];
+    record->number = (uint8_t)_number;
+    record->sortOrder = _sortOrder;
+    record->isPublic = _isPublic;
+    record->createdDate = LJArchiveTimeForDate(_createdDate);
+    record->modifiedDate = LJArchiveTimeForDate(_modifiedDate);
+}
+
 - (void)setName:(NSString *)name
 {
 	if (![_name isEqualToString:name]) {
 		_name = [name copy];
 		[self _updateModifiedDate];
+		[_account _groupSortKeyDidChange:self];
 	}
 }
 
@@ -118,6 +148,7 @@
     if (_sortOrder != sortOrder) {
         _sortOrder = sortOrder;
         [self _updateModifiedDate];
+        [_account _groupSortKeyDidChange:self];
     }
 }
 
@@ -153,50 +184,26 @@
     return (([amigo groupMask] & _mask) != 0);
 }
 
-- (void)_addMembersToContainer:(id)members
-         nonMembersToContainer:(id)nonMembers
-{
-    NSEnumerator *allFriends;
-    LJFriend *friend;
-    
-    allFriends = [_account friendEnumerator];
-    while (friend = [allFriends nextObject]) {
-        if ([self isMember:friend]) {
-            [members addObject:friend];
-        } else {
-            [nonMembers addObject:friend];
-        }
-    }
-}
+// The account keeps each group's members sorted in its membership index.
 
 - (NSArray *)memberArray
 {
-    NSMutableArray *members = [[NSMutableArray alloc] init];
-    [self _addMembersToContainer:members nonMembersToContainer:nil];
-    [members sortUsingSelector:@selector(compare:)];
-    return [members copy];
+    return [_account _membersOfGroup:self];
 }
 
 - (NSSet *)memberSet
 {
-    NSMutableSet *members = [NSMutableSet set];
-    [self _addMembersToContainer:members nonMembersToContainer:nil];
-    return [members copy];
+    return [NSSet setWithArray:[_account _membersOfGroup:self]];
 }
 
 - (NSArray *)nonMemberArray
 {
-    NSMutableArray *nonMembers = [[NSMutableArray alloc] init];
-    [self _addMembersToContainer:nil nonMembersToContainer:nonMembers];
-    [nonMembers sortUsingSelector:@selector(compare:)];
-    return [nonMembers copy];
+    return [[_account _nonMembersOfGroup:self] copy];
 }
 
 - (NSSet *)nonMemberSet
 {
-    NSMutableSet *nonMembers = [NSMutableSet set];
-    [self _addMembersToContainer:nil nonMembersToContainer:nonMembers];
-    return [nonMembers copy];
+    return [NSSet setWithArray:[_account _nonMembersOfGroup:self]];
 }
 
 - (NSUInteger)hash
@@ -218,18 +225,26 @@
 
 - (NSComparisonResult)compare:(id)object
 {
+    NSComparisonResult order;
     signed int diff;
     
     if ([object isKindOfClass:[LJGroup class]]) {
+        // The account keeps its groups binary searchable in this order, so
+        // it must be total: sort order, then name, then number.
         diff = [self sortOrder] - [object sortOrder];
-        if (diff < 1) return NSOrderedAscending;
-        else if (diff > 1) return NSOrderedDescending;
-        else return [[self name] compare:[object name]];
+        if (diff < 0) return NSOrderedAscending;
+        else if (diff > 0) return NSOrderedDescending;
+        order = [([self name] ?: @"") compare:([object name] ?: @"")];
+        if (order != NSOrderedSame) return order;
+        diff = [self number] - [object number];
+        if (diff < 0) return NSOrderedAscending;
+        else if (diff > 0) return NSOrderedDescending;
+        else return NSOrderedSame;
     }
     if ([object isKindOfClass:[NSNumber class]]) {
         diff = [self number] - [object intValue];
-        if (diff < 1) return NSOrderedAscending;
-        else if (diff > 1) return NSOrderedDescending;
+        if (diff < 0) return NSOrderedAscending;
+        else if (diff > 0) return NSOrderedDescending;
         else return NSOrderedSame;
     }
     NSAssert1(NO, @"Can't compare an LJGroup to %@", object);
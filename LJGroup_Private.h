@@ -24,9 +24,15 @@
  */
 
 #import "LJGroup.h"
+#import "LJAccountArchive.h"
 
 @interface LJGroup ()
 @property (strong) LJAccount *account;
 - (void)_addAddFieldsToParameters:(NSMutableDictionary *)parameters;
 - (void)_addDeleteFieldsToParameters:(NSMutableDictionary *)parameters;
+// Fills in everything but the membership field, which is the account's.
+- (instancetype)_initWithArchiveRecord:(const LJArchiveGroupRecord *)record
+                                reader:(LJAccountArchiveReader *)reader
+                               account:(LJAccount *)account;
+- (void)_getArchiveRecord:(LJArchiveGroupRecord *)record writer:(LJAccountArchiveWriter *)writer;
 @end
@@ -121,7 +121,7 @@
 - (NSURL *)_URLWithUsernameFormat:(NSString *)format
 {
     NSString *string = [NSString stringWithFormat:format, [self username]];
-    NSURL *serverURL = [[[self account] server] URL];
+    NSURL *serverURL = [[self _server] URL];
     return [[NSURL URLWithString:string relativeToURL:serverURL] absoluteURL];
 }
 
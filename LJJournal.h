@@ -21,7 +21,7 @@
 
 #import <Foundation/Foundation.h>
 
-@class LJAccount, LJEntry, LJEntrySummary;
+@class LJAccount, LJEntry, LJEntrySummary, LJEntryStore, LJJournalPager;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -69,15 +69,79 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (NS_NONATOMIC_IOSONLY, readonly) BOOL isDefault;
 
+/*!
+ @property entryStore
+ @abstract A local store for the receiver's entries, or nil.
+ @discussion
+ If set, every entry the receiver downloads or saves is also written to the
+ store, and entries removed from the journal are removed from it.  While the
+ account is not logged in, getEntryForItemID: reads entries from the store
+ instead of the server.  Each journal should be given its own store.
+ */
+@property (atomic, strong, nullable) LJEntryStore *entryStore;
+
+/*!
+ @method synchronizeEntryStore
+ @abstract Brings the entryStore up to date with the server.
+ @discussion
+ Asks the server (with the syncitems mode) which entries have been posted or
+ changed since the store was last synchronized, then downloads just those
+ entries, up to 100 per request, and saves them in the store.  Entries which
+ turn out to have been deleted are removed from the store.  The first call
+ downloads the whole journal; after that, each call costs a couple of
+ requests unless much has changed.
+
+ The store's syncCursor only advances once every changed entry has been
+ saved, so if an exception is raised part way through, the next call picks
+ up from where the last successful one left off.  The receiver must have an
+ entryStore.
+ @result The number of entries which were saved or removed.
+ */
+- (NSUInteger)synchronizeEntryStore;
+
+/*!
+ @method exportEntriesToURL:
+ @abstract Downloads every entry in the receiver to a file.
+ @discussion
+ Runs an LJJournalExport with its default settings; create one yourself to
+ change them or to watch its progress.  If the file holds an interrupted
+ export of the receiver, the export resumes where it stopped.
+ */
+- (void)exportEntriesToURL:(NSURL *)fileURL;
+
 /*!
  @method getEntryForItemID:
  @param itemID The itemID of the desired entry.
  @discussion
  If an entry's itemID is known, you can retrieve it directly with this method.
  Note that the itemID is different from the itemID which appears on the web.
+ If the account is not logged in, the entry is read from the entryStore.
  @result The desired LJEntry object if found, nil otherwise.
  */
-- (LJEntry *)getEntryForItemID:(int)itemID;
+- (nullable LJEntry *)getEntryForItemID:(int)itemID;
+
+/*!
+ @method getEntriesForItemIDs:
+ @param itemIDs An array of NSNumbers holding the itemIDs of the desired entries.
+ @discussion
+ Downloads many entries at once, using as few requests as the server allows.
+ Where the server supports it, up to 100 entries are fetched per request;
+ otherwise the entries are fetched by concurrent requests.
+ @result An array with one object for each itemID, in the same order: the
+ LJEntry if it was found, or NSNull if it was not.
+ */
+- (NSArray *)getEntriesForItemIDs:(NSArray<NSNumber*> *)itemIDs;
+
+/*!
+ @method getEntriesForSummaries:
+ @param summaries An array of LJEntrySummary objects from the receiver.
+ @discussion
+ Downloads the full entries for a list of summaries, as with getEntriesForItemIDs:.
+ This is much faster than calling getEntry on each summary in turn.
+ @result An array with the LJEntry for each summary, in the same order,
+ or NSNull where an entry no longer exists.
+ */
+- (NSArray *)getEntriesForSummaries:(NSArray<LJEntrySummary*> *)summaries;
 
 /*!
  @property mostRecentEntry
@@ -111,6 +175,22 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (NSArray<LJEntry*> *)getEntriesForDay:(NSDate *)date;
 
+/*!
+ @method entryPagerWithPageSize:
+ @abstract Returns a pager for browsing the receiver's entries from the most recent back.
+ @discussion
+ See LJJournalPager.  pageSize may be at most 50.
+ */
+- (LJJournalPager *)entryPagerWithPageSize:(NSUInteger)pageSize;
+
+/*!
+ @method summaryPagerWithPageSize:
+ @abstract Returns a pager for browsing summaries of the receiver's entries.
+ @discussion
+ See LJJournalPager.  pageSize may be at most 50.
+ */
+- (LJJournalPager *)summaryPagerWithPageSize:(NSUInteger)pageSize;
+
 /*!
  @method getSummaryForItemID:
  @param itemID The itemID of the desired entry.
@@ -150,11 +230,49 @@ NS_ASSUME_NONNULL_BEGIN
  @property dayCounts
  @abstract A dictionary mapping days to entry counts.
  @discussion
- Returns an NSDictionary with NSCalendarDate objects as keys and NSNumbers as values,
- representing the number of entries available for the given date.
+ Returns an NSDictionary with NSDate objects as keys and NSNumbers as values,
+ representing the number of entries available for the given date.  Each key is
+ the first moment of its day in the Gregorian calendar and the local time zone.
+ The counts come from the same local index as entryCountForYear:month:, so
+ calling this repeatedly does not contact the server.
  */
 @property (NS_NONATOMIC_IOSONLY, getter=getDayCounts, readonly, copy) NSDictionary<NSDate*,NSNumber*> *dayCounts;
 
+/*!
+ @property dayCountsRevalidationInterval
+ @abstract How long, in seconds, downloaded day counts are trusted.
+ @discussion
+ The receiver downloads its day counts once, then keeps them up to date
+ itself as entries are posted, edited and removed through the LJKit.  To
+ catch changes made elsewhere, the counts are downloaded again when they
+ are older than this interval.  The default is 600 seconds.
+ */
+@property (atomic) NSTimeInterval dayCountsRevalidationInterval;
+
+/*!
+ @method entryCountForYear:
+ @abstract Returns the number of entries posted in a year.
+ */
+- (NSUInteger)entryCountForYear:(NSInteger)year;
+
+/*!
+ @method entryCountForYear:month:
+ @abstract Returns the number of entries posted in a month (1-12) of a year.
+ */
+- (NSUInteger)entryCountForYear:(NSInteger)year month:(NSInteger)month;
+
+/*!
+ @method entryCountForYear:month:day:
+ @abstract Returns the number of entries posted on a day.
+ */
+- (NSUInteger)entryCountForYear:(NSInteger)year month:(NSInteger)month day:(NSInteger)day;
+
+/*!
+ @method reloadDayCounts
+ @abstract Downloads the day counts again, whatever their age.
+ */
+- (void)reloadDayCounts;
+
 /*!
  @property tags
  @abstract Obtain an array of user tags for this journal.
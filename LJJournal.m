@@ -25,13 +25,42 @@
  */
 
 #import "LJAccount.h"
+#import "LJAccount_Private.h"
+#import "LJReplyCache.h"
 #import "LJEntry_Private.h"
 #import "LJJournal_Private.h"
 #import "Miscellaneous.h"
 #import "URLEncoding.h"
+#import "LJWeakBox.h"
+#import "LJLazyEntryArray.h"
+#import "LJEntryStore.h"
+#import "LJJournalExport.h"
+#import "LJJournalPager.h"
+#import "LJCalendarIndex.h"
+#import "LJRequestScheduler.h"
+#import "LJServer.h"
 
 static NSString *entrySummaryLength = nil;
 
+// The server refuses to return more events than this from one getevents.
+static const NSUInteger kMaxItemsPerRequest = 100;
+
+/*
+ * Whether an error from a selecttype=multiple request means the server
+ * doesn't support it, rather than a failure worth raising (a bad password,
+ * a suspended account, rate limiting).  Servers without it reject the
+ * selecttype or its itemids parameter as invalid.
+ */
+static BOOL LJIsUnsupportedSelectTypeError(NSException *exception)
+{
+    NSString *reason = [exception reason];
+
+    if (![[exception name] isEqualToString:@"LJServerError"] || reason == nil) return NO;
+    return ([reason rangeOfString:@"selecttype" options:NSCaseInsensitiveSearch].location != NSNotFound ||
+            [reason rangeOfString:@"itemids" options:NSCaseInsensitiveSearch].location != NSNotFound ||
+            [reason rangeOfString:@"Invalid request parameters" options:NSCaseInsensitiveSearch].location != NSNotFound);
+}
+
 @interface LJJournal ()
 - (instancetype)initWithName:(NSString *)name account:(LJAccount *)account NS_DESIGNATED_INITIALIZER;
 @end
@@ -40,6 +69,18 @@ static NSString *entrySummaryLength = nil;
 {
 @private
     BOOL _isNotDefault;
+    // The identity map: the live LJEntry for each itemID, held weakly.
+    NSLock *_entryMapLock;
+    NSMutableDictionary *_entriesByItemID;
+    NSUInteger _entrySweepCount;
+    // Set once the server has refused selecttype=multiple; read and written
+    // under _entryMapLock, since batches may run on several threads.
+    BOOL _noMultipleSelect;
+    // Held throughout synchronizeEntryStore.
+    NSLock *_syncLock;
+    // Day counts, downloaded on first use and kept up to date locally.
+    NSLock *_calendarLock;
+    LJCalendarIndex *_calendarIndex;
 }
 
 + (void)initialize
@@ -90,6 +131,11 @@ static NSString *entrySummaryLength = nil;
         _name = [name copy];
         _account = account; // Don't retain the account to avoid retain-release cycles
         _isNotDefault = ![_name isEqualToString:[_account username]];
+        _entryMapLock = [[NSLock alloc] init];
+        _entriesByItemID = [[NSMutableDictionary alloc] init];
+        _syncLock = [[NSLock alloc] init];
+        _calendarLock = [[NSLock alloc] init];
+        _dayCountsRevalidationInterval = 600;
     }
     return self;
 }
@@ -103,6 +149,11 @@ static NSString *entrySummaryLength = nil;
         _account = [decoder decodeObjectForKey:@"LJJournalAccount"];
         NSAssert(_account != nil, @"LJJournal decoded without an account object.");
         _isNotDefault = ![_name isEqualToString:[_account username]];
+        _entryMapLock = [[NSLock alloc] init];
+        _entriesByItemID = [[NSMutableDictionary alloc] init];
+        _syncLock = [[NSLock alloc] init];
+        _calendarLock = [[NSLock alloc] init];
+        _dayCountsRevalidationInterval = 600;
     }
     return self;
 }
@@ -133,7 +184,7 @@ static NSString *entrySummaryLength = nil;
     parameters[@"howmany"] = [NSString stringWithFormat:@"%u", n];
     if (date) {
         NSDateFormatter *df = [NSDateFormatter new];
-        df.dateFormat = @"%Y-%M-%d %H:%m:%S";
+        df.dateFormat = @"yyyy-MM-dd HH:mm:ss";
         df.locale = [[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"];
 
         NSString *s = [df stringFromDate:date];
@@ -147,7 +198,7 @@ static NSString *entrySummaryLength = nil;
     NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
     parameters[@"selecttype"] = @"day";
 #define ourUnits NSCalendarUnitYear | NSCalendarUnitMonth | NSCalendarUnitDay 
-    NSCalendar *gregCalendar = [NSCalendar calendarWithIdentifier:NSGregorianCalendar];
+    NSCalendar *gregCalendar = [NSCalendar calendarWithIdentifier:NSCalendarIdentifierGregorian];
     NSDateComponents *comps = [gregCalendar components:ourUnits fromDate:date];
     parameters[@"year"] = [@(comps.year) stringValue];
     parameters[@"month"] = [@(comps.month) stringValue];
@@ -163,17 +214,101 @@ static NSString *entrySummaryLength = nil;
     return [_account getReplyForMode:@"getevents" parameters:parameters];
 }
 
+/*
+ * Returns the entry for an event in a getevents reply.  While an LJEntry
+ * for the itemID is alive anywhere, that same object is returned, brought
+ * up to date in place; otherwise a new one is made and remembered.
+ */
+- (LJEntry *)_entryWithReply:(NSDictionary *)reply prefix:(NSString *)prefix
+{
+    NSNumber *itemID = @([reply[[prefix stringByAppendingString:@"itemid"]] intValue]);
+    LJEntry *entry, *existing;
+
+    [_entryMapLock lock];
+    entry = [_entriesByItemID[itemID] object];
+    [_entryMapLock unlock];
+    if (entry == nil) {
+        entry = [[LJEntry alloc] initWithReply:reply prefix:prefix journal:self];
+        [_entryMapLock lock];
+        // Another thread may have fetched the same entry meanwhile.
+        existing = [_entriesByItemID[itemID] object];
+        if (existing == nil) [self _storeEntry:entry];
+        [_entryMapLock unlock];
+        if (existing == nil) {
+            [[self entryStore] addEntry:entry];
+            return entry;
+        }
+        entry = existing;
+    }
+    // Only a newer revision reaches the live entry and the store; unsaved
+    // local edits never reach the store.
+    if ([entry _updateWithReply:reply prefix:prefix]) {
+        [[self entryStore] addEntry:entry];
+    }
+    return entry;
+}
+
+// Must be called with _entryMapLock held.
+- (void)_storeEntry:(LJEntry *)entry
+{
+    _entriesByItemID[@([entry itemID])] = [LJWeakBox boxWithObject:entry];
+    if ([_entriesByItemID count] >= _entrySweepCount) {
+        // Sweep out boxes whose entry has gone, then wait for the map to
+        // double again.
+        LJRemoveEmptyWeakBoxes(_entriesByItemID);
+        _entrySweepCount = MAX(64, 2 * [_entriesByItemID count]);
+    }
+}
+
+- (void)_rememberEntry:(LJEntry *)entry
+{
+    [_entryMapLock lock];
+    [self _storeEntry:entry];
+    [_entryMapLock unlock];
+}
+
+- (void)_forgetEntry:(LJEntryRoot *)entry
+{
+    NSNumber *itemID = @([entry itemID]);
+
+    [_entryMapLock lock];
+    if ([_entriesByItemID[itemID] object] == entry) {
+        [_entriesByItemID removeObjectForKey:itemID];
+    }
+    [_entryMapLock unlock];
+    [[self entryStore] removeEntryWithItemID:[entry itemID]];
+    if ([entry _savedDate]) {
+        [self _entryDidMoveFromDate:[entry _savedDate] toDate:nil];
+    } else {
+        [self _invalidateDayCounts];
+    }
+}
+
+/*
+ * Returns the entry for an itemID from the local store, or nil.  A live
+ * LJEntry for the itemID is preferred, since it may be newer.
+ */
+- (LJEntry *)_storedEntryForItemID:(int)itemID
+{
+    LJEntry *entry, *existing;
+
+    [_entryMapLock lock];
+    entry = [_entriesByItemID[@(itemID)] object];
+    [_entryMapLock unlock];
+    if (entry) return entry;
+    entry = [[self entryStore] entryWithItemID:itemID];
+    if (entry == nil) return nil;
+    [_entryMapLock lock];
+    existing = [_entriesByItemID[@(itemID)] object];
+    if (existing == nil) [self _storeEntry:entry];
+    [_entryMapLock unlock];
+    return existing ?: entry;
+}
+
 - (NSArray *)getEntriesWithParameters:(NSMutableDictionary *)parameters
 {
     NSDictionary *reply = [self getEventsReplyWithParameters:parameters];
-    NSInteger count = [reply[@"events_count"] integerValue];
-    NSMutableArray *workingArray = [[NSMutableArray alloc] initWithCapacity:count];
-    for (NSInteger i = 1; i <= count; i++ ) {
-        NSString *prefix = [[NSString alloc] initWithFormat:@"events_%ld_", (long)i];
-        LJEntry *entry = [[LJEntry alloc] initWithReply:reply prefix:prefix journal:self];
-        [workingArray addObject:entry];
-    }
-    return workingArray;
+    return [[LJLazyEntryArray alloc] initWithReply:reply journal:self summaries:NO];
 }
 
 - (NSArray *)getSummariesWithParameters:(NSMutableDictionary *)parameters
@@ -184,22 +319,140 @@ static NSString *entrySummaryLength = nil;
     parameters[@"noprops"] = @"1";
     parameters[@"prefersubject"] = @"1";
     reply = [self getEventsReplyWithParameters:parameters];
-    NSInteger count = [reply[@"events_count"] integerValue];
-    NSMutableArray *workingArray = [[NSMutableArray alloc] initWithCapacity:count];
-    for (NSInteger i = 1; i <= count; i++ ) {
-        NSString *prefix = [[NSString alloc] initWithFormat:@"events_%ld_", (long)i];
-        LJEntrySummary *summary = [[LJEntrySummary alloc] initWithReply:reply prefix:prefix journal:self];
-        [workingArray addObject:summary];
-    }
-    return [workingArray copy];
+    return [[LJLazyEntryArray alloc] initWithReply:reply journal:self summaries:YES];
 }
 
 - (LJEntry *)getEntryForItemID:(int)itemID
 {
+    if ([self entryStore] && ![_account isLoggedIn] && itemID > 0) {
+        return [self _storedEntryForItemID:itemID];
+    }
     NSArray *array = [self getEntriesWithParameters:[self parametersForItemID:itemID]];
     return [array count] == 0 ? nil : array[0];
 }
 
+/*
+ * Fetches the entries for a batch of distinct itemIDs and adds them to
+ * entriesByItemID.  Uses one selecttype=multiple request where the server
+ * accepts it; otherwise falls back to concurrent selecttype=one requests.
+ */
+- (void)_getEntriesForItemIDs:(NSArray *)itemIDs into:(NSMutableDictionary *)entriesByItemID
+{
+    BOOL noMultipleSelect;
+
+    [_entryMapLock lock];
+    noMultipleSelect = _noMultipleSelect;
+    [_entryMapLock unlock];
+    if (!noMultipleSelect) {
+        NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
+        NSDictionary *reply = nil;
+
+        parameters[@"selecttype"] = @"multiple";
+        parameters[@"itemids"] = [itemIDs componentsJoinedByString:@","];
+        @try {
+            reply = [self getEventsReplyWithParameters:parameters];
+        } @catch (NSException *localException) {
+            // Older servers don't know selecttype=multiple and say so
+            // with an error reply; anything else is a real failure.
+            if (!LJIsUnsupportedSelectTypeError(localException)) {
+                @throw;
+            }
+            [_entryMapLock lock];
+            _noMultipleSelect = YES;
+            [_entryMapLock unlock];
+        }
+        if (reply) {
+            LJLazyEntryArray *entries = [[LJLazyEntryArray alloc] initWithReply:reply journal:self summaries:NO];
+            // Every entry is wanted, so decode them all at once across cores.
+            [entries buildObjectsInRange:NSMakeRange(0, [entries count])];
+            for (LJEntry *entry in entries) {
+                entriesByItemID[@([entry itemID])] = entry;
+            }
+            return;
+        }
+    }
+
+    // Requests block on the network, so rather than tie up dispatch_apply's
+    // few threads, as many workers as the host's scheduler lets run at once
+    // each take the next itemID until none are left.
+    NSString *host = [[[_account server] URL] host];
+    NSUInteger slots = host ? [[LJRequestScheduler schedulerForHost:host] maxConcurrentRequests] : 1;
+    NSUInteger workers = MIN(MAX(slots, 1), [itemIDs count]);
+    NSLock *lock = [[NSLock alloc] init];
+    __block NSUInteger nextIndex = 0;
+    __block NSException *exception = nil;
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+
+    for (NSUInteger w = 0; w < workers; w++) {
+        dispatch_group_async(group, queue, ^{
+            while (YES) {
+                NSNumber *itemID;
+                LJEntry *entry = nil;
+
+                [lock lock];
+                if (nextIndex >= [itemIDs count] || exception) {
+                    [lock unlock];
+                    return;
+                }
+                itemID = itemIDs[nextIndex++];
+                [lock unlock];
+                @try {
+                    entry = [self getEntryForItemID:[itemID intValue]];
+                } @catch (NSException *localException) {
+                    [lock lock];
+                    if (exception == nil) exception = localException;
+                    [lock unlock];
+                }
+                if (entry) {
+                    [lock lock];
+                    entriesByItemID[itemID] = entry;
+                    [lock unlock];
+                }
+            }
+        });
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+#if !OS_OBJECT_USE_OBJC
+    dispatch_release(group);
+#endif
+    [exception raise];
+}
+
+- (NSArray *)getEntriesForItemIDs:(NSArray *)itemIDs
+{
+    NSMutableDictionary *entriesByItemID = [[NSMutableDictionary alloc] initWithCapacity:[itemIDs count]];
+    NSMutableArray *pending = [[NSMutableArray alloc] init];
+    NSMutableArray *result = [[NSMutableArray alloc] initWithCapacity:[itemIDs count]];
+
+    // Ask for each itemID once, in ascending order so that repeated batches
+    // produce the same request (and hit the reply cache).
+    for (NSNumber *itemID in [[NSSet setWithArray:itemIDs] allObjects]) {
+        NSParameterAssert([itemID intValue] > 0);
+        [pending addObject:itemID];
+    }
+    [pending sortUsingSelector:@selector(compare:)];
+    for (NSUInteger start = 0; start < [pending count]; start += kMaxItemsPerRequest) {
+        NSRange range = NSMakeRange(start, MIN(kMaxItemsPerRequest, [pending count] - start));
+        [self _getEntriesForItemIDs:[pending subarrayWithRange:range] into:entriesByItemID];
+    }
+    for (NSNumber *itemID in itemIDs) {
+        [result addObject:entriesByItemID[itemID] ?: [NSNull null]];
+    }
+    return [result copy];
+}
+
+- (NSArray *)getEntriesForSummaries:(NSArray *)summaries
+{
+    NSMutableArray *itemIDs = [[NSMutableArray alloc] initWithCapacity:[summaries count]];
+
+    for (LJEntrySummary *summary in summaries) {
+        NSParameterAssert([summary journal] == self);
+        [itemIDs addObject:@([summary itemID])];
+    }
+    return [self getEntriesForItemIDs:itemIDs];
+}
+
 - (LJEntry *)getMostRecentEntry
 {
     return [self getEntryForItemID:-1];
@@ -220,6 +473,16 @@ static NSString *entrySummaryLength = nil;
     return [self getEntriesWithParameters:[self parametersForDay:date]];
 }
 
+- (LJJournalPager *)entryPagerWithPageSize:(NSUInteger)pageSize
+{
+    return [[LJJournalPager alloc] initWithJournal:self pageSize:pageSize summaries:NO];
+}
+
+- (LJJournalPager *)summaryPagerWithPageSize:(NSUInteger)pageSize
+{
+    return [[LJJournalPager alloc] initWithJournal:self pageSize:pageSize summaries:YES];
+}
+
 - (LJEntrySummary *)getSummaryForItemID:(int)itemID
 {
     NSArray *array = [self getSummariesWithParameters:[self parametersForItemID:itemID]];
@@ -241,26 +504,159 @@ static NSString *entrySummaryLength = nil;
     return [self getSummariesWithParameters:[self parametersForDay:date]];
 }
 
-- (NSDictionary *)getDayCounts
+/*
+ * Collects the itemIDs of the entries changed since cursor, following
+ * syncitems through as many replies as it takes.  Returns the server time
+ * of the last change seen, to be used as the next cursor.
+ */
+- (NSString *)_changedItemIDs:(NSMutableSet *)itemIDs sinceCursor:(NSString *)cursor
 {
-    NSDictionary *parameters;
-    NSMutableDictionary *workingCounts = [[NSMutableDictionary alloc] init];
+    NSInteger count, total;
+
+    do {
+        NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
+        NSString *lastTime = cursor;
+
+        if (cursor) parameters[@"lastsync"] = cursor;
+        if (_isNotDefault) parameters[@"usejournal"] = _name;
+        NSDictionary *reply = [_account getReplyForMode:@"syncitems" parameters:parameters];
+        count = [reply[@"sync_count"] integerValue];
+        total = [reply[@"sync_total"] integerValue];
+        for (NSInteger i = 1; i <= count; i++) {
+            NSString *item = reply[[NSString stringWithFormat:@"sync_%ld_item", (long)i]];
+            NSString *time = reply[[NSString stringWithFormat:@"sync_%ld_time", (long)i]];
+            // Items are "L-itemid" for journal entries; "C-" items are
+            // comments, which the store doesn't hold.
+            if ([item hasPrefix:@"L-"]) {
+                [itemIDs addObject:@([[item substringFromIndex:2] intValue])];
+            }
+            // Times are "yyyy-MM-dd HH:mm:ss", so they sort as strings.
+            if (time && (lastTime == nil || [time compare:lastTime] == NSOrderedDescending)) {
+                lastTime = time;
+            }
+        }
+        // Stop if the server returned nothing new, rather than loop forever.
+        if (count == 0 || lastTime == nil || [lastTime isEqualToString:cursor]) break;
+        cursor = lastTime;
+    } while (count < total);
+    return cursor;
+}
+
+- (NSUInteger)synchronizeEntryStore
+{
+    LJEntryStore *store = [self entryStore];
+    NSMutableSet *itemIDSet = [[NSMutableSet alloc] init];
+    NSArray *itemIDs, *entries;
+    NSString *cursor;
 
-    if (_isNotDefault) {
-        parameters = @{@"usejournal": _name};
+    if (store == nil) {
+        [[_account _exceptionWithName:@"LJNoEntryStoreError"] raise];
+    }
+    [_syncLock lock];
+    @try {
+        cursor = [self _changedItemIDs:itemIDSet sinceCursor:[store syncCursor]];
+        if ([itemIDSet count] > 0) {
+            // Cached getevents replies from before the changes are stale.
+            [[_account replyCache] removeRepliesForMode:@"getevents" journalName:_name];
+            itemIDs = [[itemIDSet allObjects] sortedArrayUsingSelector:@selector(compare:)];
+            // Entries fetched here are saved to the store on the way through.
+            entries = [self getEntriesForItemIDs:itemIDs];
+            [entries enumerateObjectsUsingBlock:^(id entry, NSUInteger i, BOOL *stop) {
+                if (entry == [NSNull null]) {
+                    [store removeEntryWithItemID:[itemIDs[i] intValue]];
+                }
+            }];
+        }
+        [store setSyncCursor:cursor];
+    } @finally {
+        [_syncLock unlock];
+    }
+    return [itemIDSet count];
+}
+
+- (void)exportEntriesToURL:(NSURL *)fileURL
+{
+    [[[LJJournalExport alloc] initWithJournal:self fileURL:fileURL] run];
+}
+
+/*
+ * Returns the calendar index, downloading the day counts if there is no
+ * index yet or it is older than the revalidation interval.
+ */
+- (LJCalendarIndex *)_calendarIndex
+{
+    LJCalendarIndex *index;
+
+    [_calendarLock lock];
+    @try {
+        if (_calendarIndex == nil ||
+            CFAbsoluteTimeGetCurrent() - [_calendarIndex validationTime] >= [self dayCountsRevalidationInterval]) {
+            NSDictionary *parameters = _isNotDefault ? @{@"usejournal": _name} : nil;
+            // The point is to hear from the server, not the reply cache.
+            [[_account replyCache] removeRepliesForMode:@"getdaycounts" journalName:_name];
+            NSDictionary *reply = [_account getReplyForMode:@"getdaycounts" parameters:parameters];
+            _calendarIndex = [[LJCalendarIndex alloc] initWithDayCountsReply:reply];
+        }
+        index = _calendarIndex;
+    } @finally {
+        [_calendarLock unlock];
     }
-    NSDictionary *reply = [_account getReplyForMode:@"getdaycounts" parameters:parameters];
-    NSDateFormatter *df = [[NSDateFormatter alloc] init];
-    df.locale = [[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"];
-    df.dateFormat = @"%Y-%M-%d";
-    for (NSString *key in reply) {
-        NSDate *date = [df dateFromString:key];
-        if (date) {
-            NSInteger c = [reply[key] integerValue];
-            workingCounts[date] = @(c);
+    return index;
+}
+
+- (void)_entryDidMoveFromDate:(NSDate *)oldDate toDate:(NSDate *)newDate
+{
+    NSCalendar *calendar;
+    NSDateComponents *comps;
+
+    [_calendarLock lock];
+    if (_calendarIndex) {
+        calendar = [NSCalendar calendarWithIdentifier:NSCalendarIdentifierGregorian];
+#define dayUnits NSCalendarUnitYear | NSCalendarUnitMonth | NSCalendarUnitDay
+        if (oldDate) {
+            comps = [calendar components:dayUnits fromDate:oldDate];
+            [_calendarIndex addCount:-1 forYear:comps.year month:comps.month day:comps.day];
+        }
+        if (newDate) {
+            comps = [calendar components:dayUnits fromDate:newDate];
+            [_calendarIndex addCount:1 forYear:comps.year month:comps.month day:comps.day];
         }
+#undef dayUnits
     }
-    return [NSDictionary dictionaryWithDictionary: workingCounts];
+    [_calendarLock unlock];
+}
+
+- (void)_invalidateDayCounts
+{
+    [_calendarLock lock];
+    [_calendarIndex invalidate];
+    [_calendarLock unlock];
+}
+
+- (NSDictionary *)getDayCounts
+{
+    return [[self _calendarIndex] dayCountsWithCalendar:[NSCalendar calendarWithIdentifier:NSCalendarIdentifierGregorian]];
+}
+
+- (NSUInteger)entryCountForYear:(NSInteger)year
+{
+    return [[self _calendarIndex] countForYear:year];
+}
+
+- (NSUInteger)entryCountForYear:(NSInteger)year month:(NSInteger)month
+{
+    return [[self _calendarIndex] countForYear:year month:month];
+}
+
+- (NSUInteger)entryCountForYear:(NSInteger)year month:(NSInteger)month day:(NSInteger)day
+{
+    return [[self _calendarIndex] countForYear:year month:month day:day];
+}
+
+- (void)reloadDayCounts
+{
+    [self _invalidateDayCounts];
+    [self _calendarIndex];
 }
 
 - (NSUInteger)hash
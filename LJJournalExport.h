@@ -0,0 +1,125 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class LJJournal;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*!
+ @class LJJournalExport
+ @abstract Downloads every entry in a journal to a file.
+ @discussion
+ An export first asks the server how many entries the journal holds (with
+ getdaycounts) and which itemID is the highest (with syncitems).  It then
+ downloads entries in batches of 100 consecutive itemIDs, several batches
+ at a time, up to that itemID, so however many entries have been deleted
+ along the way the export reaches the end of the journal.  Entries are
+ written to the file in itemID order as each round of batches completes.
+ Entries posted after the export starts are not included.
+
+ The file is an LJEntryStore file, so it can be opened with LJEntryStore
+ to read the entries back.  Because it only ever holds a prefix of the
+ journal in itemID order, it is also its own checkpoint: if an export is
+ interrupted, running an export to the same file again carries on after
+ the last entry written.
+ */
+@interface LJJournalExport : NSObject
+
+/*!
+ @method initWithJournal:fileURL:
+ @abstract Initializes an export of a journal to a file.
+ @discussion
+ If the file holds an earlier, interrupted export of the same journal,
+ the export resumes it.
+ */
+- (instancetype)initWithJournal:(LJJournal *)journal fileURL:(NSURL *)fileURL NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+/*!
+ @property journal
+ @abstract The journal being exported.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, strong) LJJournal *journal;
+
+/*!
+ @property fileURL
+ @abstract The file the entries are written to.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, copy) NSURL *fileURL;
+
+/*!
+ @property maxConcurrentRequests
+ @abstract The number of batches downloaded at once.
+ @discussion
+ The default is 4.  The host's LJRequestScheduler may run fewer at once.
+ */
+@property (NS_NONATOMIC_IOSONLY) NSUInteger maxConcurrentRequests;
+
+/*!
+ @property maxRequestsPerSecond
+ @abstract The most requests per second the export sends, or 0 for no limit.
+ @discussion
+ Requests are also subject to the host's LJRateLimiter.  The default is 0.
+ */
+@property (NS_NONATOMIC_IOSONLY) double maxRequestsPerSecond;
+
+/*!
+ @property compressesContent
+ @abstract Whether entries are compressed in the file.  The default is YES.
+ */
+@property (NS_NONATOMIC_IOSONLY) BOOL compressesContent;
+
+/*!
+ @property expectedEntryCount
+ @abstract The number of entries the server reported, once known.
+ */
+@property (atomic, readonly) NSUInteger expectedEntryCount;
+
+/*!
+ @property exportedEntryCount
+ @abstract The number of entries in the file so far.
+ */
+@property (atomic, readonly) NSUInteger exportedEntryCount;
+
+/*!
+ @method run
+ @abstract Performs the export, returning when it is finished or cancelled.
+ @discussion
+ Raises an exception if the file can't be opened or a request fails.
+ Everything downloaded before the failure is kept in the file.
+ */
+- (void)run;
+
+/*!
+ @method cancel
+ @abstract Stops the export after the current round of batches.
+ @discussion
+ May be called from any thread while the export runs.  Batches of the
+ current round which haven't yet sent their request are skipped.
+ */
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
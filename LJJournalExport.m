@@ -0,0 +1,196 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJJournalExport.h"
+#import "LJAccount_Private.h"
+#import "LJJournal_Private.h"
+#import "LJEntry.h"
+#import "LJEntryStore.h"
+#include <stdatomic.h>
+
+// itemIDs requested in one getevents call.
+static const int kBatchSize = 100;
+
+@interface LJJournalExport ()
+@property (atomic, readwrite) NSUInteger expectedEntryCount;
+@property (atomic, readwrite) NSUInteger exportedEntryCount;
+@end
+
+@implementation LJJournalExport
+{
+    NSLock *_throttleLock;
+    NSDate *_nextRequestDate;
+    // Set by cancel from any thread; read by run and its batches.
+    atomic_bool _isCancelled;
+}
+
+- (instancetype)initWithJournal:(LJJournal *)journal fileURL:(NSURL *)fileURL
+{
+    self = [super init];
+    if (self) {
+        NSParameterAssert(journal);
+        NSParameterAssert([fileURL isFileURL]);
+        _journal = journal;
+        _fileURL = [fileURL copy];
+        _maxConcurrentRequests = 4;
+        _compressesContent = YES;
+        _throttleLock = [[NSLock alloc] init];
+    }
+    return self;
+}
+
+- (void)cancel
+{
+    atomic_store_explicit(&_isCancelled, true, memory_order_release);
+}
+
+// Sums the day counts to find how many entries the journal holds.
+- (NSUInteger)_journalEntryCount
+{
+    LJAccount *account = [_journal account];
+    NSDictionary *parameters = [_journal isDefault] ? nil : @{@"usejournal": [_journal name]};
+    NSDictionary *reply = [account getReplyForMode:@"getdaycounts" parameters:parameters];
+    __block NSUInteger total = 0;
+
+    // Day keys are "yyyy-MM-dd"; skip "success" and the like.
+    [reply enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *value, BOOL *stop) {
+        if ([key length] == 10 && [key characterAtIndex:4] == '-') {
+            total += MAX([value integerValue], 0);
+        }
+    }];
+    return total;
+}
+
+/*
+ * Finds the highest itemID in the journal by listing every entry with
+ * syncitems.  lastn won't do: it goes by the entries' dates, and a
+ * backdated entry may have the highest itemID.
+ */
+- (int)_latestItemID
+{
+    NSMutableSet *itemIDs = [[NSMutableSet alloc] init];
+
+    [_journal _changedItemIDs:itemIDs sinceCursor:nil];
+    return [[itemIDs valueForKeyPath:@"@max.intValue"] intValue];
+}
+
+// Waits until the next request may start under maxRequestsPerSecond.
+- (void)_waitForRequestSlot
+{
+    double rate = [self maxRequestsPerSecond];
+    NSDate *startDate;
+
+    if (rate <= 0) return;
+    [_throttleLock lock];
+    startDate = [_nextRequestDate laterDate:[NSDate date]] ?: [NSDate date];
+    _nextRequestDate = [startDate dateByAddingTimeInterval:1.0 / rate];
+    [_throttleLock unlock];
+    [NSThread sleepUntilDate:startDate];
+}
+
+- (void)run
+{
+    LJEntryStore *store = [[LJEntryStore alloc] initWithFileURL:_fileURL];
+    NSUInteger concurrency = MAX([self maxConcurrentRequests], 1);
+    int firstItemID, lastItemID;
+
+    if (store == nil) {
+        [[[_journal account] _exceptionWithName:@"LJExportFileError"] raise];
+    }
+    [store setCompressesContent:[self compressesContent]];
+    atomic_store_explicit(&_isCancelled, false, memory_order_release);
+    self.expectedEntryCount = [self _journalEntryCount];
+    self.exportedEntryCount = [store count];
+    // The file holds everything up to its last itemID; carry on from there.
+    firstItemID = [store lastItemID] + 1;
+    // Runs of deleted itemIDs can be any length, so the export goes by the
+    // last itemID rather than stopping when a round comes back empty.
+    lastItemID = [self _latestItemID];
+
+    while (!atomic_load_explicit(&_isCancelled, memory_order_acquire) && firstItemID <= lastItemID) {
+        NSUInteger batchCount = MIN(concurrency, (NSUInteger)(lastItemID - firstItemID) / kBatchSize + 1);
+        NSMutableArray *batches = [[NSMutableArray alloc] initWithCapacity:batchCount];
+        __block NSException *exception = nil;
+        __block NSUInteger failedBatch = NSNotFound;
+        NSLock *lock = [[NSLock alloc] init];
+        dispatch_group_t group = dispatch_group_create();
+        dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+
+        for (NSUInteger b = 0; b < batchCount; b++) {
+            [batches addObject:[[NSMutableDictionary alloc] initWithCapacity:kBatchSize]];
+        }
+        // Requests block on the network, so each batch gets its own thread
+        // rather than sharing dispatch_apply's few.
+        for (NSUInteger b = 0; b < batchCount; b++) {
+            dispatch_group_async(group, queue, ^{
+                NSMutableArray *itemIDs = [[NSMutableArray alloc] initWithCapacity:kBatchSize];
+                NSMutableDictionary *entries = [[NSMutableDictionary alloc] initWithCapacity:kBatchSize];
+                int start = firstItemID + (int)b * kBatchSize;
+
+                for (int itemID = start; itemID < start + kBatchSize && itemID <= lastItemID; itemID++) {
+                    [itemIDs addObject:@(itemID)];
+                }
+                @try {
+                    [self _waitForRequestSlot];
+                    if (atomic_load_explicit(&_isCancelled, memory_order_acquire)) {
+                        // Not fetched, so nothing from here on is written.
+                        [lock lock];
+                        if (b < failedBatch) {
+                            failedBatch = b;
+                            exception = nil;
+                        }
+                        [lock unlock];
+                        return;
+                    }
+                    [_journal _getEntriesForItemIDs:itemIDs into:entries];
+                    [lock lock];
+                    batches[b] = entries;
+                    [lock unlock];
+                } @catch (NSException *localException) {
+                    [lock lock];
+                    if (b < failedBatch) {
+                        failedBatch = b;
+                        exception = localException;
+                    }
+                    [lock unlock];
+                }
+            });
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+#if !OS_OBJECT_USE_OBJC
+        dispatch_release(group);
+#endif
+
+        // Write the batches in order, up to the first one that failed, so
+        // the file stays a prefix of the journal.
+        for (NSUInteger b = 0; b < MIN(failedBatch, batchCount); b++) {
+            NSDictionary *entries = batches[b];
+            for (NSNumber *itemID in [[entries allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+                [store addEntry:entries[itemID]];
+            }
+        }
+        self.exportedEntryCount = [store count];
+        [exception raise];
+        firstItemID += (int)batchCount * kBatchSize;
+    }
+}
+
+@end
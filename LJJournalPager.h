@@ -0,0 +1,121 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class LJJournal;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*!
+ @class LJJournalPager
+ @abstract Pages back through a journal's history.
+ @discussion
+ A pager remembers where it is in a journal, so that a client can browse
+ from the most recent entries backwards one page at a time without working
+ out the beforedate of each request itself.  The first call to nextPage
+ downloads the most recent entries; each later call downloads the entries
+ posted before those on the previous page.  Pages already seen are kept, so
+ previousPage never contacts the server.
+
+ Whenever a page is returned, the pager starts downloading the page after
+ it in the background, so that the next call to nextPage usually returns
+ at once.  Entries posted at the same minute as the last entry on a page
+ are neither skipped nor repeated on the next page.
+
+ A pager should be used from one thread at a time.
+ */
+@interface LJJournalPager : NSObject
+
+/*!
+ @method initWithJournal:pageSize:summaries:
+ @abstract Initializes a pager for a journal.
+ @param journal The journal to page through.
+ @param pageSize The number of entries per page, at most 50.
+ @param summaries YES to page through LJEntrySummary objects, NO for LJEntry objects.
+ */
+- (instancetype)initWithJournal:(LJJournal *)journal pageSize:(NSUInteger)pageSize
+                      summaries:(BOOL)summaries NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+/*!
+ @property journal
+ @abstract The journal the receiver pages through.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, strong) LJJournal *journal;
+
+/*!
+ @property pageSize
+ @abstract The number of entries the receiver asks for per page.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger pageSize;
+
+/*!
+ @property currentPage
+ @abstract The page most recently returned, or nil before the first.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, copy, nullable) NSArray *currentPage;
+
+/*!
+ @property pageIndex
+ @abstract The index of the current page; 0 is the most recent entries.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger pageIndex;
+
+/*!
+ @property hasNextPage
+ @abstract NO once the receiver has reached the oldest entry in the journal.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) BOOL hasNextPage;
+
+/*!
+ @property hasPreviousPage
+ @abstract YES if there is a more recent page to go back to.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) BOOL hasPreviousPage;
+
+/*!
+ @method nextPage
+ @abstract Moves to the page of older entries and returns it.
+ @discussion
+ Raises an exception if the page had to be downloaded and the download failed.
+ @result The page, or nil if there are no older entries.
+ */
+- (nullable NSArray *)nextPage;
+
+/*!
+ @method previousPage
+ @abstract Moves back to the page of more recent entries and returns it.
+ @result The page, or nil if the receiver is at the first page.
+ */
+- (nullable NSArray *)previousPage;
+
+/*!
+ @method reset
+ @abstract Forgets all pages, so that the next call to nextPage starts again
+ from the most recent entries.
+ */
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
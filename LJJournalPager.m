@@ -0,0 +1,225 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJJournalPager.h"
+#import "LJJournal_Private.h"
+#import "LJEntry_Private.h"
+#import "LJLazyEntryArray.h"
+
+// The most entries the server returns for selecttype=lastn.
+static const NSUInteger kMaxPageSize = 50;
+
+// A page being downloaded in the background.
+@interface LJPagerPrefetch : NSObject
+{
+@public
+    NSConditionLock *_doneLock; // condition becomes 1 once finished
+    NSArray *_page;
+    BOOL _reachedEnd;
+    NSException *_exception;
+}
+@end
+
+@implementation LJPagerPrefetch
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _doneLock = [[NSConditionLock alloc] initWithCondition:0];
+    }
+    return self;
+}
+
+@end
+
+@implementation LJJournalPager
+{
+    BOOL _summaries;
+    // Every page seen so far, most recent first.
+    NSMutableArray *_pages;
+    BOOL _reachedEnd;
+    // The download of the page after the last in _pages, if any.
+    LJPagerPrefetch *_prefetch;
+}
+
+- (instancetype)initWithJournal:(LJJournal *)journal pageSize:(NSUInteger)pageSize summaries:(BOOL)summaries
+{
+    self = [super init];
+    if (self) {
+        NSParameterAssert(journal);
+        NSParameterAssert(pageSize > 0 && pageSize <= kMaxPageSize);
+        _journal = journal;
+        _pageSize = pageSize;
+        _summaries = summaries;
+        _pages = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (NSArray *)currentPage
+{
+    return ([_pages count] > 0) ? _pages[_pageIndex] : nil;
+}
+
+- (BOOL)hasNextPage
+{
+    return (_pageIndex + 1 < [_pages count]) || !_reachedEnd;
+}
+
+- (BOOL)hasPreviousPage
+{
+    return _pageIndex > 0;
+}
+
+/*
+ * Downloads the page of entries posted before those on page, or the most
+ * recent entries if page is nil.  The server only takes a beforedate, so
+ * entries sharing the oldest time on page would be lost between pages;
+ * instead the request reaches one second past that time, asks for that
+ * many more entries, and drops the ones already seen.  If every entry
+ * it gets back was seen, more entries share that time than one request
+ * can return; the request is then made again from just before that time,
+ * giving up the ones lastn can't reach rather than the rest of the journal.
+ */
+- (NSArray *)_fetchPageAfter:(NSArray *)page reachedEnd:(BOOL *)reachedEnd
+{
+    NSDate *boundary = nil, *beforeDate = nil;
+    NSMutableSet *seen = [[NSMutableSet alloc] init];
+    NSMutableDictionary *parameters;
+    NSUInteger howMany;
+    NSArray *result;
+
+    if (page) {
+        for (LJEntryRoot *entry in page) {
+            NSDate *date = [entry date];
+            if (date) boundary = boundary ? [boundary earlierDate:date] : date;
+        }
+        if (boundary == nil) {
+            *reachedEnd = YES;
+            return nil;
+        }
+        for (LJEntryRoot *entry in page) {
+            if ([[entry date] isEqualToDate:boundary]) [seen addObject:@([entry itemID])];
+        }
+        beforeDate = [boundary dateByAddingTimeInterval:1.0];
+    }
+    while (YES) {
+        howMany = MIN(_pageSize + [seen count], kMaxPageSize);
+        parameters = [_journal parametersLastN:(int)howMany beforeDate:beforeDate];
+        if (_summaries) {
+            result = [_journal getSummariesWithParameters:parameters];
+        } else {
+            result = [_journal getEntriesWithParameters:parameters];
+        }
+        *reachedEnd = ([result count] < howMany);
+        if ([result isKindOfClass:[LJLazyEntryArray class]]) {
+            // The page is about to be shown, so build all of it now.
+            [(LJLazyEntryArray *)result buildObjectsInRange:NSMakeRange(0, [result count])];
+        }
+        if ([seen count] > 0) {
+            NSIndexSet *fresh = [result indexesOfObjectsPassingTest:^BOOL(LJEntryRoot *entry, NSUInteger i, BOOL *stop) {
+                return ![seen containsObject:@([entry itemID])];
+            }];
+            result = [result objectsAtIndexes:fresh];
+        }
+        if ([result count] > 0 || *reachedEnd || [seen count] == 0) break;
+        // A full reply of entries already seen: step back past their time.
+        beforeDate = boundary;
+        [seen removeAllObjects];
+    }
+    if ([result count] == 0) {
+        *reachedEnd = YES;
+        return nil;
+    }
+    return result;
+}
+
+- (void)_startPrefetchIfNeeded
+{
+    LJPagerPrefetch *prefetch;
+    NSArray *lastPage = [_pages lastObject];
+
+    if (_reachedEnd || _prefetch || lastPage == nil) return;
+    prefetch = [[LJPagerPrefetch alloc] init];
+    _prefetch = prefetch;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        BOOL reachedEnd = NO;
+        [prefetch->_doneLock lock];
+        @try {
+            prefetch->_page = [self _fetchPageAfter:lastPage reachedEnd:&reachedEnd];
+            prefetch->_reachedEnd = reachedEnd;
+        } @catch (NSException *localException) {
+            prefetch->_exception = localException;
+        }
+        [prefetch->_doneLock unlockWithCondition:1];
+    });
+}
+
+- (NSArray *)nextPage
+{
+    LJPagerPrefetch *prefetch = _prefetch;
+    NSArray *page = nil;
+    BOOL reachedEnd = NO;
+
+    if (_pageIndex + 1 < [_pages count]) {
+        _pageIndex++;
+        return _pages[_pageIndex];
+    }
+    if (_reachedEnd) return nil;
+    _prefetch = nil;
+    if (prefetch) {
+        [prefetch->_doneLock lockWhenCondition:1];
+        [prefetch->_doneLock unlock];
+    }
+    if (prefetch && prefetch->_exception == nil) {
+        page = prefetch->_page;
+        reachedEnd = prefetch->_reachedEnd;
+    } else {
+        // No prefetch, or it failed; try again here so the caller sees
+        // any exception.
+        page = [self _fetchPageAfter:[_pages lastObject] reachedEnd:&reachedEnd];
+    }
+    _reachedEnd = reachedEnd;
+    if (page == nil) return nil;
+    [_pages addObject:page];
+    _pageIndex = [_pages count] - 1;
+    [self _startPrefetchIfNeeded];
+    return page;
+}
+
+- (NSArray *)previousPage
+{
+    if (_pageIndex == 0) return nil;
+    _pageIndex--;
+    return _pages[_pageIndex];
+}
+
+- (void)reset
+{
+    // A download in progress finishes on its own and is thrown away.
+    _prefetch = nil;
+    [_pages removeAllObjects];
+    _pageIndex = 0;
+    _reachedEnd = NO;
+}
+
+@end
@@ -25,8 +25,20 @@
 
 #import "LJJournal.h"
 
+@class LJEntryRoot;
+
 @interface LJJournal ()
 + (LJJournal *)_journalWithName:(NSString *)name account:(LJAccount *)account;
 + (NSArray *)_journalArrayFromLoginReply:(NSDictionary *)reply account:(LJAccount *)account;
 - (instancetype)initWithName:(NSString *)name account:(LJAccount *)account;
+- (NSMutableDictionary *)parametersLastN:(int)n beforeDate:(NSDate *)date;
+- (NSArray *)getEntriesWithParameters:(NSMutableDictionary *)parameters;
+- (NSArray *)getSummariesWithParameters:(NSMutableDictionary *)parameters;
+- (LJEntry *)_entryWithReply:(NSDictionary *)reply prefix:(NSString *)prefix;
+- (void)_getEntriesForItemIDs:(NSArray *)itemIDs into:(NSMutableDictionary *)entriesByItemID;
+- (NSString *)_changedItemIDs:(NSMutableSet *)itemIDs sinceCursor:(NSString *)cursor;
+- (void)_rememberEntry:(LJEntry *)entry;
+- (void)_forgetEntry:(LJEntryRoot *)entry;
+- (void)_entryDidMoveFromDate:(NSDate *)oldDate toDate:(NSDate *)newDate;
+- (void)_invalidateDayCounts;
 @end
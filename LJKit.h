@@ -83,11 +83,19 @@
 #import <LJKit/LJCheckFriendsSession.h>
 #import <LJKit/LJServer.h>
 #import <LJKit/LJMoods.h>
+#import <LJKit/LJReplyCache.h>
+#import <LJKit/LJRequestScheduler.h>
+#import <LJKit/LJRateLimiter.h>
 #import <LJKit/LJJournal.h>
 #import <LJKit/LJEntry.h>
 #import <LJKit/LJEntry_Metadata.h>
 #import <LJKit/LJEntrySummary.h>
+#import <LJKit/LJEntryStore.h>
+#import <LJKit/LJJournalExport.h>
+#import <LJKit/LJJournalPager.h>
+#import <LJKit/LJOutbox.h>
 #import <LJKit/LJFriend.h>
+#import <LJKit/LJFriendsSnapshot.h>
 #import <LJKit/LJGroup.h>
 #import <LJKit/LJHttpURLs.h>
 #import <LJKit/LJUserEntity.h>
@@ -0,0 +1,51 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class LJJournal;
+
+/*
+ * An immutable array over the events in a getevents reply.  It keeps the
+ * reply and builds each LJEntry or LJEntrySummary the first time its index
+ * is asked for, so a caller who only looks at the first few entries of a
+ * long result never pays to parse the rest.
+ *
+ * Entries are made through the journal's identity map, so an entry built
+ * late is still the same object as any other live copy of it.
+ */
+@interface LJLazyEntryArray : NSArray
+- (instancetype)initWithReply:(NSDictionary *)reply journal:(LJJournal *)journal summaries:(BOOL)summaries;
+
+/*
+ * Builds every entry in the range that hasn't been built yet.  Large
+ * ranges are decoded on all cores at once; each event in the reply is
+ * independent, so only the order of the results needs preserving.
+ */
+- (void)buildObjectsInRange:(NSRange)range;
+
+/*
+ * The most threads buildObjectsInRange: decodes on at once.  Zero, the
+ * default, leaves it to GCD, which uses every core; 1 decodes on the
+ * calling thread.  Mostly for measuring how decoding scales.
+ */
+@property (nonatomic) NSUInteger maxDecodeThreads;
+@end
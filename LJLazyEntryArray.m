@@ -0,0 +1,205 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJLazyEntryArray.h"
+#import "LJEntry_Private.h"
+#import "LJJournal_Private.h"
+
+// Ranges with fewer unbuilt entries than this are decoded on the calling
+// thread; below it, handing work to other cores costs more than it saves.
+static const NSUInteger kParallelDecodeThreshold = 32;
+// Entries decoded by each dispatch_apply iteration.
+static const NSUInteger kParallelDecodeStride = 8;
+
+@implementation LJLazyEntryArray
+{
+    NSDictionary *_reply;
+    LJJournal *_journal;
+    NSUInteger _count;
+    BOOL _summaries;
+    NSLock *_lock;
+    // The entries built so far, nil where not yet touched.
+    __strong id *_objects;
+}
+
+- (instancetype)initWithReply:(NSDictionary *)reply journal:(LJJournal *)journal summaries:(BOOL)summaries
+{
+    self = [super init];
+    if (self) {
+        NSInteger count = [reply[@"events_count"] integerValue];
+        _reply = reply;
+        _journal = journal;
+        _count = (count > 0) ? count : 0;
+        _summaries = summaries;
+        _lock = [[NSLock alloc] init];
+        _objects = (__strong id *)calloc(MAX(_count, 1), sizeof(id));
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < _count; i++) {
+        _objects[i] = nil;
+    }
+    free(_objects);
+}
+
+- (NSUInteger)count
+{
+    return _count;
+}
+
+// Decodes the event at an index.  Safe to call from several threads at
+// once for different indexes.
+- (id)_newObjectAtIndex:(NSUInteger)index
+{
+    NSString *prefix = [[NSString alloc] initWithFormat:@"events_%lu_", (unsigned long)index + 1];
+    if (_summaries) {
+        return [[LJEntrySummary alloc] initWithReply:_reply prefix:prefix journal:_journal];
+    } else {
+        return [_journal _entryWithReply:_reply prefix:prefix];
+    }
+}
+
+- (void)_checkRange:(NSRange)range
+{
+    if (NSMaxRange(range) > _count || NSMaxRange(range) < range.location) {
+        [NSException raise:NSRangeException
+                    format:@"range %@ beyond bounds [0 .. %ld]",
+                           NSStringFromRange(range), (long)_count - 1];
+    }
+}
+
+/*
+ * Entries are decoded with _lock released: decoding may raise, and an
+ * LJEntry being updated posts KVO notifications whose observers may well
+ * read this array.  The lock only guards publishing into _objects; if two
+ * threads decode the same index, the first to publish wins.
+ */
+- (id)objectAtIndex:(NSUInteger)index
+{
+    id object;
+
+    if (index >= _count) {
+        [NSException raise:NSRangeException
+                    format:@"index %lu beyond bounds [0 .. %ld]",
+                           (unsigned long)index, (long)_count - 1];
+    }
+    [_lock lock];
+    object = _objects[index];
+    [_lock unlock];
+    if (object == nil) {
+        id built = [self _newObjectAtIndex:index];
+        [_lock lock];
+        if (_objects[index] == nil) _objects[index] = built;
+        object = _objects[index];
+        [_lock unlock];
+    }
+    return object;
+}
+
+- (void)buildObjectsInRange:(NSRange)range
+{
+    NSUInteger *unbuilt, unbuiltCount = 0;
+    __strong id *built;
+    NSLock *exceptionLock;
+    __block NSException *exception = nil;
+
+    [self _checkRange:range];
+    unbuilt = malloc(MAX(range.length, 1) * sizeof(NSUInteger));
+    [_lock lock];
+    for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+        if (_objects[i] == nil) unbuilt[unbuiltCount++] = i;
+    }
+    [_lock unlock];
+    if (unbuiltCount == 0) {
+        free(unbuilt);
+        return;
+    }
+    // Decode into a private buffer, then publish everything at once.
+    built = (__strong id *)calloc(unbuiltCount, sizeof(id));
+    if (unbuiltCount < kParallelDecodeThreshold || _maxDecodeThreads == 1) {
+        @try {
+            for (NSUInteger k = 0; k < unbuiltCount; k++) {
+                built[k] = [self _newObjectAtIndex:unbuilt[k]];
+            }
+        } @catch (NSException *localException) {
+            exception = localException;
+        }
+    } else {
+        // Every iteration writes to its own slots.  An exception can't be
+        // allowed out of dispatch_apply, so the first is kept and raised
+        // once the entries built so far are published.
+        // With a thread limit, each of that many iterations takes every
+        // nth stride, since dispatch_apply never runs more iterations at
+        // once than there are.
+        __strong id *objects = built;
+        size_t strides = (unbuiltCount + kParallelDecodeStride - 1) / kParallelDecodeStride;
+        size_t lanes = (_maxDecodeThreads > 0) ? MIN(_maxDecodeThreads, strides) : strides;
+        exceptionLock = [[NSLock alloc] init];
+        dispatch_apply(lanes, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t lane) {
+            for (size_t s = lane; s < strides; s += lanes) {
+                NSUInteger end = MIN((s + 1) * kParallelDecodeStride, unbuiltCount);
+                for (NSUInteger k = s * kParallelDecodeStride; k < end; k++) {
+                    @autoreleasepool {
+                        @try {
+                            objects[k] = [self _newObjectAtIndex:unbuilt[k]];
+                        } @catch (NSException *localException) {
+                            [exceptionLock lock];
+                            if (exception == nil) exception = localException;
+                            [exceptionLock unlock];
+                        }
+                    }
+                }
+            }
+        });
+    }
+    [_lock lock];
+    for (NSUInteger k = 0; k < unbuiltCount; k++) {
+        if (_objects[unbuilt[k]] == nil) _objects[unbuilt[k]] = built[k];
+    }
+    [_lock unlock];
+    for (NSUInteger k = 0; k < unbuiltCount; k++) {
+        built[k] = nil;
+    }
+    free(built);
+    free(unbuilt);
+    [exception raise];
+}
+
+- (void)getObjects:(__unsafe_unretained id [])buffer range:(NSRange)range
+{
+    [self buildObjectsInRange:range];
+    [_lock lock];
+    for (NSUInteger i = 0; i < range.length; i++) {
+        buffer[i] = _objects[range.location + i];
+    }
+    [_lock unlock];
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    // Immutable, so a copy can share the entries already built.
+    return self;
+}
+
+@end
@@ -24,6 +24,7 @@
  */
 
 #import "LJMoods.h"
+#import "LJMoods_Private.h"
 #if !TARGET_OS_IPHONE
 #import "LJMoods_Cocoa.h"
 #endif
@@ -80,6 +81,34 @@
     [encoder encodeObject:moodmap forKey:@"LJMoodsDictionary"];
 }
 
+- (instancetype)_initWithArchiveReader:(LJAccountArchiveReader *)reader
+{
+    if (self = [self init]) {
+        NSUInteger count;
+        const LJArchiveStringPair *pairs = [reader recordsInSection:LJArchiveMoodSection count:&count];
+
+        // Written in name order, so each insertion is an append.
+        for (NSUInteger i = 0; i < count; i++) {
+            [self _addMoodID:[reader stringForReference:pairs[i].value]
+                     forName:[reader stringForReference:pairs[i].key]];
+        }
+    }
+    return self;
+}
+
+- (void)_addToArchiveWriter:(LJAccountArchiveWriter *)writer
+{
+    NSUInteger count = [_moodNames count];
+    NSMutableData *data = [[NSMutableData alloc] initWithLength:count * sizeof(LJArchiveStringPair)];
+    LJArchiveStringPair *pairs = [data mutableBytes];
+
+    for (NSUInteger i = 0; i < count; i++) {
+        pairs[i].key = [writer referenceForString:_moodNames[i]];
+        pairs[i].value = [writer referenceForString:_moodIDs[i]];
+    }
+    [writer setData:data count:count forSection:LJArchiveMoodSection];
+}
+
 - (NSInteger)_indexForMoodName:(NSString *)moodName hypothetical:(BOOL)flag
 {
     NSInteger min, i, max;
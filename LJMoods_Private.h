@@ -24,7 +24,10 @@
  */
 
 #import "LJMoods.h"
+#import "LJAccountArchive.h"
 
 @interface LJMoods ()
 - (void)updateMoodsWithLoginReply:(NSDictionary *)reply;
+- (instancetype)_initWithArchiveReader:(LJAccountArchiveReader *)reader;
+- (void)_addToArchiveWriter:(LJAccountArchiveWriter *)writer;
 @end
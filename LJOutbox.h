@@ -0,0 +1,153 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class LJAccount, LJEntry;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*!
+ @typedef LJOutboxCompletionHandler
+ @abstract Called on the main thread once the outbox has finished with a request.
+ @param exception nil if the server accepted the request, or the exception
+ describing why it refused it.
+ */
+typedef void (^LJOutboxCompletionHandler)(NSException * _Nullable exception);
+
+/*!
+ @class LJOutbox
+ @abstract Saves and removes entries when the server can be reached.
+ @discussion
+ LJEntry's saveToJournal and removeFromJournal talk to the server at once,
+ and raise an exception if it can't be reached.  An outbox instead takes
+ the request, writes it to a log file and flushes the file to disk before
+ returning, so that it survives the application quitting or crashing.  The
+ requests are then sent in the background, and sent again after a delay
+ if the server can't be reached or the account isn't logged in.  If
+ reachability monitoring is enabled on the account's server, the outbox
+ also tries again as soon as the server becomes reachable.
+
+ Requests for the same journal are sent one at a time, in the order they
+ were queued; requests for different journals are sent side by side.  An
+ entry may be edited or removed through the outbox before the outbox has
+ posted it: the later requests wait for the post and use the itemID it
+ returns.  Requests for one journal aren't overlapped because a request
+ may depend on an earlier one, and the outbox doesn't record which do.
+
+ A post may reach the server and be saved even though the reply is lost,
+ for instance when the connection drops or the application quits while
+ waiting.  Before sending such a post again, the outbox looks among the
+ journal's ten latest entries for one with the same subject, time and
+ text, and if it finds one takes that as the post's result.  A duplicate
+ entry is still possible if the server changed the text it saved, or if
+ ten or more entries were posted to the journal in the meantime.
+
+ When a request has been sent, the outbox updates the entry as
+ saveToJournal or removeFromJournal would have (filling in the itemID and
+ anum of a new entry, and posting the same notifications), provided the
+ entry object still exists, and then calls the completion handler.  A
+ saved entry stays edited until the server accepts the save, and stays
+ edited after that if it was changed again meanwhile.  A request the
+ server refuses is not tried again; its completion handler gets the
+ exception.  Completion handlers are not saved to disk, so
+ requests left over from an earlier launch complete silently.
+
+ The outbox remembers the itemID of each entry it posts for 30 days, in
+ its log file.  An entry archived while its post was queued is matched
+ with it after relaunch, so saving the entry again edits the posted entry
+ instead of posting a second one.
+ */
+@interface LJOutbox : NSObject
+
+/*!
+ @method initWithAccount:fileURL:
+ @abstract Opens the outbox logged in a file, creating the file if necessary.
+ @discussion
+ Requests left in the file from an earlier launch are sent again.  Each
+ account should have its own file, and only one outbox may use a file at
+ a time.
+ @result The outbox, or nil if the file could not be opened.
+ */
+- (nullable instancetype)initWithAccount:(LJAccount *)account fileURL:(NSURL *)fileURL NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+/*!
+ @property account
+ @abstract The account whose requests the receiver sends.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, strong) LJAccount *account;
+
+/*!
+ @property fileURL
+ @abstract The file in which the receiver logs its requests.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, copy) NSURL *fileURL;
+
+/*!
+ @property pendingCount
+ @abstract The number of requests not yet accepted or refused by the server.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger pendingCount;
+
+/*!
+ @property retryInterval
+ @abstract The number of seconds to wait before trying again after a failure.
+ @discussion
+ The wait doubles with each failure in a row, up to an hour.  The default
+ is 30 seconds.
+ */
+@property (atomic) NSTimeInterval retryInterval;
+
+/*!
+ @method enqueueSaveOfEntry:completionHandler:
+ @abstract Queues a request to post or edit an entry as it now stands.
+ @discussion
+ The entry must belong to a journal of the receiver's account.  Later
+ changes to the entry are not part of the request.  Raises an exception if
+ the request could not be written to the log file.
+ */
+- (void)enqueueSaveOfEntry:(LJEntry *)entry completionHandler:(nullable LJOutboxCompletionHandler)handler;
+
+/*!
+ @method enqueueRemovalOfEntry:completionHandler:
+ @abstract Queues a request to remove an entry from its journal.
+ @discussion
+ The entry must have been posted, or be queued to be posted by the receiver;
+ otherwise raises an LJOutboxUnpostedEntryError exception, without posting
+ LJEntryWillRemoveFromJournalNotification.  Also raises an exception if the
+ request could not be written to the log file.
+ */
+- (void)enqueueRemovalOfEntry:(LJEntry *)entry completionHandler:(nullable LJOutboxCompletionHandler)handler;
+
+/*!
+ @method drain
+ @abstract Starts sending queued requests now, without waiting for a retry.
+ @discussion
+ The receiver does this by itself whenever a request is queued.  Call it
+ after logging in to send requests queued while logged out.
+ */
+- (void)drain;
+
+@end
+
+NS_ASSUME_NONNULL_END
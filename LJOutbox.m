@@ -0,0 +1,554 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJOutbox.h"
+#import "LJAccount_Private.h"
+#import "LJEntry_Private.h"
+#import "LJJournal_Private.h"
+#import "LJServer.h"
+#import "LJWeakBox.h"
+#import "URLEncoding.h"
+#include <zlib.h>
+
+/*
+ * The log file is a series of records, each a binary property list
+ * preceded by its length and CRC-32 (host byte order).  An "op" record
+ * queues a request; a "done" record retires one.  The requests still
+ * pending are the ops without a done record.  Once there are none the
+ * file is rewritten with only the done records of recent posts, which
+ * map an entry's outbox ID to its itemID for entries archived before
+ * they learned it.
+ */
+typedef struct {
+    uint32_t length;
+    uint32_t checksum;
+} LJOutboxRecordHeader;
+
+// The longest wait between retries, however many failures in a row.
+static const NSTimeInterval kMaxRetryDelay = 3600;
+
+// How long the itemID of a post is kept for entries which haven't been
+// told it, such as ones archived while the post was queued.
+static const NSTimeInterval kPostedItemLifetime = 30 * 24 * 3600;
+
+// How many of a journal's latest entries are searched for a post which
+// may have been saved before its reply was lost.
+static const NSUInteger kLostPostSearchCount = 10;
+
+static NSString *LJCreateUUIDString(void)
+{
+    CFUUIDRef uuid = CFUUIDCreate(kCFAllocatorDefault);
+    NSString *string = CFBridgingRelease(CFUUIDCreateString(kCFAllocatorDefault, uuid));
+    CFRelease(uuid);
+    return string;
+}
+
+@implementation LJOutbox
+{
+    NSLock *_lock;
+    NSFileHandle *_fileHandle;
+    // Requests not yet retired, oldest first.
+    NSMutableArray *_pending;
+    // The itemID and anum the server gave each entry posted through the
+    // outbox, by the entry's outbox ID.
+    NSMutableDictionary *_postedItems;
+    // For requests queued since launch: the entry (in an LJWeakBox) and the
+    // completion handler, by request ID.
+    NSMutableDictionary *_entryBoxes;
+    NSMutableDictionary *_handlers;
+    // IDs of postevent requests which may have reached the server without
+    // the reply reaching us: those replayed from the log, and those whose
+    // last send failed in transit.
+    NSMutableSet *_unconfirmedPosts;
+    // Names of the journals whose requests are being sent.
+    NSMutableSet *_drainingJournals;
+    NSUInteger _failureCount;
+    BOOL _isRetryScheduled;
+}
+
+- (instancetype)initWithAccount:(LJAccount *)account fileURL:(NSURL *)fileURL
+{
+    self = [super init];
+    if (self) {
+        NSParameterAssert(account);
+        NSParameterAssert([fileURL isFileURL]);
+        _account = account;
+        _fileURL = [fileURL copy];
+        _retryInterval = 30;
+        _lock = [[NSLock alloc] init];
+        _pending = [[NSMutableArray alloc] init];
+        _postedItems = [[NSMutableDictionary alloc] init];
+        _entryBoxes = [[NSMutableDictionary alloc] init];
+        _handlers = [[NSMutableDictionary alloc] init];
+        _drainingJournals = [[NSMutableSet alloc] init];
+        _unconfirmedPosts = [[NSMutableSet alloc] init];
+        if (![self _openFile]) return nil;
+#ifdef ENABLE_REACHABILITY_MONITORING
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(_serverReachabilityDidChange:)
+                                                     name:LJServerReachabilityDidChangeNotification
+                                                   object:[account server]];
+#endif
+        if ([_pending count] > 0) [self drain];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [_fileHandle closeFile];
+}
+
+- (NSUInteger)pendingCount
+{
+    NSUInteger count;
+
+    [_lock lock];
+    count = [_pending count];
+    [_lock unlock];
+    return count;
+}
+
+#pragma mark Log file
+
+// Replays the log to find the requests still pending.
+- (BOOL)_openFile
+{
+    NSString *path = [_fileURL path];
+    NSData *data;
+    const uint8_t *bytes;
+    NSUInteger length, offset = 0;
+    NSMutableDictionary *opsByID = [[NSMutableDictionary alloc] init];
+
+    if (![[NSFileManager defaultManager] fileExistsAtPath:path] &&
+        ![[NSData data] writeToFile:path atomically:YES]) {
+        return NO;
+    }
+    _fileHandle = [NSFileHandle fileHandleForUpdatingAtPath:path];
+    data = [NSData dataWithContentsOfFile:path];
+    if (_fileHandle == nil || data == nil) return NO;
+    bytes = [data bytes];
+    length = [data length];
+    while (offset + sizeof(LJOutboxRecordHeader) <= length) {
+        LJOutboxRecordHeader header;
+        NSDictionary *record;
+
+        memcpy(&header, bytes + offset, sizeof(header));
+        if (header.length > length - offset - sizeof(header) ||
+            crc32(0, bytes + offset + sizeof(header), header.length) != header.checksum) {
+            break;
+        }
+        record = [NSPropertyListSerialization propertyListWithData:[data subdataWithRange:NSMakeRange(offset + sizeof(header), header.length)]
+                                                           options:NSPropertyListMutableContainers
+                                                            format:NULL error:NULL];
+        if (![record isKindOfClass:[NSDictionary class]]) break;
+        if ([record[@"type"] isEqualToString:@"op"]) {
+            [_pending addObject:record];
+            opsByID[record[@"id"]] = record;
+        } else if ([record[@"type"] isEqualToString:@"done"]) {
+            id op = opsByID[record[@"id"]];
+            if (op) [_pending removeObjectIdenticalTo:op];
+            if (record[@"itemid"]) _postedItems[record[@"localID"]] = record;
+        }
+        offset += sizeof(header) + header.length;
+    }
+    for (NSDictionary *op in _pending) {
+        // We may have quit or crashed after sending it.
+        if ([op[@"mode"] isEqualToString:@"postevent"]) [_unconfirmedPosts addObject:op[@"id"]];
+    }
+    if (offset < length) {
+        // A record cut short by a crash was never acknowledged; drop it.
+        NSLog(@"LJOutbox: discarding %lu bytes of incomplete record in %@.",
+              (unsigned long)(length - offset), path);
+        [_fileHandle truncateFileAtOffset:offset];
+    }
+    [_fileHandle seekToEndOfFile];
+    return YES;
+}
+
+// Appends a record and waits for it to reach the disk; must be called
+// with _lock held.
+- (BOOL)_appendRecord:(NSDictionary *)record
+{
+    NSData *plist = [NSPropertyListSerialization dataWithPropertyList:record
+                                                               format:NSPropertyListBinaryFormat_v1_0
+                                                              options:0 error:NULL];
+    LJOutboxRecordHeader header;
+    NSMutableData *data;
+
+    if (plist == nil) return NO;
+    header.length = (uint32_t)[plist length];
+    header.checksum = (uint32_t)crc32(0, [plist bytes], (uInt)[plist length]);
+    data = [[NSMutableData alloc] initWithBytes:&header length:sizeof(header)];
+    [data appendData:plist];
+    @try {
+        [_fileHandle writeData:data];
+        [_fileHandle synchronizeFile];
+    } @catch (NSException *localException) {
+        NSLog(@"LJOutbox: could not write to %@: %@", [_fileURL path], [localException reason]);
+        return NO;
+    }
+    return YES;
+}
+
+// Empties the log once nothing is pending, keeping the done records of
+// recent posts.  Must be called with _lock held.
+- (void)_compactFile
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+
+    [_fileHandle truncateFileAtOffset:0];
+    for (NSString *localID in [_postedItems allKeys]) {
+        NSMutableDictionary *record = [_postedItems[localID] mutableCopy];
+        // Logs written before records were timed start the clock now.
+        if (record[@"time"] == nil) record[@"time"] = @(now);
+        if (now - [record[@"time"] doubleValue] > kPostedItemLifetime) {
+            [_postedItems removeObjectForKey:localID];
+        } else {
+            _postedItems[localID] = record;
+            if (![self _appendRecord:record]) {
+                NSLog(@"LJOutbox: could not keep the itemID of posted entry %@.", localID);
+            }
+        }
+    }
+    [_fileHandle synchronizeFile];
+}
+
+#pragma mark Queueing
+
+// Must be called with _lock held.
+- (BOOL)_hasPostForOutboxID:(NSString *)outboxID
+{
+    if (outboxID == nil) return NO;
+    if (_postedItems[outboxID]) return YES;
+    for (NSDictionary *op in _pending) {
+        if ([op[@"localID"] isEqualToString:outboxID] && [op[@"mode"] isEqualToString:@"postevent"]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (void)_enqueueOp:(NSMutableDictionary *)op entry:(LJEntry *)entry handler:(LJOutboxCompletionHandler)handler
+{
+    BOOL isWritten;
+
+    op[@"type"] = @"op";
+    op[@"id"] = LJCreateUUIDString();
+    op[@"journal"] = [[entry journal] name];
+    isWritten = [self _appendRecord:op];
+    if (isWritten) {
+        [_pending addObject:op];
+        _entryBoxes[op[@"id"]] = [LJWeakBox boxWithObject:entry];
+        if (handler) _handlers[op[@"id"]] = [handler copy];
+    }
+    [_lock unlock];
+    if (!isWritten) {
+        [[_account _exceptionWithName:@"LJOutboxWriteError"] raise];
+    }
+    [self drain];
+}
+
+- (void)enqueueSaveOfEntry:(LJEntry *)entry completionHandler:(LJOutboxCompletionHandler)handler
+{
+    NSMutableDictionary *op = [[NSMutableDictionary alloc] init];
+
+    NSAssert([entry journal] != nil, @"Must set a journal before attempting to save entry.");
+    NSAssert([[entry journal] account] == _account, @"The entry belongs to another account.");
+    [[NSNotificationCenter defaultCenter] postNotificationName:LJEntryWillSaveToJournalNotification
+                                                        object:entry];
+    op[@"parameters"] = [entry _saveRequest];
+    [_lock lock];
+    if ([entry itemID] != 0) {
+        op[@"mode"] = @"editevent";
+    } else {
+        // Until the entry is posted, later requests find its itemID by
+        // this ID.
+        if ([entry _outboxID] == nil) [entry _setOutboxID:LJCreateUUIDString()];
+        op[@"localID"] = [entry _outboxID];
+        op[@"mode"] = [self _hasPostForOutboxID:[entry _outboxID]] ? @"editevent" : @"postevent";
+    }
+    // The entry stays edited until the server accepts the save, so a
+    // refused save, or a fetch while the request waits, can't replace
+    // text the server never got.
+    [self _enqueueOp:op entry:entry handler:handler];
+}
+
+- (void)enqueueRemovalOfEntry:(LJEntry *)entry completionHandler:(LJOutboxCompletionHandler)handler
+{
+    NSMutableDictionary *op = [[NSMutableDictionary alloc] init];
+    BOOL hasPost;
+
+    // Checked before anyone is told the entry is going away.  Should the
+    // post be refused meanwhile, the removal fails when it is sent.
+    [_lock lock];
+    hasPost = ([entry itemID] != 0 || [self _hasPostForOutboxID:[entry _outboxID]]);
+    [_lock unlock];
+    if (!hasPost) {
+        [[_account _exceptionWithName:@"LJOutboxUnpostedEntryError"] raise];
+    }
+    [[NSNotificationCenter defaultCenter] postNotificationName:LJEntryWillRemoveFromJournalNotification
+                                                        object:entry];
+    op[@"parameters"] = [entry _removeRequest];
+    op[@"mode"] = @"editevent";
+    op[@"removal"] = @YES;
+    [_lock lock];
+    if ([entry itemID] == 0) op[@"localID"] = [entry _outboxID];
+    [self _enqueueOp:op entry:entry handler:handler];
+}
+
+#pragma mark Sending
+
+- (void)drain
+{
+    NSMutableArray *journalNames = [[NSMutableArray alloc] init];
+
+    [_lock lock];
+    for (NSDictionary *op in _pending) {
+        NSString *name = op[@"journal"];
+        if (![_drainingJournals containsObject:name]) {
+            [_drainingJournals addObject:name];
+            [journalNames addObject:name];
+        }
+    }
+    [_lock unlock];
+    for (NSString *name in journalNames) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [self _drainJournalNamed:name];
+        });
+    }
+}
+
+#ifdef ENABLE_REACHABILITY_MONITORING
+- (void)_serverReachabilityDidChange:(NSNotification *)notification
+{
+    SCNetworkConnectionFlags flags = [[notification userInfo][@"ConnectionFlags"] unsignedIntValue];
+
+    if ((flags & kSCNetworkFlagsReachable) && !(flags & kSCNetworkFlagsConnectionRequired)) {
+        [self drain];
+    }
+}
+#endif
+
+// Must be called with _lock held.
+- (void)_scheduleRetry
+{
+    NSTimeInterval delay;
+
+    _failureCount++;
+    if (_isRetryScheduled) return;
+    _isRetryScheduled = YES;
+    delay = MIN([self retryInterval] * pow(2, MIN(_failureCount - 1, 16)), kMaxRetryDelay);
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                   dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [_lock lock];
+        _isRetryScheduled = NO;
+        [_lock unlock];
+        [self drain];
+    });
+}
+
+/*
+ * Looks among the journal's latest entries for one saved by a post whose
+ * reply was lost.  Returns the itemid and anum, as the postevent reply
+ * would have, or nil if no entry has the post's subject, time and text.
+ */
+- (NSDictionary *)_replyForLostPost:(NSDictionary *)op
+{
+    NSDictionary *post = op[@"parameters"], *reply;
+    NSMutableDictionary *parameters = [[NSMutableDictionary alloc] init];
+    NSString *subject = post[@"subject"] ?: @"";
+    NSString *event = [(post[@"event"] ?: @"") stringByReplacingOccurrencesOfString:@"\r\n" withString:@"\n"];
+    NSString *eventTime = nil;
+    NSInteger count;
+
+    if (post[@"year"]) {
+        eventTime = [NSString stringWithFormat:@"%04d-%02d-%02d %02d:%02d",
+                     [post[@"year"] intValue], [post[@"mon"] intValue], [post[@"day"] intValue],
+                     [post[@"hour"] intValue], [post[@"min"] intValue]];
+    }
+    parameters[@"selecttype"] = @"lastn";
+    parameters[@"howmany"] = [NSString stringWithFormat:@"%lu", (unsigned long)kLostPostSearchCount];
+    parameters[@"lineendings"] = @"unix";
+    if (post[@"usejournal"]) parameters[@"usejournal"] = post[@"usejournal"];
+    reply = [_account getReplyForMode:@"getevents" parameters:parameters];
+    count = [reply[@"events_count"] integerValue];
+    for (NSInteger i = 1; i <= count; i++) {
+        NSString *prefix = [NSString stringWithFormat:@"events_%ld_", (long)i];
+
+        if (![(reply[[prefix stringByAppendingString:@"subject"]] ?: @"") isEqualToString:subject]) continue;
+        if (eventTime && ![reply[[prefix stringByAppendingString:@"eventtime"]] hasPrefix:eventTime]) continue;
+        if (![(LJURLDecodeString(reply[[prefix stringByAppendingString:@"event"]]) ?: @"") isEqualToString:event]) continue;
+        return @{@"itemid": reply[[prefix stringByAppendingString:@"itemid"]] ?: @"0",
+                 @"anum": reply[[prefix stringByAppendingString:@"anum"]] ?: @"0"};
+    }
+    return nil;
+}
+
+/*
+ * Sends the journal's requests one at a time, oldest first, until none
+ * are left or one fails for a reason which may pass.
+ *
+ * Requests for one journal are not pipelined.  An edit or removal of an
+ * entry queued for posting needs the itemID in the post's reply, and two
+ * requests for the same entry must reach the server in the order they
+ * were made, or the older one wins.  The log records neither which entry
+ * an editevent touches nor how requests depend on each other, and a
+ * request that fails in transit has to be retried before anything queued
+ * after it.  Journals don't share entries, so they drain side by side.
+ */
+- (void)_drainJournalNamed:(NSString *)name
+{
+    while (YES) {
+        NSDictionary *op = nil, *reply = nil, *posted;
+        NSMutableDictionary *parameters, *done;
+        NSException *exception = nil;
+        LJOutboxCompletionHandler handler;
+        LJEntry *entry;
+        BOOL isUnconfirmed;
+
+        [_lock lock];
+        for (NSDictionary *candidate in _pending) {
+            if ([candidate[@"journal"] isEqualToString:name]) {
+                op = candidate;
+                break;
+            }
+        }
+        if (op == nil) {
+            [_drainingJournals removeObject:name];
+            [_lock unlock];
+            return;
+        }
+        parameters = [op[@"parameters"] mutableCopy];
+        posted = op[@"localID"] ? _postedItems[op[@"localID"]] : nil;
+        isUnconfirmed = [_unconfirmedPosts containsObject:op[@"id"]];
+        [_lock unlock];
+
+        if (parameters[@"itemid"] == nil && ![op[@"mode"] isEqualToString:@"postevent"]) {
+            if (posted) {
+                parameters[@"itemid"] = posted[@"itemid"];
+            } else {
+                // The post it depended on was refused.
+                exception = [_account _exceptionWithName:@"LJOutboxUnpostedEntryError"];
+            }
+        }
+        if (exception == nil && isUnconfirmed) {
+            // The server may have saved the post before the connection
+            // dropped; sending it again would post it twice.
+            @try {
+                reply = [self _replyForLostPost:op];
+            } @catch (NSException *localException) {
+                // A refusal says nothing about the post, so send it.
+                if (![[localException name] isEqualToString:@"LJServerError"]) exception = localException;
+            }
+        }
+        if (exception == nil && reply == nil) {
+            @try {
+                reply = [_account getReplyForMode:op[@"mode"] parameters:parameters];
+            } @catch (NSException *localException) {
+                exception = localException;
+            }
+        }
+        if (exception && ![[exception name] isEqualToString:@"LJServerError"] &&
+            ![[exception name] hasPrefix:@"LJOutbox"]) {
+            // Unreachable, logged out or the like: try again later.
+            [_lock lock];
+            if ([op[@"mode"] isEqualToString:@"postevent"]) [_unconfirmedPosts addObject:op[@"id"]];
+            [_drainingJournals removeObject:name];
+            [self _scheduleRetry];
+            [_lock unlock];
+            return;
+        }
+
+        done = [[NSMutableDictionary alloc] init];
+        done[@"type"] = @"done";
+        done[@"id"] = op[@"id"];
+        if (exception == nil && [op[@"mode"] isEqualToString:@"postevent"] && op[@"localID"]) {
+            done[@"localID"] = op[@"localID"];
+            done[@"itemid"] = reply[@"itemid"] ?: @"0";
+            done[@"anum"] = reply[@"anum"] ?: @"0";
+            done[@"time"] = @(CFAbsoluteTimeGetCurrent());
+        } else if (exception == nil && posted && reply[@"itemid"] == nil) {
+            // The entry may not know its itemID yet, if it was archived
+            // while its post was queued.
+            NSMutableDictionary *fullReply = [reply mutableCopy];
+            fullReply[@"itemid"] = posted[@"itemid"];
+            fullReply[@"anum"] = posted[@"anum"];
+            reply = fullReply;
+        }
+        [_lock lock];
+        if (![self _appendRecord:done]) {
+            NSLog(@"LJOutbox: request %@ may be sent again after relaunch.", op[@"id"]);
+        }
+        if (done[@"itemid"]) _postedItems[done[@"localID"]] = done;
+        [_pending removeObjectIdenticalTo:op];
+        [_unconfirmedPosts removeObject:op[@"id"]];
+        if (exception == nil) _failureCount = 0;
+        if ([_pending count] == 0) [self _compactFile];
+        entry = [_entryBoxes[op[@"id"]] object];
+        handler = _handlers[op[@"id"]];
+        [_entryBoxes removeObjectForKey:op[@"id"]];
+        [_handlers removeObjectForKey:op[@"id"]];
+        [_lock unlock];
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self _finishOp:op entry:entry reply:reply exception:exception];
+            if (handler) handler(exception);
+        });
+    }
+}
+
+// Updates the entry, if it is still around, as saveToJournal or
+// removeFromJournal would have.
+- (void)_finishOp:(NSDictionary *)op entry:(LJEntry *)entry reply:(NSDictionary *)reply exception:(NSException *)exception
+{
+    NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+    BOOL isRemoval = [op[@"removal"] boolValue];
+
+    if (exception) {
+        NSString *name = isRemoval ? LJEntryDidNotRemoveFromJournalNotification
+                                   : LJEntryDidNotSaveToJournalNotification;
+        if (entry) [center postNotificationName:name object:entry userInfo:@{@"LJException": exception}];
+        return;
+    }
+    if (entry == nil) {
+        // The day counts can't be adjusted without the entry's dates.
+        [[_account journalNamed:op[@"journal"]] _invalidateDayCounts];
+        return;
+    }
+    if (isRemoval) {
+        if ([entry itemID] != 0) [entry _didRemoveFromJournal];
+    } else {
+        // Clean only if the entry hasn't been changed since the request was
+        // made.  The itemid is left out, as it may have been filled in by
+        // the entry's post since.
+        NSMutableDictionary *sent = [op[@"parameters"] mutableCopy];
+        NSMutableDictionary *current = [entry _saveRequest];
+        [sent removeObjectForKey:@"itemid"];
+        [current removeObjectForKey:@"itemid"];
+        [entry _didSaveWithReply:reply];
+        if ([sent isEqualToDictionary:current]) [entry setEdited:NO];
+        if ([entry itemID] != 0) [entry _setOutboxID:nil];
+    }
+}
+
+@end
@@ -0,0 +1,62 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+#import "LJRequestScheduler.h"
+#import "LJRateLimiter.h"
+
+#ifndef __private_extern
+#define __private_extern __attribute__((visibility("hidden")))
+#endif
+
+/*!
+ * Returns YES if the protocol mode only reads information from the server.
+ * Read-only requests with identical parameters are interchangeable, so the
+ * LJKit is free to share a single reply between them.
+ */
+__private_extern BOOL LJModeIsReadOnly(NSString *mode);
+
+/*!
+ * Returns a string which identifies a request by its mode and parameters.
+ * Two requests produce the same key if and only if they would send the
+ * same mode and key-value pairs, regardless of dictionary ordering.
+ */
+__private_extern NSString *LJCreateCanonicalRequestKey(NSString *mode, NSDictionary *parameters);
+
+/*!
+ * Returns the read-only modes whose replies may be out of date after the
+ * server accepts a request in the given mode, or nil if there are none.
+ * For example, an editevent can change the results of getevents,
+ * getdaycounts and getusertags for the same journal.
+ */
+__private_extern NSArray *LJModesInvalidatedByMode(NSString *mode);
+
+/*!
+ * Returns the priority class a request gets when the caller doesn't choose
+ * one.  Writes are interactive, since somebody is usually waiting on them;
+ * syncing is background work; everything else is normal.
+ */
+__private_extern LJRequestPriority LJDefaultPriorityForRequest(NSString *mode, NSDictionary *parameters);
+
+/*!
+ * Returns the class whose token bucket limits requests in the given mode.
+ */
+__private_extern LJRateLimitClass LJRateLimitClassForMode(NSString *mode);
@@ -0,0 +1,94 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJProtocolModes.h"
+#import "URLEncoding.h"
+
+BOOL LJModeIsReadOnly(NSString *mode)
+{
+    static NSSet *readOnlyModes = nil;
+    static dispatch_once_t once;
+
+    dispatch_once(&once, ^{
+        readOnlyModes = [[NSSet alloc] initWithObjects:
+            @"checkfriends", @"friendof", @"getdaycounts", @"getevents",
+            @"getfriendgroups", @"getfriends", @"getusertags", @"syncitems",
+            nil];
+    });
+    return [readOnlyModes containsObject:mode];
+}
+
+NSString *LJCreateCanonicalRequestKey(NSString *mode, NSDictionary *parameters)
+{
+    NSMutableData *data = [[NSMutableData alloc] initWithCapacity:64];
+    NSArray *keys = [[parameters allKeys] sortedArrayUsingSelector:@selector(compare:)];
+
+    // URL encoding the pairs keeps the key unambiguous, since '&' and '='
+    // can never appear unescaped inside a key or value.
+    LJAppendURLEncodingOfStringToData(mode, data);
+    for (NSString *key in keys) {
+        [data appendBytes:"&" length:1];
+        LJAppendURLEncodingOfStringToData(key, data);
+        [data appendBytes:"=" length:1];
+        LJAppendURLEncodingOfStringToData(parameters[key], data);
+    }
+    return [[NSString alloc] initWithData:data encoding:NSASCIIStringEncoding];
+}
+
+NSArray *LJModesInvalidatedByMode(NSString *mode)
+{
+    static NSDictionary *invalidatedModes = nil;
+    static dispatch_once_t once;
+
+    dispatch_once(&once, ^{
+        NSArray *journalModes = @[@"getevents", @"getdaycounts", @"getusertags", @"syncitems"];
+        NSArray *friendModes = @[@"getfriends", @"getfriendgroups", @"friendof", @"checkfriends"];
+        invalidatedModes = @{@"postevent": journalModes,
+                             @"editevent": journalModes,
+                             @"editfriends": friendModes,
+                             @"editfriendgroups": friendModes};
+    });
+    return invalidatedModes[mode];
+}
+
+LJRequestPriority LJDefaultPriorityForRequest(NSString *mode, NSDictionary *parameters)
+{
+    if ([mode isEqualToString:@"login"] || LJModesInvalidatedByMode(mode) != nil) {
+        return LJRequestPriorityInteractive;
+    }
+    if ([mode isEqualToString:@"syncitems"] ||
+        ([mode isEqualToString:@"getevents"] &&
+         [parameters[@"selecttype"] isEqualToString:@"syncitems"])) {
+        return LJRequestPriorityBackground;
+    }
+    return LJRequestPriorityNormal;
+}
+
+LJRateLimitClass LJRateLimitClassForMode(NSString *mode)
+{
+    if ([mode isEqualToString:@"checkfriends"]) {
+        return LJRateLimitClassPolling;
+    }
+    if (LJModesInvalidatedByMode(mode) != nil) {
+        return LJRateLimitClassWrite;
+    }
+    return LJRateLimitClassRead;
+}
@@ -0,0 +1,121 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*!
+ @enum LJRateLimitClass
+ @discussion
+ These constants define the classes of requests which are rate limited
+ separately.
+ */
+typedef NS_ENUM(NSInteger, LJRateLimitClass) {
+    /// Requests which read from the server, such as getevents.
+    LJRateLimitClassRead = 0,
+
+    /// Requests which change data on the server, such as postevent.
+    LJRateLimitClassWrite,
+
+    /// checkfriends polling.
+    LJRateLimitClassPolling
+};
+
+/*!
+ @class LJRateLimiter
+ @abstract Limits the rate of requests sent to one host.
+ @discussion
+ Every request LJKit sends to a host draws a token from that host's rate
+ limiter, which is shared by every account in the process.  Each class of
+ request has its own token bucket, refilled at up to a configured number of
+ requests per second.  When the bucket is empty, requests wait.
+
+ The refill rate adapts to the server.  Each HTTP 503 reply halves the rate
+ of its class and pauses the class for any Retry-After time the server gave;
+ each successful reply raises the rate a little, back towards the configured
+ maximum.  For polling, the rate is also capped at what the intervals
+ suggested in checkfriends replies add up to across all polling accounts.
+ */
+@interface LJRateLimiter : NSObject
+
+/*!
+ @method rateLimiterForHost:
+ @abstract Returns the rate limiter for the named host, creating it if needed.
+ */
++ (LJRateLimiter *)rateLimiterForHost:(NSString *)host;
+
+/*!
+ @property host
+ @abstract The host whose requests the receiver limits.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, copy) NSString *host;
+
+/*!
+ @method maximumRateForClass:
+ @abstract The most requests per second a class may send.
+ */
+- (double)maximumRateForClass:(LJRateLimitClass)rateClass;
+
+/*!
+ @method setMaximumRate:forClass:
+ @abstract Sets the most requests per second a class may send.
+ @discussion
+ The defaults are 10 per second for reads, 5 for writes and 2 for polling.
+ */
+- (void)setMaximumRate:(double)requestsPerSecond forClass:(LJRateLimitClass)rateClass;
+
+/*!
+ @method burstSizeForClass:
+ @abstract The number of requests a class may send at once after being idle.
+ */
+- (NSUInteger)burstSizeForClass:(LJRateLimitClass)rateClass;
+
+/*!
+ @method setBurstSize:forClass:
+ @abstract Sets the number of requests a class may send at once after being idle.
+ */
+- (void)setBurstSize:(NSUInteger)burstSize forClass:(LJRateLimitClass)rateClass;
+
+/*!
+ @method currentRateForClass:
+ @abstract The rate, in requests per second, a class is currently held to.
+ @discussion
+ This is at most the maximum rate, and lower after the server has
+ reported that it is busy.
+ */
+- (double)currentRateForClass:(LJRateLimitClass)rateClass;
+
+/*!
+ @property serverBusyCount
+ @abstract The number of HTTP 503 replies received from the host.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger serverBusyCount;
+
+/*!
+ @property delayedRequestCount
+ @abstract The number of requests which had to wait for a token.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger delayedRequestCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
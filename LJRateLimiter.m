@@ -0,0 +1,311 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJRateLimiter_Private.h"
+
+#define RATE_CLASS_COUNT (LJRateLimitClassPolling + 1)
+#define MINIMUM_RATE 0.05           // one request every twenty seconds
+#define ADDITIVE_INCREASE 0.05      // requests per second, per success
+#define MULTIPLICATIVE_DECREASE 0.5
+
+/*
+ * The token bucket for one class.  Requests reserve a token even if the
+ * bucket is empty, driving it negative; the deficit divided by the rate is
+ * how long the reserving request must wait.  This serves waiters in order
+ * without having to wake them all each time a token is added.
+ */
+@interface LJTokenBucket : NSObject
+{
+@public
+    double _tokens;
+    double _burstSize;
+    double _rate;
+    double _maximumRate;
+    CFAbsoluteTime _lastRefillTime;
+    CFAbsoluteTime _pausedUntil;
+}
+@end
+
+@implementation LJTokenBucket
+
+- (void)refillAtTime:(CFAbsoluteTime)now
+{
+    if (now > _lastRefillTime) {
+        _tokens = MIN(_burstSize, _tokens + (now - _lastRefillTime) * _rate);
+        _lastRefillTime = now;
+    }
+}
+
+@end
+
+/*
+ * The most recent interval the server suggested to one polling client.
+ */
+@interface LJPollingInterval : NSObject
+{
+@public
+    NSTimeInterval _interval;
+    CFAbsoluteTime _time;
+}
+@end
+
+@implementation LJPollingInterval
+@end
+
+@implementation LJRateLimiter
+{
+@private
+    NSLock *_lock;
+    NSArray *_buckets;
+    NSMutableDictionary *_pollingIntervals;
+    NSUInteger _serverBusyCount;
+    NSUInteger _delayedRequestCount;
+}
+
++ (LJRateLimiter *)rateLimiterForHost:(NSString *)host
+{
+    static NSMutableDictionary *limiters = nil;
+    static NSLock *lock = nil;
+    static dispatch_once_t once;
+    LJRateLimiter *limiter;
+    NSString *key = [host lowercaseString];
+
+    dispatch_once(&once, ^{
+        limiters = [[NSMutableDictionary alloc] init];
+        lock = [[NSLock alloc] init];
+    });
+    [lock lock];
+    limiter = limiters[key];
+    if (limiter == nil) {
+        limiter = [[self alloc] _initWithHost:key];
+        limiters[key] = limiter;
+    }
+    [lock unlock];
+    return limiter;
+}
+
+- (instancetype)_initWithHost:(NSString *)host
+{
+    self = [super init];
+    if (self) {
+        static const double defaultRates[RATE_CLASS_COUNT] = { 10, 5, 2 };
+        static const double defaultBursts[RATE_CLASS_COUNT] = { 10, 5, 5 };
+        NSMutableArray *buckets = [[NSMutableArray alloc] initWithCapacity:RATE_CLASS_COUNT];
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        NSInteger c;
+
+        _host = [host copy];
+        _lock = [[NSLock alloc] init];
+        for (c = 0; c < RATE_CLASS_COUNT; c++) {
+            LJTokenBucket *bucket = [[LJTokenBucket alloc] init];
+            bucket->_maximumRate = defaultRates[c];
+            bucket->_rate = defaultRates[c];
+            bucket->_burstSize = defaultBursts[c];
+            bucket->_tokens = defaultBursts[c];
+            bucket->_lastRefillTime = now;
+            [buckets addObject:bucket];
+        }
+        _buckets = [buckets copy];
+        _pollingIntervals = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (LJTokenBucket *)_bucketForClass:(LJRateLimitClass)rateClass
+{
+    if (rateClass < 0) rateClass = 0;
+    if (rateClass >= RATE_CLASS_COUNT) rateClass = RATE_CLASS_COUNT - 1;
+    return _buckets[rateClass];
+}
+
+- (double)maximumRateForClass:(LJRateLimitClass)rateClass
+{
+    double rate;
+
+    [_lock lock];
+    rate = [self _bucketForClass:rateClass]->_maximumRate;
+    [_lock unlock];
+    return rate;
+}
+
+- (void)setMaximumRate:(double)requestsPerSecond forClass:(LJRateLimitClass)rateClass
+{
+    LJTokenBucket *bucket;
+
+    [_lock lock];
+    bucket = [self _bucketForClass:rateClass];
+    [bucket refillAtTime:CFAbsoluteTimeGetCurrent()];
+    bucket->_maximumRate = MAX(requestsPerSecond, MINIMUM_RATE);
+    bucket->_rate = MIN(bucket->_rate, bucket->_maximumRate);
+    [_lock unlock];
+}
+
+- (NSUInteger)burstSizeForClass:(LJRateLimitClass)rateClass
+{
+    NSUInteger size;
+
+    [_lock lock];
+    size = (NSUInteger)[self _bucketForClass:rateClass]->_burstSize;
+    [_lock unlock];
+    return size;
+}
+
+- (void)setBurstSize:(NSUInteger)burstSize forClass:(LJRateLimitClass)rateClass
+{
+    LJTokenBucket *bucket;
+
+    [_lock lock];
+    bucket = [self _bucketForClass:rateClass];
+    [bucket refillAtTime:CFAbsoluteTimeGetCurrent()];
+    bucket->_burstSize = MAX(burstSize, 1);
+    bucket->_tokens = MIN(bucket->_tokens, bucket->_burstSize);
+    [_lock unlock];
+}
+
+- (double)currentRateForClass:(LJRateLimitClass)rateClass
+{
+    double rate;
+
+    [_lock lock];
+    rate = [self _bucketForClass:rateClass]->_rate;
+    [_lock unlock];
+    return rate;
+}
+
+- (NSUInteger)serverBusyCount
+{
+    NSUInteger count;
+
+    [_lock lock];
+    count = _serverBusyCount;
+    [_lock unlock];
+    return count;
+}
+
+- (NSUInteger)delayedRequestCount
+{
+    NSUInteger count;
+
+    [_lock lock];
+    count = _delayedRequestCount;
+    [_lock unlock];
+    return count;
+}
+
+- (void)_waitForTokenForClass:(LJRateLimitClass)rateClass
+{
+    LJTokenBucket *bucket;
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    NSTimeInterval delay;
+
+    [_lock lock];
+    bucket = [self _bucketForClass:rateClass];
+    [bucket refillAtTime:now];
+    bucket->_tokens -= 1;
+    delay = MAX((bucket->_tokens < 0) ? (-bucket->_tokens / bucket->_rate) : 0,
+                bucket->_pausedUntil - now);
+    if (delay > 0) _delayedRequestCount++;
+    [_lock unlock];
+    if (delay > 0) [NSThread sleepForTimeInterval:delay];
+}
+
+- (void)_noteSuccessForClass:(LJRateLimitClass)rateClass
+{
+    LJTokenBucket *bucket;
+
+    [_lock lock];
+    bucket = [self _bucketForClass:rateClass];
+    [bucket refillAtTime:CFAbsoluteTimeGetCurrent()];
+    bucket->_rate = MIN(bucket->_rate + ADDITIVE_INCREASE, bucket->_maximumRate);
+    if (rateClass == LJRateLimitClassPolling) {
+        [self _capPollingRate:bucket];
+    }
+    [_lock unlock];
+}
+
+- (void)_noteServerBusyForClass:(LJRateLimitClass)rateClass retryAfter:(NSTimeInterval)seconds
+{
+    LJTokenBucket *bucket;
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+
+    [_lock lock];
+    _serverBusyCount++;
+    bucket = [self _bucketForClass:rateClass];
+    [bucket refillAtTime:now];
+    bucket->_rate = MAX(bucket->_rate * MULTIPLICATIVE_DECREASE, MINIMUM_RATE);
+    if (seconds > 0) {
+        bucket->_pausedUntil = MAX(bucket->_pausedUntil, now + seconds);
+    }
+    [_lock unlock];
+}
+
+/*
+ * The server tells each polling client how long to wait before its next
+ * check.  Together the clients can poll at the sum of their individual
+ * rates; hold the polling bucket to that.  Must be called with the lock held.
+ */
+- (void)_capPollingRate:(LJTokenBucket *)bucket
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    double aggregateRate = 0;
+
+    if ([_pollingIntervals count] == 0) return;
+    for (NSValue *client in [_pollingIntervals allKeys]) {
+        LJPollingInterval *entry = _pollingIntervals[client];
+        // A client which hasn't polled for two intervals has stopped.
+        if (now - entry->_time > 2 * entry->_interval) {
+            [_pollingIntervals removeObjectForKey:client];
+        } else {
+            aggregateRate += 1.0 / entry->_interval;
+        }
+    }
+    if (aggregateRate > 0) {
+        bucket->_rate = MAX(MIN(bucket->_rate, aggregateRate), MINIMUM_RATE);
+    }
+}
+
+- (void)_notePollingInterval:(NSTimeInterval)seconds forClient:(id)client
+{
+    NSValue *key = [NSValue valueWithPointer:(__bridge const void *)client];
+    LJPollingInterval *entry;
+
+    if (seconds <= 0) return;
+    [_lock lock];
+    entry = _pollingIntervals[key];
+    if (entry == nil) {
+        entry = [[LJPollingInterval alloc] init];
+        _pollingIntervals[key] = entry;
+    }
+    entry->_interval = seconds;
+    entry->_time = CFAbsoluteTimeGetCurrent();
+    [self _capPollingRate:[self _bucketForClass:LJRateLimitClassPolling]];
+    [_lock unlock];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"LJRateLimiter for %@: read %.2f/s, write %.2f/s, polling %.2f/s",
+            _host, [self currentRateForClass:LJRateLimitClassRead],
+            [self currentRateForClass:LJRateLimitClassWrite],
+            [self currentRateForClass:LJRateLimitClassPolling]];
+}
+
+@end
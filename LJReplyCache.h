@@ -0,0 +1,121 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*!
+ @class LJReplyCache
+ @abstract Caches server replies to read-only protocol modes.
+ @discussion
+ Every LJAccount owns an LJReplyCache.  Replies to read-only modes such as
+ getdaycounts, getusertags and getfriends are kept for a per-mode time to
+ live, so repeated identical requests are answered without contacting the
+ server.  getevents replies are only cached when entries were requested
+ by itemID (selecttype=one or selecttype=multiple).
+
+ Replies are held in memory up to memoryCapacity bytes, and optionally
+ written to a directory on disk so they survive between launches.
+
+ The account removes stale replies by itself after it sends a request which
+ changes the server's data: posting, editing or deleting an entry clears the
+ cached entries, day counts and tags of that journal, and uploading friends
+ clears the cached friends, groups and friend-of lists.
+ */
+@interface LJReplyCache : NSObject
+
+/*!
+ @method init
+ @abstract Initializes a cache with the default time to live for each mode.
+ */
+- (instancetype)init NS_DESIGNATED_INITIALIZER;
+
+/*!
+ @property memoryCapacity
+ @abstract The approximate number of bytes of replies kept in memory.
+ @discussion
+ When the limit is exceeded, replies are discarded from memory.  Replies
+ saved to disk are unaffected.  The default is 1 MB.
+ */
+@property (NS_NONATOMIC_IOSONLY) NSUInteger memoryCapacity;
+
+/*!
+ @property diskDirectoryURL
+ @abstract The directory in which replies are saved, or nil.
+ @discussion
+ If nil (the default), replies are only cached in memory.  The directory is
+ created if necessary.  Each account should be given its own directory.
+ */
+@property (NS_NONATOMIC_IOSONLY, copy, nullable) NSURL *diskDirectoryURL;
+
+/*!
+ @method timeToLiveForMode:
+ @abstract Returns how long replies to mode are cached, in seconds.
+ @discussion
+ Returns zero if replies to mode are not cached.
+ */
+- (NSTimeInterval)timeToLiveForMode:(NSString *)mode;
+
+/*!
+ @method setTimeToLive:forMode:
+ @abstract Sets how long replies to mode are cached, in seconds.
+ @discussion
+ Set the time to live to zero to stop caching mode.  Only read-only modes
+ may be cached; setting a time to live for any other mode has no effect.
+ */
+- (void)setTimeToLive:(NSTimeInterval)seconds forMode:(NSString *)mode;
+
+/*!
+ @property hitCount
+ @abstract The number of requests answered from the cache.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger hitCount;
+
+/*!
+ @property missCount
+ @abstract The number of cacheable requests which had to go to the server.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger missCount;
+
+/*!
+ @method resetCounts
+ @abstract Sets hitCount and missCount back to zero.
+ */
+- (void)resetCounts;
+
+/*!
+ @method removeRepliesForMode:journalName:
+ @abstract Discards cached replies to mode.
+ @param mode The protocol mode.
+ @param journalName The journal the replies were about, or nil for all.
+ */
+- (void)removeRepliesForMode:(NSString *)mode journalName:(nullable NSString *)journalName;
+
+/*!
+ @method removeAllReplies
+ @abstract Discards every cached reply, in memory and on disk.
+ */
+- (void)removeAllReplies;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,380 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJReplyCache_Private.h"
+#import "LJProtocolModes.h"
+#import "Miscellaneous.h"
+
+#define DEFAULT_MEMORY_CAPACITY (1024 * 1024)
+
+/*
+ * A reply together with the times it was stored and expires.
+ */
+@interface LJReplyCacheItem : NSObject
+{
+@public
+    NSDictionary *_reply;
+    NSString *_mode;
+    // The mode and journal the reply belongs to, for invalidation.
+    NSString *_scope;
+    CFAbsoluteTime _storeTime;
+    CFAbsoluteTime _expireTime;
+}
+@end
+
+@implementation LJReplyCacheItem
+@end
+
+/*
+ * Estimates the number of bytes occupied by a reply, for the memory budget.
+ * Replies are flat dictionaries of strings; the constant roughly accounts
+ * for the per-object overhead of each pair.
+ */
+static NSUInteger LJEstimateReplyCost(NSDictionary *reply)
+{
+    NSUInteger cost = 0;
+
+    for (NSString *key in reply) {
+        cost += [key length] + [reply[key] length] + 48;
+    }
+    return cost;
+}
+
+/*
+ * Replies are indexed by mode and journal so they can be found again for
+ * invalidation.  Journal names never contain spaces.
+ */
+static NSString *LJScopeForModeAndJournal(NSString *mode, NSString *journalName)
+{
+    return [[mode stringByAppendingString:@" "] stringByAppendingString:journalName];
+}
+
+@implementation LJReplyCache
+{
+@private
+    NSLock *_lock;
+    NSCache *_memoryCache;
+    NSMutableDictionary *_timesToLive;
+    NSMutableDictionary *_keysByScope;
+    NSMutableDictionary *_invalidationTimes;
+    CFAbsoluteTime _clearTime;
+    NSUInteger _hitCount;
+    NSUInteger _missCount;
+    NSURL *_diskDirectoryURL;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _lock = [[NSLock alloc] init];
+        _memoryCache = [[NSCache alloc] init];
+        [_memoryCache setTotalCostLimit:DEFAULT_MEMORY_CAPACITY];
+        _timesToLive = [@{@"getdaycounts": @300.0,
+                          @"getusertags": @600.0,
+                          @"getfriends": @300.0,
+                          @"getfriendgroups": @300.0,
+                          @"friendof": @300.0,
+                          @"getevents": @60.0} mutableCopy];
+        _keysByScope = [[NSMutableDictionary alloc] init];
+        _invalidationTimes = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (NSUInteger)memoryCapacity
+{
+    return [_memoryCache totalCostLimit];
+}
+
+- (void)setMemoryCapacity:(NSUInteger)capacity
+{
+    [_memoryCache setTotalCostLimit:capacity];
+}
+
+- (NSURL *)diskDirectoryURL
+{
+    NSURL *url;
+
+    [_lock lock];
+    url = _diskDirectoryURL;
+    [_lock unlock];
+    return url;
+}
+
+- (void)setDiskDirectoryURL:(NSURL *)url
+{
+    if (url) {
+        [[NSFileManager defaultManager] createDirectoryAtURL:url
+                                 withIntermediateDirectories:YES
+                                                  attributes:nil error:NULL];
+    }
+    [_lock lock];
+    _diskDirectoryURL = [url copy];
+    [_lock unlock];
+}
+
+- (NSTimeInterval)timeToLiveForMode:(NSString *)mode
+{
+    NSTimeInterval seconds;
+
+    [_lock lock];
+    seconds = [_timesToLive[mode] doubleValue];
+    [_lock unlock];
+    return seconds;
+}
+
+- (void)setTimeToLive:(NSTimeInterval)seconds forMode:(NSString *)mode
+{
+    if (!LJModeIsReadOnly(mode)) return;
+    [_lock lock];
+    if (seconds > 0) {
+        _timesToLive[mode] = @(seconds);
+    } else {
+        [_timesToLive removeObjectForKey:mode];
+    }
+    [_lock unlock];
+}
+
+- (NSUInteger)hitCount
+{
+    NSUInteger count;
+
+    [_lock lock];
+    count = _hitCount;
+    [_lock unlock];
+    return count;
+}
+
+- (NSUInteger)missCount
+{
+    NSUInteger count;
+
+    [_lock lock];
+    count = _missCount;
+    [_lock unlock];
+    return count;
+}
+
+- (void)resetCounts
+{
+    [_lock lock];
+    _hitCount = 0;
+    _missCount = 0;
+    [_lock unlock];
+}
+
+- (NSURL *)_fileURLForKey:(NSString *)key directory:(NSURL *)directory
+{
+    NSString *name = [MD5HexDigest(key) stringByAppendingPathExtension:@"plist"];
+    return [directory URLByAppendingPathComponent:name];
+}
+
+- (BOOL)_canCacheMode:(NSString *)mode parameters:(NSDictionary *)parameters
+{
+    if ([self timeToLiveForMode:mode] <= 0) return NO;
+    // Only lookups by itemID are stable enough to cache; "lastn" and
+    // "day" results shift whenever anything is posted.
+    if ([mode isEqualToString:@"getevents"]) {
+        NSString *selectType = parameters[@"selecttype"];
+        return ([selectType isEqualToString:@"one"] ||
+                [selectType isEqualToString:@"multiple"]);
+    }
+    return YES;
+}
+
+- (LJReplyCacheItem *)_diskItemForKey:(NSString *)key directory:(NSURL *)directory
+{
+    NSData *data;
+    NSDictionary *plist;
+    LJReplyCacheItem *item;
+
+    data = [NSData dataWithContentsOfURL:[self _fileURLForKey:key directory:directory]];
+    if (data == nil) return nil;
+    plist = [NSPropertyListSerialization propertyListWithData:data options:0
+                                                       format:NULL error:NULL];
+    if (![plist isKindOfClass:[NSDictionary class]]) return nil;
+    // Hash collisions are astronomically unlikely, but cheap to rule out.
+    if (![plist[@"Key"] isEqualToString:key]) return nil;
+    item = [[LJReplyCacheItem alloc] init];
+    item->_reply = plist[@"Reply"];
+    item->_mode = plist[@"Mode"];
+    item->_scope = LJScopeForModeAndJournal(item->_mode, plist[@"Journal"]);
+    item->_storeTime = [plist[@"StoreTime"] doubleValue];
+    item->_expireTime = [plist[@"ExpireTime"] doubleValue];
+    if (![item->_reply isKindOfClass:[NSDictionary class]]) return nil;
+    return item;
+}
+
+/*
+ * Puts an item in the memory cache and records its key under its scope,
+ * so removeRepliesForMode:journalName: finds it.  Refuses an item stored
+ * before a later invalidation of its scope, which for a disk item may
+ * have been made by a previous run which has since forgotten the key.
+ * Must be called with _lock held; inserting under the lock means an
+ * invalidation either sees the key or is seen by the test.
+ */
+- (BOOL)_cacheItem:(LJReplyCacheItem *)item forKey:(NSString *)key
+{
+    CFAbsoluteTime invalidTime;
+    NSMutableSet *keys;
+
+    invalidTime = MAX(_clearTime,
+                      MAX([_invalidationTimes[item->_mode] doubleValue],
+                          [_invalidationTimes[item->_scope] doubleValue]));
+    if (item->_storeTime <= invalidTime) return NO;
+    [_memoryCache setObject:item forKey:key cost:LJEstimateReplyCost(item->_reply)];
+    keys = _keysByScope[item->_scope];
+    if (keys == nil) {
+        keys = [[NSMutableSet alloc] init];
+        _keysByScope[item->_scope] = keys;
+    }
+    [keys addObject:key];
+    return YES;
+}
+
+- (NSDictionary *)_replyForKey:(NSString *)key
+{
+    LJReplyCacheItem *item = [_memoryCache objectForKey:key];
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    NSURL *directory = [self diskDirectoryURL];
+
+    if (item == nil && directory) {
+        item = [self _diskItemForKey:key directory:directory];
+        if (item && item->_expireTime > now) {
+            [_lock lock];
+            if (![self _cacheItem:item forKey:key]) item = nil;
+            [_lock unlock];
+        }
+    }
+    if (item && item->_expireTime <= now) {
+        [_memoryCache removeObjectForKey:key];
+        item = nil;
+    }
+    [_lock lock];
+    if (item) _hitCount++; else _missCount++;
+    [_lock unlock];
+    return item ? item->_reply : nil;
+}
+
+- (void)_setReply:(NSDictionary *)reply forKey:(NSString *)key
+             mode:(NSString *)mode journalName:(NSString *)journalName
+      requestTime:(CFAbsoluteTime)requestTime
+{
+    LJReplyCacheItem *item = [[LJReplyCacheItem alloc] init];
+    NSURL *directory;
+
+    // The item is stamped with the request time, not the arrival time, so
+    // the disk path's check against later invalidations holds too.
+    item->_reply = [reply copy];
+    item->_mode = mode;
+    item->_scope = LJScopeForModeAndJournal(mode, journalName);
+    item->_storeTime = requestTime;
+    item->_expireTime = CFAbsoluteTimeGetCurrent() + [self timeToLiveForMode:mode];
+    [_lock lock];
+    // A write which ran while the request was in flight may have made the
+    // reply stale.
+    if (![self _cacheItem:item forKey:key]) {
+        [_lock unlock];
+        return;
+    }
+    directory = _diskDirectoryURL;
+    [_lock unlock];
+    if (directory) {
+        NSDictionary *plist = @{@"Key": key,
+                                @"Mode": mode,
+                                @"Journal": journalName,
+                                @"StoreTime": @(item->_storeTime),
+                                @"ExpireTime": @(item->_expireTime),
+                                @"Reply": item->_reply};
+        NSData *data = [NSPropertyListSerialization dataWithPropertyList:plist
+                                                                  format:NSPropertyListBinaryFormat_v1_0
+                                                                 options:0 error:NULL];
+        [data writeToURL:[self _fileURLForKey:key directory:directory] atomically:YES];
+    }
+}
+
+- (void)removeRepliesForMode:(NSString *)mode journalName:(NSString *)journalName
+{
+    NSMutableArray *doomedKeys = [[NSMutableArray alloc] init];
+    NSNumber *now = @(CFAbsoluteTimeGetCurrent());
+    NSURL *directory;
+
+    [_lock lock];
+    if (journalName) {
+        NSString *scope = LJScopeForModeAndJournal(mode, journalName);
+        NSSet *keys = _keysByScope[scope];
+        if (keys) [doomedKeys addObjectsFromArray:[keys allObjects]];
+        [_keysByScope removeObjectForKey:scope];
+        _invalidationTimes[scope] = now;
+    } else {
+        NSString *prefix = [mode stringByAppendingString:@" "];
+        for (NSString *scope in [_keysByScope allKeys]) {
+            if ([scope hasPrefix:prefix]) {
+                [doomedKeys addObjectsFromArray:[_keysByScope[scope] allObjects]];
+                [_keysByScope removeObjectForKey:scope];
+            }
+        }
+        _invalidationTimes[mode] = now;
+    }
+    directory = _diskDirectoryURL;
+    [_lock unlock];
+    for (NSString *key in doomedKeys) {
+        [_memoryCache removeObjectForKey:key];
+        if (directory) {
+            [[NSFileManager defaultManager] removeItemAtURL:[self _fileURLForKey:key directory:directory]
+                                                      error:NULL];
+        }
+    }
+}
+
+- (void)_removeRepliesInvalidatedByMode:(NSString *)mode journalName:(NSString *)journalName
+{
+    for (NSString *staleMode in LJModesInvalidatedByMode(mode)) {
+        [self removeRepliesForMode:staleMode journalName:journalName];
+    }
+}
+
+- (void)removeAllReplies
+{
+    NSFileManager *manager = [NSFileManager defaultManager];
+    NSURL *directory;
+    NSArray *contents;
+
+    [_lock lock];
+    [_keysByScope removeAllObjects];
+    [_invalidationTimes removeAllObjects];
+    _clearTime = CFAbsoluteTimeGetCurrent();
+    directory = _diskDirectoryURL;
+    [_lock unlock];
+    [_memoryCache removeAllObjects];
+    if (directory) {
+        contents = [manager contentsOfDirectoryAtURL:directory includingPropertiesForKeys:nil
+                                             options:0 error:NULL];
+        for (NSURL *url in contents) {
+            if ([[url pathExtension] isEqualToString:@"plist"]) {
+                [manager removeItemAtURL:url error:NULL];
+            }
+        }
+    }
+}
+
+@end
@@ -0,0 +1,121 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*!
+ @enum LJRequestPriority
+ @discussion
+ These constants define the priority classes used to order requests waiting
+ for a connection to the server.  A waiting request is never started while a
+ request of a higher priority class is waiting for the same host.
+ */
+typedef NS_ENUM(NSInteger, LJRequestPriority) {
+    /// A request the user is waiting on, such as saving an entry.
+    LJRequestPriorityInteractive = 0,
+
+    /// The default for most requests.
+    LJRequestPriorityNormal,
+
+    /// Bulk work which can wait, such as syncing a journal's history.
+    LJRequestPriorityBackground
+};
+
+/*!
+ @class LJRequestScheduler
+ @abstract Orders and limits the requests sent to one host.
+ @discussion
+ Every request LJKit sends passes through the scheduler for its server's host,
+ which is shared by all accounts on that host.  At most maxConcurrentRequests
+ requests are in flight at once; the rest wait.  When a connection becomes
+ free it goes to the highest priority class with a request waiting, and
+ within that class accounts take turns, so one busy account cannot keep the
+ others waiting.
+ */
+@interface LJRequestScheduler : NSObject
+
+/*!
+ @method schedulerForHost:
+ @abstract Returns the scheduler for the named host, creating it if needed.
+ */
++ (LJRequestScheduler *)schedulerForHost:(NSString *)host;
+
+/*!
+ @property host
+ @abstract The host whose requests the receiver schedules.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly, copy) NSString *host;
+
+/*!
+ @property maxConcurrentRequests
+ @abstract The maximum number of requests in flight to the host at once.
+ @discussion
+ The default is 4.  Setting a value of zero is treated as 1.
+ */
+@property (NS_NONATOMIC_IOSONLY) NSUInteger maxConcurrentRequests;
+
+/*!
+ @property activeRequestCount
+ @abstract The number of requests currently in flight.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger activeRequestCount;
+
+/*!
+ @property queueDepth
+ @abstract The number of requests waiting, in all priority classes.
+ */
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger queueDepth;
+
+/*!
+ @method queueDepthForPriority:
+ @abstract The number of requests waiting in a priority class.
+ */
+- (NSUInteger)queueDepthForPriority:(LJRequestPriority)priority;
+
+/*!
+ @method startedRequestCountForPriority:
+ @abstract The number of requests of a priority class started so far.
+ */
+- (NSUInteger)startedRequestCountForPriority:(LJRequestPriority)priority;
+
+/*!
+ @method averageWaitTimeForPriority:
+ @abstract The mean time, in seconds, requests of a priority class waited.
+ */
+- (NSTimeInterval)averageWaitTimeForPriority:(LJRequestPriority)priority;
+
+/*!
+ @method maximumWaitTimeForPriority:
+ @abstract The longest time, in seconds, a request of a priority class waited.
+ */
+- (NSTimeInterval)maximumWaitTimeForPriority:(LJRequestPriority)priority;
+
+/*!
+ @method resetStatistics
+ @abstract Sets the started counts and wait times back to zero.
+ */
+- (void)resetStatistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,310 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJRequestScheduler_Private.h"
+
+#define PRIORITY_COUNT (LJRequestPriorityBackground + 1)
+#define DEFAULT_MAX_CONCURRENT_REQUESTS 4
+
+/*
+ * A request waiting for its turn.
+ */
+@interface LJSchedulerWaiter : NSObject
+{
+@public
+    CFAbsoluteTime _enqueueTime;
+    BOOL _isGranted;
+}
+@end
+
+@implementation LJSchedulerWaiter
+@end
+
+/*
+ * The waiting requests and statistics for one priority class.  Each client
+ * has its own FIFO; clientOrder lists the clients with requests waiting in
+ * the order they will next be served.
+ */
+@interface LJSchedulerQueue : NSObject
+{
+@public
+    NSMutableArray *_clientOrder;
+    NSMutableDictionary *_waitersByClient;
+    NSUInteger _depth;
+    NSUInteger _startCount;
+    NSTimeInterval _totalWait;
+    NSTimeInterval _maxWait;
+}
+@end
+
+@implementation LJSchedulerQueue
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _clientOrder = [[NSMutableArray alloc] init];
+        _waitersByClient = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (void)recordWait:(NSTimeInterval)wait
+{
+    _startCount++;
+    _totalWait += wait;
+    if (wait > _maxWait) _maxWait = wait;
+}
+
+@end
+
+@implementation LJRequestScheduler
+{
+@private
+    NSCondition *_condition;
+    NSArray *_queues;
+    NSUInteger _maxConcurrentRequests;
+    NSUInteger _activeRequestCount;
+}
+
++ (LJRequestScheduler *)schedulerForHost:(NSString *)host
+{
+    static NSMutableDictionary *schedulers = nil;
+    static NSLock *lock = nil;
+    static dispatch_once_t once;
+    LJRequestScheduler *scheduler;
+    NSString *key = [host lowercaseString];
+
+    dispatch_once(&once, ^{
+        schedulers = [[NSMutableDictionary alloc] init];
+        lock = [[NSLock alloc] init];
+    });
+    [lock lock];
+    scheduler = schedulers[key];
+    if (scheduler == nil) {
+        scheduler = [[self alloc] _initWithHost:key];
+        schedulers[key] = scheduler;
+    }
+    [lock unlock];
+    return scheduler;
+}
+
+- (instancetype)_initWithHost:(NSString *)host
+{
+    self = [super init];
+    if (self) {
+        NSMutableArray *queues = [[NSMutableArray alloc] initWithCapacity:PRIORITY_COUNT];
+        NSInteger p;
+
+        _host = [host copy];
+        _condition = [[NSCondition alloc] init];
+        for (p = 0; p < PRIORITY_COUNT; p++) {
+            [queues addObject:[[LJSchedulerQueue alloc] init]];
+        }
+        _queues = [queues copy];
+        _maxConcurrentRequests = DEFAULT_MAX_CONCURRENT_REQUESTS;
+    }
+    return self;
+}
+
+- (LJSchedulerQueue *)_queueForPriority:(LJRequestPriority)priority
+{
+    if (priority < 0) priority = 0;
+    if (priority >= PRIORITY_COUNT) priority = PRIORITY_COUNT - 1;
+    return _queues[priority];
+}
+
+- (NSUInteger)maxConcurrentRequests
+{
+    NSUInteger count;
+
+    [_condition lock];
+    count = _maxConcurrentRequests;
+    [_condition unlock];
+    return count;
+}
+
+- (void)setMaxConcurrentRequests:(NSUInteger)count
+{
+    [_condition lock];
+    _maxConcurrentRequests = MAX(count, 1);
+    [self _grantWaitingRequests];
+    [_condition unlock];
+}
+
+- (NSUInteger)activeRequestCount
+{
+    NSUInteger count;
+
+    [_condition lock];
+    count = _activeRequestCount;
+    [_condition unlock];
+    return count;
+}
+
+- (NSUInteger)queueDepth
+{
+    NSUInteger depth = 0;
+
+    [_condition lock];
+    for (LJSchedulerQueue *queue in _queues) {
+        depth += queue->_depth;
+    }
+    [_condition unlock];
+    return depth;
+}
+
+- (NSUInteger)queueDepthForPriority:(LJRequestPriority)priority
+{
+    NSUInteger depth;
+
+    [_condition lock];
+    depth = [self _queueForPriority:priority]->_depth;
+    [_condition unlock];
+    return depth;
+}
+
+- (NSUInteger)startedRequestCountForPriority:(LJRequestPriority)priority
+{
+    NSUInteger count;
+
+    [_condition lock];
+    count = [self _queueForPriority:priority]->_startCount;
+    [_condition unlock];
+    return count;
+}
+
+- (NSTimeInterval)averageWaitTimeForPriority:(LJRequestPriority)priority
+{
+    LJSchedulerQueue *queue;
+    NSTimeInterval average;
+
+    [_condition lock];
+    queue = [self _queueForPriority:priority];
+    average = (queue->_startCount > 0) ? (queue->_totalWait / queue->_startCount) : 0;
+    [_condition unlock];
+    return average;
+}
+
+- (NSTimeInterval)maximumWaitTimeForPriority:(LJRequestPriority)priority
+{
+    NSTimeInterval wait;
+
+    [_condition lock];
+    wait = [self _queueForPriority:priority]->_maxWait;
+    [_condition unlock];
+    return wait;
+}
+
+- (void)resetStatistics
+{
+    [_condition lock];
+    for (LJSchedulerQueue *queue in _queues) {
+        queue->_startCount = 0;
+        queue->_totalWait = 0;
+        queue->_maxWait = 0;
+    }
+    [_condition unlock];
+}
+
+/*
+ * Hands free connections to waiting requests, highest priority class first
+ * and round-robin between clients within a class.  Must be called with the
+ * condition locked.
+ */
+- (void)_grantWaitingRequests
+{
+    BOOL didGrant = NO;
+
+    while (_activeRequestCount < _maxConcurrentRequests) {
+        LJSchedulerQueue *queue = nil;
+        NSMutableArray *waiters;
+        LJSchedulerWaiter *waiter;
+        id client;
+
+        for (LJSchedulerQueue *q in _queues) {
+            if (q->_depth > 0) {
+                queue = q;
+                break;
+            }
+        }
+        if (queue == nil) break;
+        client = queue->_clientOrder[0];
+        [queue->_clientOrder removeObjectAtIndex:0];
+        waiters = queue->_waitersByClient[client];
+        waiter = waiters[0];
+        [waiters removeObjectAtIndex:0];
+        if ([waiters count] > 0) {
+            // Send the client to the back of the line.
+            [queue->_clientOrder addObject:client];
+        } else {
+            [queue->_waitersByClient removeObjectForKey:client];
+        }
+        queue->_depth--;
+        [queue recordWait:(CFAbsoluteTimeGetCurrent() - waiter->_enqueueTime)];
+        waiter->_isGranted = YES;
+        _activeRequestCount++;
+        didGrant = YES;
+    }
+    if (didGrant) [_condition broadcast];
+}
+
+- (void)_waitForTurnWithPriority:(LJRequestPriority)priority client:(id)client
+{
+    LJSchedulerQueue *queue = [self _queueForPriority:priority];
+    NSValue *clientKey = [NSValue valueWithPointer:(__bridge const void *)client];
+    LJSchedulerWaiter *waiter;
+    NSMutableArray *waiters;
+
+    [_condition lock];
+    waiter = [[LJSchedulerWaiter alloc] init];
+    waiter->_enqueueTime = CFAbsoluteTimeGetCurrent();
+    waiters = queue->_waitersByClient[clientKey];
+    if (waiters == nil) {
+        waiters = [[NSMutableArray alloc] init];
+        queue->_waitersByClient[clientKey] = waiters;
+        [queue->_clientOrder addObject:clientKey];
+    }
+    [waiters addObject:waiter];
+    queue->_depth++;
+    [self _grantWaitingRequests];
+    while (!waiter->_isGranted) {
+        [_condition wait];
+    }
+    [_condition unlock];
+}
+
+- (void)_finishRequest
+{
+    [_condition lock];
+    NSAssert(_activeRequestCount > 0, @"Unbalanced call to _finishRequest.");
+    _activeRequestCount--;
+    [self _grantWaitingRequests];
+    [_condition unlock];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"LJRequestScheduler for %@: %lu active, %lu waiting",
+            _host, (unsigned long)[self activeRequestCount], (unsigned long)[self queueDepth]];
+}
+
+@end
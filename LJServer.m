@@ -30,6 +30,10 @@
 #import "LJAccount_Private.h"
 #import "Miscellaneous.h"
 #import "URLEncoding.h"
+#import "LJProtocolModes.h"
+#import "LJRequestScheduler_Private.h"
+#import "LJRateLimiter_Private.h"
+#import <pthread.h>
 
 #ifdef ENABLE_REACHABILITY_MONITORING
 NSString * const LJServerReachabilityDidChangeNotification = @"LJServerReachabilityDidChange";
@@ -43,8 +47,23 @@ static SCDynamicStoreRef 		gStore = NULL;
 static SCDynamicStoreContext 	gStoreContext;
 static CFRunLoopSourceRef 		gRunLoopSource = NULL;
 static NSDictionary				*gProxyInfo = NULL;
+static NSLock					*gProxyLock = nil;
+// Guards gStoreRefCount, gStore and gRunLoopSource, which servers created
+// and released on any thread share.  Taken before gProxyLock, never after.
+static NSLock					*gStoreLock = nil;
+
+// Per-thread pool of request body buffers.  Requests are synchronous, so a
+// thread only ever needs more than one buffer if it re-enters the server.
+#define BODY_BUFFER_POOL_SIZE 4
+#define BODY_BUFFER_MAX_POOLED_LENGTH (64 * 1024)
+static pthread_key_t			gBodyBufferPoolKey;
 
 static void LJServerStoreCallback(SCDynamicStoreRef store, CFArrayRef changedKeys, void *info);
+static NSDictionary *LJCopyProxyInfo(void);
+static void LJSetProxyInfo(NSDictionary *proxyInfo);
+static void LJBodyBufferPoolDestroy(void *pool);
+static NSMutableData *LJCheckOutBodyBuffer(void);
+static void LJCheckInBodyBuffer(NSMutableData *buffer);
 
 #ifdef ENABLE_REACHABILITY_MONITORING
 static void LJServerReachabilityCallback(SCNetworkReachabilityRef target, SCNetworkConnectionFlags flags, void *info);
@@ -54,12 +73,16 @@ static CFStringRef LJServerReachabilityCopyDescription(const void *info);
 @interface LJServer ()
 - (void)enableProxyDetection;
 - (void)disableProxyDetection;
-- (void)updateRequestTemplate;
+- (CFHTTPMessageRef)_copyRequestTemplateWithLoginData:(NSData **)loginData host:(NSString **)host;
 @end
 
 @implementation LJServer
 {
 @private
+	// Guards the URL, fast servers flag, login data and request template,
+	// so that any number of threads may send requests while another
+	// changes the configuration.
+	NSLock *_stateLock;
 	NSData *_loginData;
 #ifdef ENABLE_REACHABILITY_MONITORING
 	SCNetworkReachabilityContext _reachContext;
@@ -78,6 +101,9 @@ static CFStringRef LJServerReachabilityCopyDescription(const void *info);
             [myBundle objectForInfoDictionaryKey:@"CFBundleName"],
             [LJAccount _clientVersionForBundle:myBundle]];
         NSLog(@"LJKit User-Agent: %@", gUserAgent);
+        pthread_key_create(&gBodyBufferPoolKey, LJBodyBufferPoolDestroy);
+        gProxyLock = [[NSLock alloc] init];
+        gStoreLock = [[NSLock alloc] init];
     }
 }
 
@@ -86,6 +112,7 @@ static CFStringRef LJServerReachabilityCopyDescription(const void *info);
     self = [super init];
     if (self) {
         _account = account; // don't retain (to avoid a cycle)
+        _stateLock = [[NSLock alloc] init];
         [self setURL:url];
 		[self enableProxyDetection];
 #ifdef ENABLE_REACHABILITY_MONITORING
@@ -116,14 +143,31 @@ static CFStringRef LJServerReachabilityCopyDescription(const void *info);
     [encoder encodeConditionalObject:_account forKey:@"LJServerAccount"];
 }
 
+- (NSURL *)URL
+{
+    NSURL *url;
+
+    [_stateLock lock];
+    url = _serverURL;
+    [_stateLock unlock];
+    return url;
+}
+
 - (void)setURL:(NSURL *)url
 {
+    BOOL changed;
+
     NSAssert([[url scheme] isEqualToString:@"http"], @"URL scheme must be http");
     
-    if (![_serverURL isEqual:url]) {
-		_serverURL = url;
+    [_stateLock lock];
+    changed = ![_serverURL isEqual:url];
+    if (changed) {
+        _serverURL = [url copy];
         if (_requestTemplate) CFRelease(_requestTemplate);
         _requestTemplate = NULL;
+    }
+    [_stateLock unlock];
+    if (changed) {
 #ifdef ENABLE_REACHABILITY_MONITORING
         // If we were monitoring reachability, the target needs to be updated.
         if (_target != NULL) {
@@ -131,34 +175,54 @@ static CFStringRef LJServerReachabilityCopyDescription(const void *info);
             [self enableReachabilityMonitoring];
         }
 #endif
+        // The host and port are part of the account's identifier.
+        if ([_account server] == self) [_account _updateIdentifier];
     }
 }
 
 - (void)setUseFastServers:(BOOL)flag
 {
+    [_stateLock lock];
     if (_isUsingFastServers != flag) {
         _isUsingFastServers = flag;
         if (_requestTemplate) CFRelease(_requestTemplate);
         _requestTemplate = NULL;
     }
+    [_stateLock unlock];
 }
 
 - (BOOL)isUsingFastServers
 {
-    return _isUsingFastServers;
+    BOOL flag;
+
+    [_stateLock lock];
+    flag = _isUsingFastServers;
+    [_stateLock unlock];
+    return flag;
 }
 
 - (void)setLoginInfo:(NSDictionary *)loginDict
 {
+    // The login fields are the same for every request, so they are encoded
+    // once here and copied into each request body as a ready-made segment.
+    NSData *loginData = nil;
+
     if (loginDict != nil) {
-        _loginData = LJCreateURLEncodedFormData(loginDict);
-    } else {
-        _loginData = nil;
+        loginData = LJCreateURLEncodedFormData(loginDict);
     }
+    [_stateLock lock];
+    _loginData = loginData;
+    [_stateLock unlock];
 }
 
- - (void)enableProxyDetection
+/*
+ * The dynamic store's run loop source goes on the main run loop, which is
+ * always running; the thread creating the first server may be a GCD worker
+ * whose run loop never runs.
+ */
+- (void)enableProxyDetection
 {
+    [gStoreLock lock];
     if (gStoreRefCount == 0) {
         gStore = SCDynamicStoreCreate(kCFAllocatorDefault,
                                       (__bridge CFStringRef)[[NSProcessInfo processInfo] processName], 
@@ -167,22 +231,25 @@ static CFStringRef LJServerReachabilityCopyDescription(const void *info);
         NSArray *keyArray = @[proxiesKey];
         SCDynamicStoreSetNotificationKeys(gStore, (__bridge CFArrayRef)(keyArray), NULL);
         gRunLoopSource = SCDynamicStoreCreateRunLoopSource(kCFAllocatorDefault, gStore, 0);
-        CFRunLoopAddSource(CFRunLoopGetCurrent(), gRunLoopSource, kCFRunLoopDefaultMode);
+        CFRunLoopAddSource(CFRunLoopGetMain(), gRunLoopSource, kCFRunLoopCommonModes);
         // The callback won't be called unless the proxy *changes*, so we make an initial copy here.
-        gProxyInfo = CFBridgingRelease(SCDynamicStoreCopyProxies(gStore));
+        LJSetProxyInfo(CFBridgingRelease(SCDynamicStoreCopyProxies(gStore)));
     }
     gStoreRefCount++;
+    [gStoreLock unlock];
 }
 
 - (void)disableProxyDetection
 {
+    [gStoreLock lock];
     gStoreRefCount--;
     if (gStoreRefCount == 0) {
-        CFRunLoopRemoveSource(CFRunLoopGetCurrent(), gRunLoopSource, kCFRunLoopDefaultMode);
+        CFRunLoopRemoveSource(CFRunLoopGetMain(), gRunLoopSource, kCFRunLoopCommonModes);
         CFRelease(gRunLoopSource); gRunLoopSource = NULL;
         CFRelease(gStore); gStore = NULL;
-        gProxyInfo = nil;
+        LJSetProxyInfo(nil);
     }
+    [gStoreLock unlock];
 }
 
 #ifdef ENABLE_REACHABILITY_MONITORING
@@ -218,6 +285,22 @@ static CFStringRef LJServerReachabilityCopyDescription(const void *info);
     return ok;
 }
 
+- (CFHTTPMessageRef)_copyRequestTemplateWithLoginData:(NSData **)loginData host:(NSString **)host
+{
+    CFHTTPMessageRef template;
+
+    [_stateLock lock];
+    if (_requestTemplate == NULL) [self updateRequestTemplate];
+    // The template is never modified once built; a new one replaces it when
+    // the configuration changes.  So it can be shared without the lock.
+    template = (CFHTTPMessageRef)CFRetain(_requestTemplate);
+    *loginData = _loginData;
+    *host = [_serverURL host];
+    [_stateLock unlock];
+    return template;
+}
+
+// Must be called with _stateLock held.
 - (void)updateRequestTemplate
 {
     NSURL *url = [NSURL URLWithString:@"/interface/flat" relativeToURL:_serverURL];
@@ -240,69 +323,177 @@ static CFStringRef LJServerReachabilityCopyDescription(const void *info);
 
 - (NSString *)description
 {
-	return [NSString stringWithFormat:@"Server: %@, is using fast server: %@", _serverURL, _isUsingFastServers ? @"Yes" : @"No" ];
+	return [NSString stringWithFormat:@"Server: %@, is using fast server: %@", [self URL], [self isUsingFastServers] ? @"Yes" : @"No" ];
 }
 
 #define STREAM_BUFFER_SIZE 256
 
 - (NSDictionary *)getReplyForMode:(NSString *)mode parameters:(NSDictionary *)parameters
 {
+    return [self getReplyForMode:mode parameters:parameters
+                        priority:LJDefaultPriorityForRequest(mode, parameters)];
+}
+
+- (NSDictionary *)getReplyForMode:(NSString *)mode parameters:(NSDictionary *)parameters
+                         priority:(LJRequestPriority)priority
+{
+    LJRequestScheduler *scheduler = nil;
+    LJRateLimiter *limiter;
+    LJRateLimitClass rateClass;
     CFIndex bytesRead;
     NSDictionary *replyDictionary = nil;
-    NSMutableData *contentData;
+    NSData *loginData;
+    NSString *host;
+    NSDictionary *proxyInfo;
+    NSMutableData *body;
     UInt8 bytes[STREAM_BUFFER_SIZE];
-
-    // Compile HTTP POST variables into a data object.
-    contentData = [[NSMutableData alloc] init];
-    NSString *tmpString = [NSString stringWithFormat:@"mode=%@", mode];
-    [contentData appendData:[tmpString dataUsingEncoding:NSUTF8StringEncoding]];
-    if (_loginData) [contentData appendData:_loginData];
-    if (parameters) [contentData appendData:LJCreateURLEncodedFormData(parameters)];
-
-    // Copy the template HTTP message and set the data and content length.
-    if (_requestTemplate == NULL) [self updateRequestTemplate];
-    CFHTTPMessageRef request = CFHTTPMessageCreateCopy(kCFAllocatorDefault, _requestTemplate);
-    CFHTTPMessageSetBody(request, (__bridge CFDataRef)contentData);
-    tmpString = [NSString stringWithFormat:@"%lu", (unsigned long)[contentData length]];
-    CFHTTPMessageSetHeaderFieldValue(request, CFSTR("Content-Length"), (__bridge CFStringRef)tmpString);
-    
-	// Connect to the server.
-	CFReadStreamRef stream = CFReadStreamCreateForHTTPRequest(kCFAllocatorDefault, request);
-	if (gProxyInfo) {
-		CFReadStreamSetProperty(stream, kCFStreamPropertyHTTPProxy, (__bridge CFTypeRef)(gProxyInfo));
-	}
-	CFReadStreamOpen(stream);
-	
-	// Build an HTTP response from the data read.
-	CFHTTPMessageRef response = CFHTTPMessageCreateEmpty(kCFAllocatorDefault, FALSE);
-	while ((bytesRead = CFReadStreamRead(stream, bytes, STREAM_BUFFER_SIZE))) {
-		if (bytesRead == -1) {
-			CFStreamError err = CFReadStreamGetError(stream);
-			[[_account _exceptionWithFormat:@"LJStreamError_%d_%d", err.domain, err.error] raise];
-		} else if (!CFHTTPMessageAppendBytes(response, bytes, bytesRead)) {
-			CFReadStreamClose(stream);
-			[[_account _exceptionWithName:@"LJHTTPParseError"] raise];
-		}
-	}
-	CFIndex statusCode = CFHTTPMessageGetResponseStatusCode(response);
-	if (statusCode == 200) {
-		NSData *responseData = CFBridgingRelease(CFHTTPMessageCopyBody(response));
-		replyDictionary = ParseLJReplyData(responseData);
-	} else {
-		[[_account _exceptionWithFormat:@"LJHTTPStatusError_%d", statusCode] raise];
-	}
-	if (stream) CFRelease(stream);
-	if (response) CFRelease(response);
-	if (request) CFRelease(request);
+    CFHTTPMessageRef request = NULL, response = NULL;
+    CFReadStreamRef bodyStream = NULL, stream = NULL;
+    CFHTTPMessageRef template;
+
+    // Take a consistent snapshot of the configuration for this request.
+    template = [self _copyRequestTemplateWithLoginData:&loginData host:&host];
+    proxyInfo = LJCopyProxyInfo();
+
+    // Wait for the host's rate limit before queueing for a connection, so
+    // a throttled request doesn't hold a connection slot while it sleeps.
+    limiter = [LJRateLimiter rateLimiterForHost:host];
+    rateClass = LJRateLimitClassForMode(mode);
+    [limiter _waitForTokenForClass:rateClass];
+
+    // Gather the body segments into a pooled buffer: the mode, the pre-encoded
+    // login segment, and the parameters, which are encoded in place.
+    body = LJCheckOutBodyBuffer();
+    [body appendBytes:"mode=" length:5];
+    LJAppendURLEncodingOfStringToData(mode, body);
+    if (loginData) [body appendData:loginData];
+    if (parameters) LJAppendURLEncodedFormDataToData(parameters, body);
+
+    @try {
+        // Wait for a free connection to the host.  Higher priority requests
+        // go first, and accounts sharing the host take turns.
+        scheduler = [LJRequestScheduler schedulerForHost:host];
+        [scheduler _waitForTurnWithPriority:priority client:_account];
+
+        // Copy the template HTTP message and set the content length.  The body
+        // is streamed straight out of the pooled buffer rather than copied
+        // into the message.
+        request = CFHTTPMessageCreateCopy(kCFAllocatorDefault, template);
+        CFStringRef contentLength = CFStringCreateWithFormat(kCFAllocatorDefault, NULL, CFSTR("%lu"),
+                                                             (unsigned long)[body length]);
+        CFHTTPMessageSetHeaderFieldValue(request, CFSTR("Content-Length"), contentLength);
+        CFRelease(contentLength);
+        bodyStream = CFReadStreamCreateWithBytesNoCopy(kCFAllocatorDefault, [body bytes],
+                                                       [body length], kCFAllocatorNull);
+
+        // Connect to the server.
+        stream = CFReadStreamCreateForStreamedHTTPRequest(kCFAllocatorDefault, request, bodyStream);
+        if (proxyInfo) {
+            CFReadStreamSetProperty(stream, kCFStreamPropertyHTTPProxy, (__bridge CFTypeRef)(proxyInfo));
+        }
+        CFReadStreamOpen(stream);
+
+        // Build an HTTP response from the data read.
+        response = CFHTTPMessageCreateEmpty(kCFAllocatorDefault, FALSE);
+        while ((bytesRead = CFReadStreamRead(stream, bytes, STREAM_BUFFER_SIZE))) {
+            if (bytesRead == -1) {
+                CFStreamError err = CFReadStreamGetError(stream);
+                [[_account _exceptionWithFormat:@"LJStreamError_%d_%d", err.domain, err.error] raise];
+            } else if (!CFHTTPMessageAppendBytes(response, bytes, bytesRead)) {
+                [[_account _exceptionWithName:@"LJHTTPParseError"] raise];
+            }
+        }
+        CFIndex statusCode = CFHTTPMessageGetResponseStatusCode(response);
+        if (statusCode == 200) {
+            NSData *responseData = CFBridgingRelease(CFHTTPMessageCopyBody(response));
+            replyDictionary = ParseLJReplyData(responseData);
+            [limiter _noteSuccessForClass:rateClass];
+            if (rateClass == LJRateLimitClassPolling && replyDictionary[@"interval"]) {
+                [limiter _notePollingInterval:[replyDictionary[@"interval"] doubleValue]
+                                    forClient:_account];
+            }
+        } else {
+            if (statusCode == 503) {
+                NSString *retryAfter = CFBridgingRelease(CFHTTPMessageCopyHeaderFieldValue(response, CFSTR("Retry-After")));
+                [limiter _noteServerBusyForClass:rateClass retryAfter:[retryAfter doubleValue]];
+            }
+            [[_account _exceptionWithFormat:@"LJHTTPStatusError_%d", statusCode] raise];
+        }
+    } @finally {
+        if (stream) {
+            CFReadStreamClose(stream);
+            CFRelease(stream);
+        }
+        if (bodyStream) CFRelease(bodyStream);
+        if (response) CFRelease(response);
+        if (request) CFRelease(request);
+        CFRelease(template);
+        [scheduler _finishRequest];
+        // Only hand the buffer back once nothing can read from it.
+        LJCheckInBodyBuffer(body);
+    }
     return replyDictionary;
 }
 
 @end
 
+void LJBodyBufferPoolDestroy(void *pool)
+{
+    CFRelease((CFMutableArrayRef)pool);
+}
+
+NSMutableData *LJCheckOutBodyBuffer(void)
+{
+    CFMutableArrayRef pool = pthread_getspecific(gBodyBufferPoolKey);
+    CFIndex count = (pool != NULL) ? CFArrayGetCount(pool) : 0;
+
+    if (count > 0) {
+        NSMutableData *buffer = (__bridge NSMutableData *)CFArrayGetValueAtIndex(pool, count - 1);
+        CFArrayRemoveValueAtIndex(pool, count - 1);
+        [buffer setLength:0];
+        return buffer;
+    }
+    return [[NSMutableData alloc] initWithCapacity:1024];
+}
+
+void LJCheckInBodyBuffer(NSMutableData *buffer)
+{
+    CFMutableArrayRef pool = pthread_getspecific(gBodyBufferPoolKey);
+
+    // Don't let one huge upload pin its buffer to the thread forever.
+    if ([buffer length] > BODY_BUFFER_MAX_POOLED_LENGTH) return;
+    if (pool == NULL) {
+        pool = CFArrayCreateMutable(kCFAllocatorDefault, BODY_BUFFER_POOL_SIZE, &kCFTypeArrayCallBacks);
+        pthread_setspecific(gBodyBufferPoolKey, pool);
+    }
+    if (CFArrayGetCount(pool) < BODY_BUFFER_POOL_SIZE) {
+        CFArrayAppendValue(pool, (__bridge const void *)buffer);
+    }
+}
+
 void LJServerStoreCallback(SCDynamicStoreRef store, CFArrayRef changedKeys, void *info)
 {
     // We're only monitoring one key, so it's a safe bet we can ignore the changedKeys parameter.
-    gProxyInfo = CFBridgingRelease(SCDynamicStoreCopyProxies(store));
+    LJSetProxyInfo(CFBridgingRelease(SCDynamicStoreCopyProxies(store)));
+}
+
+NSDictionary *LJCopyProxyInfo(void)
+{
+    NSDictionary *proxyInfo;
+
+    [gProxyLock lock];
+    proxyInfo = gProxyInfo;
+    [gProxyLock unlock];
+    return proxyInfo;
+}
+
+void LJSetProxyInfo(NSDictionary *proxyInfo)
+{
+    // The dictionary is immutable, so swapping the pointer under the lock
+    // is enough to give every request a consistent snapshot.
+    [gProxyLock lock];
+    gProxyInfo = proxyInfo;
+    [gProxyLock unlock];
 }
 
 #ifdef ENABLE_REACHABILITY_MONITORING
@@ -24,9 +24,12 @@
  */
 
 #import "LJServer.h"
+#import "LJRequestScheduler.h"
 
 @interface LJServer ()
 @property (NS_NONATOMIC_IOSONLY, getter=isUsingFastServers, readwrite) BOOL useFastServers;
 - (instancetype)initWithURL:(NSURL *)url account:(LJAccount *)account;
 - (void)setLoginInfo:(NSDictionary *)loginDict;
+- (NSDictionary *)getReplyForMode:(NSString *)mode parameters:(NSDictionary *)parameters
+                         priority:(LJRequestPriority)priority;
 @end
@@ -0,0 +1,51 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*!
+ @class LJSingleFlight
+ @abstract Collapses concurrent identical requests into one.
+ @discussion
+ While a request for a key is in flight, other threads asking for the same
+ key wait for it to finish and receive the same reply (or the same error)
+ instead of starting their own.  Once the request completes the key is
+ forgotten, so this is not a cache.
+ */
+@interface LJSingleFlight : NSObject
+
+/*!
+ @method replyForKey:fetchBlock:
+ @abstract Returns the reply for key, fetching it only if nobody else is.
+ @discussion
+ If no request for key is in flight, calls fetchBlock on the current thread
+ and shares its result with any callers that arrive before it returns.
+ Otherwise blocks until the in-flight request finishes.  If the request
+ raised an exception, it is raised again in every waiting thread.
+ */
+- (nullable NSDictionary *)replyForKey:(NSString *)key
+                            fetchBlock:(NSDictionary * _Nullable (^)(void))fetchBlock;
+
+@end
+
+NS_ASSUME_NONNULL_END
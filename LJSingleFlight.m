@@ -0,0 +1,115 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import "LJSingleFlight.h"
+
+@interface LJSingleFlightCall : NSObject
+{
+@public
+    NSCondition *_condition;
+    BOOL _isDone;
+    NSDictionary *_reply;
+    NSException *_exception;
+}
+@end
+
+@implementation LJSingleFlightCall
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _condition = [[NSCondition alloc] init];
+    }
+    return self;
+}
+
+@end
+
+@implementation LJSingleFlight
+{
+@private
+    NSLock *_lock;
+    NSMutableDictionary *_calls;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _lock = [[NSLock alloc] init];
+        _calls = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (NSDictionary *)replyForKey:(NSString *)key fetchBlock:(NSDictionary *(^)(void))fetchBlock
+{
+    LJSingleFlightCall *call;
+    BOOL isLeader = NO;
+
+    [_lock lock];
+    call = _calls[key];
+    if (call == nil) {
+        call = [[LJSingleFlightCall alloc] init];
+        _calls[key] = call;
+        isLeader = YES;
+    }
+    [_lock unlock];
+
+    if (isLeader) {
+        NSDictionary *reply = nil;
+        NSException *exception = nil;
+
+        @try {
+            reply = fetchBlock();
+        } @catch (NSException *localException) {
+            exception = localException;
+        }
+        // Forget the key before waking anyone up, so that a caller arriving
+        // after this point starts a fresh request.
+        [_lock lock];
+        [_calls removeObjectForKey:key];
+        [_lock unlock];
+        [call->_condition lock];
+        call->_reply = reply;
+        call->_exception = exception;
+        call->_isDone = YES;
+        [call->_condition broadcast];
+        [call->_condition unlock];
+        [exception raise];
+        return reply;
+    }
+
+    [call->_condition lock];
+    while (!call->_isDone) {
+        [call->_condition wait];
+    }
+    [call->_condition unlock];
+    if (call->_exception) {
+        NSException *e = call->_exception;
+        [[NSException exceptionWithName:[e name] reason:[e reason]
+                               userInfo:[e userInfo]] raise];
+    }
+    return call->_reply;
+}
+
+@end
@@ -21,7 +21,7 @@
 
 #import <Foundation/Foundation.h>
 
-@class LJAccount;
+@class LJAccount, LJServer;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -46,6 +46,18 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (NS_NONATOMIC_IOSONLY, readonly, copy) NSString *fullname;
 
+/*!
+ @method userEntityWithUsername:server:
+ @abstract Returns the shared entity for a user on a server.
+ @discussion
+ While any object holds on to the entity returned for a username and
+ server, every call with the same pair returns that same instance, so
+ clients that track posters or other users need not keep their own copies.
+ The entity is independent of any account; the LJFriend objects of an
+ account are separate instances.
+ */
++ (LJUserEntity *)userEntityWithUsername:(NSString *)username server:(LJServer *)server;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -21,12 +21,58 @@
 
 #import "LJUserEntity.h"
 #import "LJUserEntity_Private.h"
+#import "LJAccount.h"
+#import "LJServer.h"
+#import "Miscellaneous.h"
+#import "LJWeakBox.h"
+
+static NSLock *gEntityLock = nil;
+static NSMutableDictionary *gEntitiesByKey = nil;
+static NSUInteger gEntitySweepCount = 64;
 
 @implementation LJUserEntity
+{
+    LJServer *_canonicalServer;
+}
+
++ (void)initialize
+{
+    if (self == [LJUserEntity class]) {
+        gEntityLock = [[NSLock alloc] init];
+        gEntitiesByKey = [[NSMutableDictionary alloc] init];
+    }
+}
+
++ (LJUserEntity *)userEntityWithUsername:(NSString *)username server:(LJServer *)server
+{
+    NSString *key = [NSString stringWithFormat:@"%@ %@", [[server URL] absoluteString],
+                     [username lowercaseString]];
+    LJWeakBox *box;
+    LJUserEntity *entity;
+
+    // The entities are held weakly, through boxes; empty boxes are swept
+    // out each time the map doubles.
+    [gEntityLock lock];
+    box = gEntitiesByKey[key];
+    entity = [box object];
+    if (entity == nil) {
+        entity = [[LJUserEntity alloc] init];
+        [entity _setUsername:username];
+        [entity _setFullname:[entity username]];
+        entity->_canonicalServer = server;
+        gEntitiesByKey[key] = [LJWeakBox boxWithObject:entity];
+        if ([gEntitiesByKey count] >= gEntitySweepCount) {
+            LJRemoveEmptyWeakBoxes(gEntitiesByKey);
+            gEntitySweepCount = MAX(64, 2 * [gEntitiesByKey count]);
+        }
+    }
+    [gEntityLock unlock];
+    return entity;
+}
 
 - (void)_setUsername:(NSString *)newUsername
 {
-	_username = [newUsername lowercaseString];
+	_username = LJInternString([newUsername lowercaseString]);
 }
 
 - (LJAccount *)account
@@ -34,4 +80,9 @@
     return nil;
 }
 
+- (LJServer *)_server
+{
+    return _canonicalServer ?: [[self account] server];
+}
+
 @end
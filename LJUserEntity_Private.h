@@ -25,4 +25,5 @@
 @property (nonatomic, readwrite, setter=_setUsername:, copy) NSString *username;
 @property (NS_NONATOMIC_IOSONLY, readwrite, setter=_setFullname:, copy) NSString *fullname;
 - (LJAccount *)account;
+- (LJServer *)_server;
 @end
@@ -0,0 +1,42 @@
+/*
+ LJKit: an Objective-C implementation of the LiveJournal client protocol
+ Copyright (C) 2002-2003  Benjamin Peter Ragheb
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ You may contact the author via email at benzado@livejournal.com.
+ */
+
+#import <Foundation/Foundation.h>
+
+#ifndef __private_extern
+#define __private_extern __attribute__((visibility("hidden")))
+#endif
+
+/*
+ * Holds a zeroing weak reference to an object.  Weak-valued NSMapTables
+ * need 10.8, so the framework's weak maps are ordinary dictionaries of
+ * these boxes instead; a box whose object has gone is swept out later.
+ */
+@interface LJWeakBox : NSObject
++ (LJWeakBox *)boxWithObject:(id)object;
+@property (weak) id object;
+@end
+
+/*
+ * Removes the boxes whose object has gone from a dictionary of LJWeakBox
+ * values.
+ */
+__private_extern void LJRemoveEmptyWeakBoxes(NSMutableDictionary *dictionary);
@@ -49,3 +49,18 @@ __private_extern NSColor *ColorForHTMLCode(NSString *code);
  * Assumes the NSColor is an RGB color.
  */
 __private_extern NSString *HTMLCodeForColor(NSColor *color);
+
+/*!
+ * Returns a new map table keyed by usernames without regard to case.  It
+ * can be probed with a username as the user typed it; nothing is lowercased
+ * or otherwise allocated to find an entry.
+ */
+__private_extern NSMapTable *UsernameMapTable(void);
+
+/*!
+ * Returns the process-wide shared copy of a short string such as a username
+ * or an enum-like reply value ("community", "public", "1").  Strings too
+ * long to be worth sharing, and any string once the table is full, are
+ * returned unchanged.  Safe to call from any thread.
+ */
+__private_extern NSString *LJInternString(NSString *string);
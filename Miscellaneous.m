@@ -91,3 +91,83 @@ NSString *HTMLCodeForColor(NSColor *color)
         (int)(255.0 * [rgbColor greenComponent]),
         (int)(255.0 * [rgbColor blueComponent])];
 }
+
+// Usernames are ASCII, so folding ASCII letters is all the case folding
+// they need, and it keeps the hash and equality in agreement.
+static inline UniChar FoldUsernameCharacter(UniChar c)
+{
+    return (c >= 'A' && c <= 'Z') ? (UniChar)(c + ('a' - 'A')) : c;
+}
+
+static NSUInteger UsernameHash(const void *item, NSUInteger (*size)(const void *item))
+{
+    CFStringRef string = (CFStringRef)item;
+    CFIndex length = CFStringGetLength(string);
+    CFStringInlineBuffer buffer;
+    NSUInteger hash = 2166136261U;
+
+    CFStringInitInlineBuffer(string, &buffer, CFRangeMake(0, length));
+    for (CFIndex i = 0; i < length; i++) {
+        hash = (hash ^ FoldUsernameCharacter(CFStringGetCharacterFromInlineBuffer(&buffer, i))) * 16777619U;
+    }
+    return hash;
+}
+
+static BOOL UsernameIsEqual(const void *item1, const void *item2, NSUInteger (*size)(const void *item))
+{
+    CFStringRef string1 = (CFStringRef)item1, string2 = (CFStringRef)item2;
+    CFIndex length = CFStringGetLength(string1);
+    CFStringInlineBuffer buffer1, buffer2;
+
+    if (string1 == string2) return YES;
+    if (CFStringGetLength(string2) != length) return NO;
+    CFStringInitInlineBuffer(string1, &buffer1, CFRangeMake(0, length));
+    CFStringInitInlineBuffer(string2, &buffer2, CFRangeMake(0, length));
+    for (CFIndex i = 0; i < length; i++) {
+        if (FoldUsernameCharacter(CFStringGetCharacterFromInlineBuffer(&buffer1, i)) !=
+            FoldUsernameCharacter(CFStringGetCharacterFromInlineBuffer(&buffer2, i))) return NO;
+    }
+    return YES;
+}
+
+NSMapTable *UsernameMapTable(void)
+{
+    NSPointerFunctions *keyFunctions, *valueFunctions;
+
+    keyFunctions = [NSPointerFunctions pointerFunctionsWithOptions:(NSPointerFunctionsStrongMemory |
+                                                                    NSPointerFunctionsObjectPersonality)];
+    [keyFunctions setHashFunction:UsernameHash];
+    [keyFunctions setIsEqualFunction:UsernameIsEqual];
+    valueFunctions = [NSPointerFunctions pointerFunctionsWithOptions:(NSPointerFunctionsStrongMemory |
+                                                                      NSPointerFunctionsObjectPersonality)];
+    return [[NSMapTable alloc] initWithKeyPointerFunctions:keyFunctions
+                                     valuePointerFunctions:valueFunctions
+                                                  capacity:0];
+}
+
+// Longer strings are rarely repeated, and the table never shrinks, so only
+// short ones are shared and the table is bounded.
+#define MAX_INTERNED_LENGTH 24
+#define MAX_INTERNED_COUNT 65536
+
+NSString *LJInternString(NSString *string)
+{
+    static NSMutableSet *table;
+    static NSLock *lock;
+    static dispatch_once_t once;
+    NSString *interned;
+
+    if (string == nil || [string length] > MAX_INTERNED_LENGTH) return string;
+    dispatch_once(&once, ^{
+        table = [[NSMutableSet alloc] init];
+        lock = [[NSLock alloc] init];
+    });
+    [lock lock];
+    interned = [table member:string];
+    if (interned == nil) {
+        interned = [string copy];
+        if ([table count] < MAX_INTERNED_COUNT) [table addObject:interned];
+    }
+    [lock unlock];
+    return interned;
+}
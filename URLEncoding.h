@@ -44,6 +44,13 @@ __private_extern NSString *LJURLDecodeString(NSString *es);
  */
 __private_extern NSData *LJCreateURLEncodedFormData(NSDictionary *dict);
 
+/**
+ * Like LJCreateURLEncodedFormData(), but encodes the key-value pairs directly
+ * onto the end of data instead of building a new object.  Use this when the
+ * caller already has a buffer to fill.
+ */
+__private_extern void LJAppendURLEncodedFormDataToData(NSDictionary *dict, NSMutableData *data);
+
 /**
  *  Parses a LiveJournal server response and returns the key/value pairs as
  *  an NSDictionary.
@@ -28,28 +28,35 @@
 
 void LJAppendURLEncodingOfStringToData(NSString *string, NSMutableData *data)
 {
-    const char *bytes;
-    unsigned char c, digit;
-    char hex[3];
-    int i;
+    const unsigned char *bytes;
+    unsigned char c, digit, *out;
+    NSUInteger start, n, i;
 
-    hex[0] = '%';
-    bytes = [string UTF8String];
-    for ( i = 0; (c = bytes[i]); i++ ) {
+    bytes = (const unsigned char *)[string UTF8String];
+    if (bytes == NULL) return;
+    n = strlen((const char *)bytes);
+    // Each byte encodes to at most three, so make room for the worst case and
+    // write straight into the buffer, then trim off what we didn't use.
+    start = [data length];
+    [data increaseLengthBy:(n * 3)];
+    out = (unsigned char *)[data mutableBytes] + start;
+    for ( i = 0; i < n; i++ ) {
+        c = bytes[i];
         if (c == ' ') {
-            [data appendBytes:"+" length:1];
+            *out++ = '+';
         } else if (((c >= 'a') && (c <= 'z')) ||
                    ((c >= 'A') && (c <= 'Z')) ||
                    ((c >= '0') && (c <= '9'))) {
-            [data appendBytes:&c length:1];
+            *out++ = c;
         } else {
+            *out++ = '%';
             digit = c >> 4;
-            hex[1] = (digit < 10) ? ('0' + digit) : ('A' + (digit - 10));
+            *out++ = (digit < 10) ? ('0' + digit) : ('A' + (digit - 10));
             digit = c & 0x0F;
-            hex[2] = (digit < 10) ? ('0' + digit) : ('A' + (digit - 10));
-            [data appendBytes:hex length:3];
+            *out++ = (digit < 10) ? ('0' + digit) : ('A' + (digit - 10));
         }
     }
+    [data setLength:(out - (unsigned char *)[data mutableBytes])];
 }
 
 NSString *LJURLDecodeString(NSString *string)
@@ -88,14 +95,19 @@ NSString *LJURLDecodeString(NSString *string)
 NSData *LJCreateURLEncodedFormData(NSDictionary *dict)
 {
     NSMutableData *data = [NSMutableData dataWithCapacity:[dict count]*16];
-    
+
+    LJAppendURLEncodedFormDataToData(dict, data);
+    return [data copy];
+}
+
+void LJAppendURLEncodedFormDataToData(NSDictionary *dict, NSMutableData *data)
+{
     for (NSString *key in dict) {
         [data appendBytes:"&" length:1];
         LJAppendURLEncodingOfStringToData(key, data);
         [data appendBytes:"=" length:1];
         LJAppendURLEncodingOfStringToData(dict[key], data);
     }
-    return [data copy];
 }
 
 NSDictionary *ParseLJReplyData(NSData *data)